@@ -0,0 +1,82 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#include "watson_pcm_convert.h"
+#include "watson_bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* 48 kHz TTS output decodes in 20 ms packets, 960 samples each */
+#define PACKET_SAMPLES 960
+#define PACKETS 50000
+
+typedef void (*convert_fn)(opus_int16 *dst, const float *src, size_t count);
+
+static double run(convert_fn convert, opus_int16 *dst, const float *src)
+{
+    double start = watson_bench_now();
+    size_t offset;
+    int packet;
+
+    for (packet = 0; packet < PACKETS; packet++) {
+        offset = (size_t)(packet % 64) * PACKET_SAMPLES;
+        convert(dst + offset, src + offset, PACKET_SAMPLES);
+        watson_bench_use(dst);
+    }
+    return watson_bench_now() - start;
+}
+
+int main(void)
+{
+    size_t samples = 64 * PACKET_SAMPLES;
+    float *src = malloc(samples * sizeof(float));
+    opus_int16 *scalar = malloc(samples * sizeof(opus_int16));
+    opus_int16 *vector = malloc(samples * sizeof(opus_int16));
+    unsigned int state = 0x9E3779B9u;
+    double scalar_time, vector_time;
+    double total = (double)PACKETS * PACKET_SAMPLES;
+    size_t i;
+
+    for (i = 0; i < samples; i++) {
+        state = state * 1664525u + 1013904223u;
+        /* mostly in range, some clipping, like decoder output */
+        src[i] = ((float)(state >> 8) / 16777216.f) * 2.2f - 1.1f;
+    }
+
+    /* warm up, then check the kernels agree before timing them */
+    watson_float_to_int16_scalar(scalar, src, samples);
+    watson_float_to_int16(vector, src, samples);
+    if (memcmp(scalar, vector, samples * sizeof(opus_int16)) != 0) {
+        for (i = 0; i < samples && scalar[i] == vector[i]; i++) {
+        }
+        fprintf(stderr, "outputs differ at sample %zu (%.9g): scalar %d, vector %d\n", i, src[i], scalar[i], vector[i]);
+        return EXIT_FAILURE;
+    }
+
+    scalar_time = run(watson_float_to_int16_scalar, scalar, src);
+    vector_time = run(watson_float_to_int16, vector, src);
+
+    printf("float to int16, %d packets of %d samples, outputs bit-identical\n", PACKETS, PACKET_SAMPLES);
+    printf("  scalar  %8.2f Msamples/s\n", total / scalar_time / 1e6);
+    printf("  vector  %8.2f Msamples/s  (%.1fx)\n", total / vector_time / 1e6, scalar_time / vector_time);
+
+    free(src);
+    free(scalar);
+    free(vector);
+    return EXIT_SUCCESS;
+}
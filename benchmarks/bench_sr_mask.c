@@ -0,0 +1,93 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#include "SRMask.h"
+#include "watson_bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Each size masks about this many bytes in total, so small frames show per-call overhead */
+#define BYTES_PER_SIZE (256u * 1024 * 1024)
+
+/* The byte loop SRMaskBytes replaced */
+static size_t scalar_mask(uint8_t *destination, const uint8_t *source, size_t length, const uint8_t key[4], size_t offset)
+{
+    size_t i;
+    for (i = 0; i < length; i++) {
+        destination[i] = source[i] ^ key[(offset + i) % 4];
+    }
+    return offset + length;
+}
+
+typedef size_t (*mask_fn)(uint8_t *destination, const uint8_t *source, size_t length, const uint8_t key[4], size_t offset);
+
+static double run(mask_fn mask, uint8_t *destination, const uint8_t *source, size_t length, const uint8_t key[4], size_t iterations)
+{
+    double start = watson_bench_now();
+    size_t i;
+
+    for (i = 0; i < iterations; i++) {
+        mask(destination, source, length, key, i & 3);
+        watson_bench_use(destination);
+    }
+    return watson_bench_now() - start;
+}
+
+int main(void)
+{
+    const size_t sizes[] = {2, 125, 4 * 1024, 64 * 1024, 1024 * 1024};
+    const size_t largest = 1024 * 1024;
+    uint8_t key[4] = {0x12, 0x9A, 0x5E, 0xC7};
+    uint8_t *source = malloc(largest);
+    uint8_t *scalar = malloc(largest);
+    uint8_t *vector = malloc(largest);
+    size_t s, i;
+
+    for (i = 0; i < largest; i++) {
+        source[i] = (uint8_t)(i * 131 + 7);
+    }
+
+    printf("websocket masking, %u MB per frame size\n", BYTES_PER_SIZE / (1024 * 1024));
+    printf("  %10s  %12s  %12s  %8s\n", "frame", "scalar MB/s", "vector MB/s", "speedup");
+
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t length = sizes[s];
+        size_t iterations = BYTES_PER_SIZE / length;
+        size_t offset;
+        double scalar_time, vector_time;
+
+        for (offset = 0; offset < 4; offset++) {
+            scalar_mask(scalar, source, length, key, offset);
+            SRMaskBytes(vector, source, length, key, offset);
+            if (memcmp(scalar, vector, length) != 0) {
+                fprintf(stderr, "outputs differ for %zu byte frames at key offset %zu\n", length, offset);
+                return EXIT_FAILURE;
+            }
+        }
+
+        scalar_time = run(scalar_mask, scalar, source, length, key, iterations);
+        vector_time = run(SRMaskBytes, vector, source, length, key, iterations);
+        printf("  %10zu  %12.0f  %12.0f  %7.1fx\n", length,
+               BYTES_PER_SIZE / scalar_time / 1e6, BYTES_PER_SIZE / vector_time / 1e6, scalar_time / vector_time);
+    }
+
+    free(source);
+    free(scalar);
+    free(vector);
+    return EXIT_SUCCESS;
+}
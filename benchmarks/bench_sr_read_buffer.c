@@ -0,0 +1,300 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#include "SRRingBuffer.h"
+#include "watson_bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Matches SRWebSocket: the stream is read 2048 bytes at a time, and a header is at most 14 bytes */
+#define READ_CHUNK 2048
+#define HEADER_MAX (2 + 8 + 4)
+/* Messages parsed per table row */
+#define MESSAGES 200000u
+
+/*
+ * The byte stream the socket delivers: unmasked server text frames of a fixed payload length,
+ * repeated forever. Reads wrap around it, and it always holds a whole number of frames.
+ */
+typedef struct {
+    uint8_t *bytes;
+    size_t length;
+    size_t position;
+} frame_source;
+
+static void source_init(frame_source *source, size_t payload_length)
+{
+    size_t header_length = payload_length < 126 ? 2 : 4;
+    size_t frame_length = header_length + payload_length;
+    size_t frames = (256 * 1024 + frame_length - 1) / frame_length;
+    size_t f, i;
+
+    source->length = frames * frame_length;
+    source->bytes = malloc(source->length);
+    source->position = 0;
+    for (f = 0; f < frames; f++) {
+        uint8_t *frame = source->bytes + f * frame_length;
+        frame[0] = 0x81;
+        if (header_length == 2) {
+            frame[1] = (uint8_t)payload_length;
+        } else {
+            frame[1] = 126;
+            frame[2] = (uint8_t)(payload_length >> 8);
+            frame[3] = (uint8_t)payload_length;
+        }
+        for (i = 0; i < payload_length; i++) {
+            frame[header_length + i] = (uint8_t)('a' + (f + i) % 26);
+        }
+    }
+}
+
+static void source_read(frame_source *source, uint8_t *destination, size_t length)
+{
+    while (length > 0) {
+        size_t n = source->length - source->position;
+        if (n > length) {
+            n = length;
+        }
+        memcpy(destination, source->bytes + source->position, n);
+        source->position = (source->position + n) % source->length;
+        destination += n;
+        length -= n;
+    }
+}
+
+/* Folds each delivered message into a checksum, so both read paths can be compared */
+static uint32_t deliver(uint32_t checksum, const uint8_t *payload, size_t length)
+{
+    size_t i;
+    watson_bench_use(payload);
+    for (i = 0; i < length; i += 61) {
+        checksum = checksum * 31 + payload[i];
+    }
+    return checksum * 31 + (uint32_t)length;
+}
+
+static size_t extra_header_length(const uint8_t *header)
+{
+    size_t length = header[1] & 0x7F;
+    return (length == 126 ? 2 : length == 127 ? 8 : 0) + (header[1] & 0x80 ? 4 : 0);
+}
+
+static size_t payload_length(const uint8_t *header)
+{
+    size_t length = header[1] & 0x7F;
+    return length == 126 ? ((size_t)header[2] << 8) | header[3] : length;
+}
+
+/*
+ * Before: a C model of the dispatch_data read buffer SRWebSocket used. Each read copied the chunk
+ * into a new region and concatenated it, which builds a new record list. Each consumer slice
+ * was a subrange that walked the records from the start and allocated a new data object. The
+ * consumed prefix was only dropped once the offset passed 4096 bytes and half the buffer.
+ */
+typedef struct {
+    uint8_t *bytes;
+    size_t length;
+} data_region;
+
+typedef struct {
+    data_region *regions;
+    size_t count;
+    size_t size;
+    size_t offset;
+} data_chain;
+
+static void chain_concat(data_chain *chain, const uint8_t *bytes, size_t length)
+{
+    data_region *regions = malloc((chain->count + 1) * sizeof(data_region));
+    if (chain->count > 0) {
+        memcpy(regions, chain->regions, chain->count * sizeof(data_region));
+    }
+    regions[chain->count].bytes = malloc(length);
+    regions[chain->count].length = length;
+    memcpy(regions[chain->count].bytes, bytes, length);
+    free(chain->regions);
+    chain->regions = regions;
+    chain->count += 1;
+    chain->size += length;
+}
+
+/* Copies a subrange out, as reading the bytes of a sliced dispatch_data does */
+static void chain_subrange(const data_chain *chain, size_t offset, size_t length, uint8_t *destination)
+{
+    /* The new data object records the region the slice starts in */
+    data_region *object = malloc(sizeof(data_region) * 2 + 64);
+    size_t r = 0;
+
+    while (offset >= chain->regions[r].length) {
+        offset -= chain->regions[r].length;
+        r++;
+    }
+    object[0] = chain->regions[r];
+    watson_bench_use(object);
+    while (length > 0) {
+        size_t n = chain->regions[r].length - offset;
+        if (n > length) {
+            n = length;
+        }
+        memcpy(destination, chain->regions[r].bytes + offset, n);
+        destination += n;
+        length -= n;
+        offset = 0;
+        r++;
+    }
+    free(object);
+}
+
+static void chain_consume(data_chain *chain, size_t length)
+{
+    size_t dropped = 0;
+    size_t r = 0;
+
+    chain->offset += length;
+    if (chain->offset <= 4096 || chain->offset <= chain->size / 2) {
+        return;
+    }
+    /* The new subrange keeps the partly read region and releases the ones before it */
+    while (chain->offset - dropped >= chain->regions[r].length) {
+        dropped += chain->regions[r].length;
+        free(chain->regions[r].bytes);
+        r++;
+    }
+    memmove(chain->regions, chain->regions + r, (chain->count - r) * sizeof(data_region));
+    chain->count -= r;
+    chain->size -= dropped;
+    chain->offset -= dropped;
+}
+
+static double run_chain(frame_source *source, size_t backlog, uint8_t *frame_data, uint32_t *checksum)
+{
+    data_chain chain = {0};
+    uint8_t buffer[READ_CHUNK];
+    uint8_t header[HEADER_MAX];
+    uint32_t sum = 0;
+    double start = watson_bench_now();
+    unsigned int m;
+    size_t r;
+
+    for (m = 0; m < MESSAGES; m++) {
+        size_t extra, length;
+
+        while (chain.size - chain.offset < backlog) {
+            source_read(source, buffer, READ_CHUNK);
+            chain_concat(&chain, buffer, READ_CHUNK);
+        }
+        chain_subrange(&chain, chain.offset, 2, header);
+        chain_consume(&chain, 2);
+        extra = extra_header_length(header);
+        if (extra > 0) {
+            chain_subrange(&chain, chain.offset, extra, header + 2);
+            chain_consume(&chain, extra);
+        }
+        length = payload_length(header);
+        chain_subrange(&chain, chain.offset, length, frame_data);
+        chain_consume(&chain, length);
+        sum = deliver(sum, frame_data, length);
+    }
+
+    start = watson_bench_now() - start;
+    for (r = 0; r < chain.count; r++) {
+        free(chain.regions[r].bytes);
+    }
+    free(chain.regions);
+    *checksum = sum;
+    return start;
+}
+
+/* After: SRWebSocket reads straight into the ring and parses the header and payload in place */
+static double run_ring(frame_source *source, size_t backlog, uint8_t *frame_data, uint32_t *checksum)
+{
+    SRRingBuffer ring;
+    uint32_t sum = 0;
+    double start;
+    unsigned int m;
+
+    if (!SRRingBufferInit(&ring, 4096)) {
+        return -1;
+    }
+    start = watson_bench_now();
+    for (m = 0; m < MESSAGES; m++) {
+        const uint8_t *bytes;
+        size_t available, extra, length;
+
+        while (SRRingBufferReadableLength(&ring) < backlog) {
+            struct iovec spans[2];
+            size_t n;
+            if (!SRRingBufferReserve(&ring, READ_CHUNK) || SRRingBufferWritableSpans(&ring, spans) == 0) {
+                SRRingBufferDestroy(&ring);
+                return -1;
+            }
+            n = spans[0].iov_len < READ_CHUNK ? spans[0].iov_len : READ_CHUNK;
+            source_read(source, spans[0].iov_base, n);
+            SRRingBufferDidWrite(&ring, n);
+        }
+        available = SRRingBufferReadableLength(&ring);
+        bytes = SRRingBufferLinearize(&ring, available < HEADER_MAX ? available : HEADER_MAX);
+        extra = extra_header_length(bytes);
+        length = payload_length(bytes);
+        SRRingBufferDidRead(&ring, 2 + extra);
+        bytes = SRRingBufferLinearize(&ring, length);
+        memcpy(frame_data, bytes, length);
+        SRRingBufferDidRead(&ring, length);
+        sum = deliver(sum, frame_data, length);
+    }
+
+    start = watson_bench_now() - start;
+    SRRingBufferDestroy(&ring);
+    *checksum = sum;
+    return start;
+}
+
+int main(void)
+{
+    const size_t payloads[] = {125, 4096};
+    const size_t backlogs[] = {16 * 1024, 256 * 1024, 4 * 1024 * 1024};
+    uint8_t *frame_data = malloc(64 * 1024);
+    size_t p, b;
+
+    printf("websocket read buffer, %u messages per row, %d byte reads\n", MESSAGES, READ_CHUNK);
+    printf("  %8s  %10s  %16s  %12s  %8s\n", "payload", "buffered", "dispatch ns/msg", "ring ns/msg", "speedup");
+
+    for (p = 0; p < sizeof(payloads) / sizeof(payloads[0]); p++) {
+        for (b = 0; b < sizeof(backlogs) / sizeof(backlogs[0]); b++) {
+            frame_source source;
+            uint32_t chain_sum, ring_sum;
+            double chain_time, ring_time;
+
+            source_init(&source, payloads[p]);
+            chain_time = run_chain(&source, backlogs[b], frame_data, &chain_sum);
+            source.position = 0;
+            ring_time = run_ring(&source, backlogs[b], frame_data, &ring_sum);
+            free(source.bytes);
+
+            if (ring_time < 0 || chain_sum != ring_sum) {
+                fprintf(stderr, "read paths differ for %zu byte payloads with %zu bytes buffered\n", payloads[p], backlogs[b]);
+                return EXIT_FAILURE;
+            }
+            printf("  %8zu  %10zu  %16.0f  %12.0f  %7.1fx\n", payloads[p], backlogs[b],
+                   chain_time / MESSAGES * 1e9, ring_time / MESSAGES * 1e9, chain_time / ring_time);
+        }
+    }
+
+    free(frame_data);
+    return EXIT_SUCCESS;
+}
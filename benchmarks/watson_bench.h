@@ -0,0 +1,37 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#ifndef WATSON_BENCH_H
+#define WATSON_BENCH_H
+
+#include <time.h>
+
+/* Monotonic wall clock in seconds for the audio core benchmarks */
+static inline double watson_bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Keeps the compiler from discarding a result that is otherwise unused */
+static inline void watson_bench_use(const void *pointer)
+{
+    __asm__ __volatile__("" : : "r"(pointer) : "memory");
+}
+
+#endif
@@ -0,0 +1,35 @@
+//
+// The few Foundation names the SocketRocket byte kernels (SRMask, SRRingBuffer) use, so those
+// .m files, which are plain C, can be built and tested with the audio core outside Xcode.
+// Never part of the iOS build.
+//
+
+#ifndef WATSON_FOUNDATION_SHIM_H
+#define WATSON_FOUNDATION_SHIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef signed char BOOL;
+#define YES ((BOOL)1)
+#define NO ((BOOL)0)
+
+typedef unsigned long NSUInteger;
+typedef long NSInteger;
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+#define NS_ASSUME_NONNULL_BEGIN
+#define NS_ASSUME_NONNULL_END
+
+#if !defined(__clang__)
+#define _Nonnull
+#define _Nullable
+#endif
+
+#endif
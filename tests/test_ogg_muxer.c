@@ -0,0 +1,129 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#include "watson_opus_encoder.h"
+#include "watson_ogg_muxer.h"
+#include "watson_ogg_opus_decoder.h"
+#include "watson_test.h"
+#include <string.h>
+
+#define SAMPLE_RATE 16000
+#define FRAME_SIZE 320
+
+typedef struct {
+    unsigned char *data;
+    size_t length;
+} byte_buffer;
+
+static void append_bytes(byte_buffer *buffer, const unsigned char *bytes, size_t length)
+{
+    buffer->data = realloc(buffer->data, buffer->length + length);
+    memcpy(buffer->data + buffer->length, bytes, length);
+    buffer->length += length;
+}
+
+static void append_page(void *context, const unsigned char *header, long header_len,
+                        const unsigned char *body, long body_len)
+{
+    append_bytes((byte_buffer *)context, header, (size_t)header_len);
+    append_bytes((byte_buffer *)context, body, (size_t)body_len);
+}
+
+static void count_samples(void *context, const opus_int16 *pcm, int samples, int channels)
+{
+    (void)pcm;
+    *(long *)context += (long)samples * channels;
+}
+
+/*
+ Encodes the spans in order into buffers of exactly the bound, like OggHelper encodePCM:
+ does, flushing only after the last one, and checks the stream decodes to every frame
+ */
+static void encode_spans(const char *name, int max_packets_per_page, int page_fill, const long *spans, int count)
+{
+    watson_ogg_muxer mux;
+    watson_opus_encoder *enc;
+    byte_buffer stream = {0};
+    opus_int16 *pcm;
+    long total = 0;
+    long frames = 0;
+    long decoded = 0;
+    int error = 0;
+    int i;
+
+    enc = watson_opus_encoder_create(SAMPLE_RATE, 1, OPUS_APPLICATION_VOIP, &error);
+    WATSON_CHECK(enc != NULL);
+    if (!enc) {
+        return;
+    }
+    // a high bitrate keeps a lot of data buffered in the stream between calls
+    watson_opus_encoder_set_bitrate(enc, 128000);
+    watson_ogg_muxer_init(&mux, 42);
+    watson_ogg_muxer_set_page_control(&mux, 0, max_packets_per_page, page_fill);
+    watson_ogg_muxer_write_headers(&mux, SAMPLE_RATE, 1, append_page, &stream);
+
+    for (i = 0; i < count; i++) {
+        total += spans[i];
+    }
+    pcm = calloc((size_t)total, sizeof(opus_int16));
+    for (i = 0; i < total; i++) {
+        pcm[i] = (opus_int16)((i * 37) % 20000 - 10000);
+    }
+
+    total = 0;
+    for (i = 0; i <= count; i++) {
+        // a last call with no samples flushes what earlier calls left buffered
+        long samples = i < count ? spans[i] : 0;
+        int flush = i == count;
+        size_t capacity = watson_ogg_muxer_encode_bound(&mux, SAMPLE_RATE, samples, FRAME_SIZE);
+        unsigned char *out = malloc(capacity > 0 ? capacity : 1);
+        long length = watson_ogg_muxer_encode(&mux, enc, pcm + total, samples, FRAME_SIZE, flush, out, capacity);
+
+        WATSON_CHECK_MSG(length >= 0, "%s: call %d overflowed a %zu byte bound", name, i, capacity);
+        if (length > 0) {
+            append_bytes(&stream, out, (size_t)length);
+        }
+        free(out);
+        total += samples;
+        frames += (samples + FRAME_SIZE - 1) / FRAME_SIZE;
+    }
+
+    WATSON_CHECK(watson_ogg_opus_decode(stream.data, stream.length, SAMPLE_RATE, count_samples, &decoded) == 0);
+    WATSON_CHECK_MSG(decoded == frames * FRAME_SIZE, "%s: decoded %ld samples, expected %ld", name, decoded, frames * FRAME_SIZE);
+
+    watson_ogg_muxer_clear(&mux);
+    watson_opus_encoder_destroy(enc);
+    free(pcm);
+    free(stream.data);
+}
+
+int main(void)
+{
+    // 25 frames stay buffered below libogg's 4096 byte page, then one frame pages them all out
+    const long buffered_then_small[] = {25 * FRAME_SIZE, FRAME_SIZE};
+    const long many_calls[] = {3 * FRAME_SIZE, 7 * FRAME_SIZE + 11, FRAME_SIZE, 40 * FRAME_SIZE, 2 * FRAME_SIZE, 5};
+
+    encode_spans("default pages", 0, 0, buffered_then_small, 2);
+    encode_spans("default pages, many calls", 0, 0, many_calls, 6);
+    // tiny fills and packet limits split the output into many more pages than frames
+    encode_spans("fill 16", 0, 16, buffered_then_small, 2);
+    encode_spans("fill 1, many calls", 0, 1, many_calls, 6);
+    encode_spans("one packet per page", 1, 0, many_calls, 6);
+    encode_spans("four packets per page, fill 64", 4, 64, many_calls, 6);
+
+    return WATSON_TEST_RESULT();
+}
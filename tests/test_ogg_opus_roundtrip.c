@@ -0,0 +1,164 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#include "watson_opus_encoder.h"
+#include "watson_ogg_muxer.h"
+#include "watson_ogg_opus_decoder.h"
+#include "watson_test.h"
+#include <math.h>
+#include <string.h>
+
+#define SAMPLE_RATE 16000
+#define FRAME_SIZE 320
+/* not a multiple of the frame size, the last frame is padded */
+#define SAMPLES (SAMPLE_RATE + 123)
+#define MAX_LAG 480
+#define TEST_PI 3.14159265358979323846
+
+typedef struct {
+    unsigned char *data;
+    size_t length;
+    size_t capacity;
+} byte_buffer;
+
+typedef struct {
+    opus_int16 *pcm;
+    size_t samples;
+    size_t capacity;
+} pcm_buffer;
+
+static void append_bytes(byte_buffer *buffer, const unsigned char *bytes, size_t length)
+{
+    if (buffer->length + length > buffer->capacity) {
+        buffer->capacity = (buffer->length + length) * 2;
+        buffer->data = realloc(buffer->data, buffer->capacity);
+    }
+    memcpy(buffer->data + buffer->length, bytes, length);
+    buffer->length += length;
+}
+
+static void collect_page(void *context, const unsigned char *header, long header_len,
+                         const unsigned char *body, long body_len)
+{
+    append_bytes((byte_buffer *)context, header, (size_t)header_len);
+    append_bytes((byte_buffer *)context, body, (size_t)body_len);
+}
+
+static void collect_pcm(void *context, const opus_int16 *pcm, int samples, int channels)
+{
+    pcm_buffer *buffer = (pcm_buffer *)context;
+    size_t count = (size_t)samples * (size_t)channels;
+
+    if (buffer->samples + count > buffer->capacity) {
+        buffer->capacity = (buffer->samples + count) * 2;
+        buffer->pcm = realloc(buffer->pcm, buffer->capacity * sizeof(opus_int16));
+    }
+    memcpy(buffer->pcm + buffer->samples, pcm, count * sizeof(opus_int16));
+    buffer->samples += count;
+}
+
+/* Opus is lossy and delays the signal, compare the shapes at the best lag */
+static double best_correlation(const opus_int16 *a, const opus_int16 *b, size_t start, size_t length)
+{
+    double best = -1;
+    int lag;
+
+    for (lag = 0; lag <= MAX_LAG; lag++) {
+        double ab = 0, aa = 0, bb = 0;
+        size_t i;
+        for (i = start; i < start + length; i++) {
+            ab += (double)a[i] * b[i + lag];
+            aa += (double)a[i] * a[i];
+            bb += (double)b[i + lag] * b[i + lag];
+        }
+        if (aa > 0 && bb > 0 && ab / sqrt(aa * bb) > best) {
+            best = ab / sqrt(aa * bb);
+        }
+    }
+    return best;
+}
+
+int main(void)
+{
+    opus_int16 *input = malloc(SAMPLES * sizeof(opus_int16));
+    byte_buffer stream = {0};
+    pcm_buffer decoded = {0};
+    pcm_buffer chunked = {0};
+    watson_ogg_muxer mux;
+    watson_opus_encoder *enc;
+    watson_ogg_opus_decoder *dec;
+    unsigned char *pages;
+    size_t capacity;
+    size_t offset;
+    long length;
+    long frames = (SAMPLES + FRAME_SIZE - 1) / FRAME_SIZE;
+    int error = 0;
+    int i;
+
+    for (i = 0; i < SAMPLES; i++) {
+        input[i] = (opus_int16)(12000 * sin(2 * TEST_PI * 440 * i / SAMPLE_RATE) + 4000 * sin(2 * TEST_PI * 1250 * i / SAMPLE_RATE));
+    }
+
+    /* encode and mux */
+    enc = watson_opus_encoder_create(SAMPLE_RATE, 1, OPUS_APPLICATION_VOIP, &error);
+    WATSON_CHECK(enc != NULL && error == OPUS_OK);
+    WATSON_CHECK(watson_ogg_muxer_init(&mux, 1234) == 0);
+    WATSON_CHECK(watson_ogg_muxer_write_headers(&mux, SAMPLE_RATE, 1, collect_page, &stream) >= 2);
+
+    capacity = watson_ogg_muxer_encode_bound(&mux, SAMPLE_RATE, SAMPLES, FRAME_SIZE);
+    pages = malloc(capacity);
+    length = watson_ogg_muxer_encode(&mux, enc, input, SAMPLES, FRAME_SIZE, 1, pages, capacity);
+    WATSON_CHECK(length > 0);
+    if (length > 0) {
+        append_bytes(&stream, pages, (size_t)length);
+    }
+    free(pages);
+    watson_ogg_muxer_clear(&mux);
+    watson_opus_encoder_destroy(enc);
+
+    /* demux and decode in one go */
+    WATSON_CHECK(watson_ogg_opus_decode(stream.data, stream.length, SAMPLE_RATE, collect_pcm, &decoded) == 0);
+    WATSON_CHECK_MSG(decoded.samples >= SAMPLES && decoded.samples <= (size_t)(frames * FRAME_SIZE),
+                     "decoded %zu samples from %d", decoded.samples, SAMPLES);
+    if (decoded.samples >= SAMPLES) {
+        double correlation = best_correlation(input, decoded.pcm, FRAME_SIZE * 4, SAMPLES - FRAME_SIZE * 4 - MAX_LAG);
+        WATSON_CHECK_MSG(correlation > 0.9, "correlation %.3f", correlation);
+    }
+
+    /* and again pushed in small chunks that split pages anywhere, the output must not change */
+    dec = watson_ogg_opus_decoder_create(SAMPLE_RATE, collect_pcm, &chunked);
+    WATSON_CHECK(dec != NULL);
+    for (offset = 0; dec && offset < stream.length; offset += 7) {
+        size_t count = stream.length - offset < 7 ? stream.length - offset : 7;
+        WATSON_CHECK(watson_ogg_opus_decoder_feed(dec, stream.data + offset, count) == 0);
+    }
+    if (dec) {
+        WATSON_CHECK(watson_ogg_opus_decoder_has_stream(dec));
+        WATSON_CHECK(watson_ogg_opus_decoder_sample_rate(dec) == SAMPLE_RATE);
+        WATSON_CHECK(watson_ogg_opus_decoder_channels(dec) == 1);
+        watson_ogg_opus_decoder_destroy(dec);
+    }
+    WATSON_CHECK(chunked.samples == decoded.samples);
+    WATSON_CHECK(chunked.samples != decoded.samples ||
+                 memcmp(chunked.pcm, decoded.pcm, decoded.samples * sizeof(opus_int16)) == 0);
+
+    free(input);
+    free(stream.data);
+    free(decoded.pcm);
+    free(chunked.pcm);
+    return WATSON_TEST_RESULT();
+}
@@ -0,0 +1,73 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#include "watson_pcm_convert.h"
+#include "watson_test.h"
+#include <math.h>
+#include <string.h>
+
+#define RANDOM_SAMPLES 100003
+
+/* The conversion the decoder always used, the kernel must match it bit for bit */
+static opus_int16 reference(float x)
+{
+    return (opus_int16)floor(.5 + fmaxf(-32768, fminf(x * 32768.f, 32767)));
+}
+
+static void check_samples(const float *src, size_t count)
+{
+    opus_int16 *dst = malloc(count * sizeof(opus_int16));
+    size_t i;
+
+    watson_float_to_int16(dst, src, count);
+    for (i = 0; i < count; i++) {
+        WATSON_CHECK_MSG(dst[i] == reference(src[i]), "sample %zu (%.9g): %d != %d", i, src[i], dst[i], reference(src[i]));
+    }
+    free(dst);
+}
+
+int main(void)
+{
+    float edges[] = {
+        0.f, -0.f, 1.f, -1.f, 2.f, -2.f, 1e30f, -1e30f, INFINITY, -INFINITY, NAN,
+        0.5f / 32768.f, -0.5f / 32768.f, 1.5f / 32768.f, -1.5f / 32768.f,
+        nextafterf(0.5f / 32768.f, 0.f), nextafterf(-0.5f / 32768.f, 0.f),
+        32767.f / 32768.f, 32767.5f / 32768.f, -32768.5f / 32768.f,
+    };
+    unsigned int seed = 0x2545F491u;
+    float *random = malloc(RANDOM_SAMPLES * sizeof(float));
+    size_t i;
+
+    check_samples(edges, sizeof(edges) / sizeof(edges[0]));
+
+    /* every half-step around zero, where rounding differs most */
+    for (i = 0; i < RANDOM_SAMPLES; i++) {
+        random[i] = ((float)i - RANDOM_SAMPLES / 2) * (0.25f / 32768.f);
+    }
+    check_samples(random, RANDOM_SAMPLES);
+
+    for (i = 0; i < RANDOM_SAMPLES; i++) {
+        random[i] = ((float)watson_test_random(&seed) / 4294967296.f) * 2.4f - 1.2f;
+    }
+    /* odd lengths and offsets exercise the scalar tail after the vector loops */
+    for (i = 0; i < 40; i++) {
+        check_samples(random + i, RANDOM_SAMPLES - 2 * i);
+    }
+
+    free(random);
+    return WATSON_TEST_RESULT();
+}
@@ -0,0 +1,74 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#include "SRMask.h"
+#include "watson_test.h"
+#include <string.h>
+
+/* What _sendFrameWithOpcode used to do byte by byte */
+static void reference_mask(uint8_t *destination, const uint8_t *source, size_t length, const uint8_t key[4], size_t offset)
+{
+    size_t i;
+    for (i = 0; i < length; i++) {
+        destination[i] = source[i] ^ key[(offset + i) % 4];
+    }
+}
+
+int main(void)
+{
+    const size_t max_length = 3 * 4096 + 77;
+    uint8_t *source = malloc(max_length + 64);
+    uint8_t *expected = malloc(max_length + 64);
+    uint8_t *actual = malloc(max_length + 64);
+    uint8_t key[4] = {0xA5, 0x3C, 0x0F, 0xF0};
+    unsigned int seed = 0xC0FFEEu;
+    size_t length, align, offset, i;
+
+    for (i = 0; i < max_length + 64; i++) {
+        source[i] = (uint8_t)watson_test_random(&seed);
+    }
+
+    /* every length around the vector widths, every key offset, unaligned sources */
+    for (length = 0; length <= 300; length++) {
+        for (offset = 0; offset < 4; offset++) {
+            for (align = 0; align < 3; align++) {
+                reference_mask(expected, source + align, length, key, offset);
+                WATSON_CHECK(SRMaskBytes(actual, source + align, length, key, offset) == offset + length);
+                WATSON_CHECK_MSG(memcmp(expected, actual, length) == 0, "length %zu offset %zu align %zu", length, offset, align);
+            }
+        }
+    }
+
+    /* in place, as the read path unmasks */
+    memcpy(actual, source, max_length);
+    SRMaskBytes(actual, actual, max_length, key, 0);
+    reference_mask(expected, source, max_length, key, 0);
+    WATSON_CHECK(memcmp(expected, actual, max_length) == 0);
+
+    /* a payload split across reads continues from the returned key offset */
+    for (i = 0; i < 50; i++) {
+        size_t first = watson_test_random(&seed) % max_length;
+        size_t next = SRMaskBytes(actual, source, first, key, 0);
+        SRMaskBytes(actual + first, source + first, max_length - first, key, next);
+        WATSON_CHECK_MSG(memcmp(expected, actual, max_length) == 0, "split at %zu", first);
+    }
+
+    free(source);
+    free(expected);
+    free(actual);
+    return WATSON_TEST_RESULT();
+}
@@ -0,0 +1,136 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#include "SRRingBuffer.h"
+#include "watson_test.h"
+#include <string.h>
+
+#define OPERATIONS 2000000
+#define MAX_CHUNK 5000
+/* above this the model mostly reads, so the ring grows, wraps and shrinks back */
+#define HIGH_WATER (64 * 1024)
+
+/* Reference: a flat byte array with read and write indices */
+typedef struct {
+    uint8_t *bytes;
+    size_t capacity;
+    size_t head;
+    size_t tail;
+} byte_model;
+
+static void model_append(byte_model *model, const uint8_t *bytes, size_t length)
+{
+    if (model->tail + length > model->capacity && model->head > 0) {
+        memmove(model->bytes, model->bytes + model->head, model->tail - model->head);
+        model->tail -= model->head;
+        model->head = 0;
+    }
+    if (model->tail + length > model->capacity) {
+        model->capacity = (model->tail + length) * 2;
+        model->bytes = realloc(model->bytes, model->capacity);
+    }
+    if (length > 0) {
+        memcpy(model->bytes + model->tail, bytes, length);
+    }
+    model->tail += length;
+}
+
+static size_t check_spans(const SRRingBuffer *ring, const byte_model *model, size_t length)
+{
+    struct iovec spans[2];
+    NSUInteger count = SRRingBufferReadableSpans(ring, spans);
+    size_t total = 0;
+    size_t compared = 0;
+    NSUInteger i;
+
+    for (i = 0; i < count; i++) {
+        size_t n = spans[i].iov_len < length - compared ? spans[i].iov_len : length - compared;
+        if (memcmp(spans[i].iov_base, model->bytes + model->head + compared, n) != 0) {
+            return (size_t)-1;
+        }
+        compared += n;
+        total += spans[i].iov_len;
+    }
+    return total;
+}
+
+int main(void)
+{
+    SRRingBuffer ring;
+    byte_model model = {0};
+    uint8_t chunk[MAX_CHUNK];
+    unsigned int seed = 0x5EED1234u;
+    uint8_t counter = 0;
+    long operation;
+
+    WATSON_CHECK(SRRingBufferInit(&ring, 100));
+    WATSON_CHECK(ring.capacity == 128);
+
+    for (operation = 0; operation < OPERATIONS && watson_test_failures == 0; operation++) {
+        unsigned int choice = watson_test_random(&seed) % 1000;
+        size_t readable = model.tail - model.head;
+        size_t length;
+
+        if (choice == 0) {
+            SRRingBufferClear(&ring);
+            model.head = model.tail = 0;
+        } else if (choice < (readable > HIGH_WATER ? 300u : 500u)) {
+            struct iovec spans[2];
+            NSUInteger count, i;
+            size_t written = 0;
+
+            length = watson_test_random(&seed) % (MAX_CHUNK + 1);
+            for (i = 0; i < length; i++) {
+                chunk[i] = counter++;
+            }
+            WATSON_CHECK(SRRingBufferReserve(&ring, length));
+            count = SRRingBufferWritableSpans(&ring, spans);
+            WATSON_CHECK(count <= 2);
+            for (i = 0; i < count && written < length; i++) {
+                size_t n = spans[i].iov_len < length - written ? spans[i].iov_len : length - written;
+                memcpy(spans[i].iov_base, chunk + written, n);
+                written += n;
+            }
+            WATSON_CHECK_MSG(written == length, "operation %ld: %zu writable of %zu reserved", operation, written, length);
+            SRRingBufferDidWrite(&ring, length);
+            model_append(&model, chunk, length);
+        } else if (choice < 850) {
+            length = readable ? watson_test_random(&seed) % (readable + 1) : 0;
+            WATSON_CHECK_MSG(check_spans(&ring, &model, length) == readable, "operation %ld: spans differ", operation);
+            SRRingBufferDidRead(&ring, length);
+            model.head += length;
+        } else {
+            const uint8_t *bytes;
+            length = readable ? watson_test_random(&seed) % (readable + 1) : 0;
+            bytes = SRRingBufferLinearize(&ring, length);
+            WATSON_CHECK(bytes != NULL);
+            WATSON_CHECK_MSG(bytes == NULL || memcmp(bytes, model.bytes + model.head, length) == 0,
+                             "operation %ld: linearized %zu bytes differ", operation, length);
+        }
+
+        WATSON_CHECK_MSG(SRRingBufferReadableLength(&ring) == model.tail - model.head,
+                         "operation %ld: %zu readable, model has %zu", operation,
+                         SRRingBufferReadableLength(&ring), model.tail - model.head);
+        WATSON_CHECK((ring.capacity & (ring.capacity - 1)) == 0);
+    }
+
+    WATSON_CHECK(check_spans(&ring, &model, model.tail - model.head) == model.tail - model.head);
+    SRRingBufferDestroy(&ring);
+    WATSON_CHECK(ring.bytes == NULL && ring.capacity == 0);
+    free(model.bytes);
+    return WATSON_TEST_RESULT();
+}
@@ -0,0 +1,228 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#include "SRUTF8Validator.h"
+#include "watson_test.h"
+#include <string.h>
+
+enum { REFERENCE_VALID, REFERENCE_TRUNCATED, REFERENCE_INVALID };
+
+/*
+ * Decodes code points directly and checks them against the rules the validator encodes as states.
+ * A truncated last sequence is still a valid prefix if some completion of it is a valid code point.
+ */
+static int reference_validate(const uint8_t *bytes, size_t length)
+{
+    size_t i = 0;
+
+    while (i < length) {
+        uint8_t lead = bytes[i];
+        size_t n, k, available;
+        uint32_t minimum, low, high, first, last;
+
+        if (lead < 0x80) {
+            i++;
+            continue;
+        } else if (lead >= 0xC0 && lead <= 0xDF) {
+            n = 2;
+            minimum = 0x80;
+            low = lead & 0x1F;
+        } else if (lead >= 0xE0 && lead <= 0xEF) {
+            n = 3;
+            minimum = 0x800;
+            low = lead & 0x0F;
+        } else if (lead >= 0xF0 && lead <= 0xF7) {
+            n = 4;
+            minimum = 0x10000;
+            low = lead & 0x07;
+        } else {
+            return REFERENCE_INVALID;
+        }
+
+        available = length - i < n ? length - i : n;
+        high = low;
+        for (k = 1; k < n; k++) {
+            if (k < available) {
+                if ((bytes[i + k] & 0xC0) != 0x80) {
+                    return REFERENCE_INVALID;
+                }
+                low = (low << 6) | (bytes[i + k] & 0x3F);
+                high = (high << 6) | (bytes[i + k] & 0x3F);
+            } else {
+                low = low << 6;
+                high = (high << 6) | 0x3F;
+            }
+        }
+
+        first = low > minimum ? low : minimum;
+        last = high < 0x10FFFF ? high : 0x10FFFF;
+        if (first > last || (first >= 0xD800 && last <= 0xDFFF)) {
+            return REFERENCE_INVALID;
+        }
+        if (available < n) {
+            return REFERENCE_TRUNCATED;
+        }
+        i += n;
+    }
+    return REFERENCE_VALID;
+}
+
+static int validate(const uint8_t *bytes, size_t length)
+{
+    SRUTF8Validator validator = {0};
+    if (!SRUTF8ValidatorConsume(&validator, bytes, length)) {
+        return REFERENCE_INVALID;
+    }
+    return SRUTF8ValidatorIsComplete(&validator) ? REFERENCE_VALID : REFERENCE_TRUNCATED;
+}
+
+/* Feeds the message one slice at a time, the way frame payloads arrive */
+static int validate_split(const uint8_t *bytes, size_t length, size_t first_split, size_t second_split)
+{
+    SRUTF8Validator validator;
+    SRUTF8ValidatorReset(&validator);
+    if (!SRUTF8ValidatorConsume(&validator, bytes, first_split) ||
+        !SRUTF8ValidatorConsume(&validator, bytes + first_split, second_split - first_split) ||
+        !SRUTF8ValidatorConsume(&validator, bytes + second_split, length - second_split)) {
+        return REFERENCE_INVALID;
+    }
+    return SRUTF8ValidatorIsComplete(&validator) ? REFERENCE_VALID : REFERENCE_TRUNCATED;
+}
+
+#define CHECK_CASE(expected, ...) \
+    do { \
+        const uint8_t bytes[] = {__VA_ARGS__}; \
+        WATSON_CHECK_MSG(validate(bytes, sizeof(bytes)) == (expected), "%s", #__VA_ARGS__); \
+        WATSON_CHECK_MSG(reference_validate(bytes, sizeof(bytes)) == (expected), "reference %s", #__VA_ARGS__); \
+    } while (0)
+
+int main(void)
+{
+    uint8_t text[1024];
+    unsigned int seed = 0x0DDBA11u;
+    uint32_t value;
+    size_t length, i, j, round;
+
+    /* overlong forms */
+    CHECK_CASE(REFERENCE_INVALID, 0xC0, 0x80);
+    CHECK_CASE(REFERENCE_INVALID, 0xC1, 0xBF);
+    CHECK_CASE(REFERENCE_INVALID, 0xE0, 0x80, 0x80);
+    CHECK_CASE(REFERENCE_INVALID, 0xE0, 0x9F, 0xBF);
+    CHECK_CASE(REFERENCE_INVALID, 0xF0, 0x8F, 0xBF, 0xBF);
+    CHECK_CASE(REFERENCE_VALID, 0xC2, 0x80);
+    CHECK_CASE(REFERENCE_VALID, 0xE0, 0xA0, 0x80);
+    CHECK_CASE(REFERENCE_VALID, 0xF0, 0x90, 0x80, 0x80);
+
+    /* surrogates */
+    CHECK_CASE(REFERENCE_INVALID, 0xED, 0xA0, 0x80);
+    CHECK_CASE(REFERENCE_INVALID, 0xED, 0xBF, 0xBF);
+    CHECK_CASE(REFERENCE_VALID, 0xED, 0x9F, 0xBF);
+    CHECK_CASE(REFERENCE_VALID, 0xEE, 0x80, 0x80);
+
+    /* above U+10FFFF */
+    CHECK_CASE(REFERENCE_INVALID, 0xF4, 0x90, 0x80, 0x80);
+    CHECK_CASE(REFERENCE_INVALID, 0xF5, 0x80, 0x80, 0x80);
+    CHECK_CASE(REFERENCE_INVALID, 0xFF);
+    CHECK_CASE(REFERENCE_VALID, 0xF4, 0x8F, 0xBF, 0xBF);
+
+    /* a message that ends inside a code point is a valid prefix but not a complete message */
+    CHECK_CASE(REFERENCE_TRUNCATED, 'a', 0xE2, 0x82);
+    CHECK_CASE(REFERENCE_TRUNCATED, 0xF0, 0x9F, 0x98);
+    CHECK_CASE(REFERENCE_TRUNCATED, 0xC3);
+    CHECK_CASE(REFERENCE_INVALID, 0xED, 0xA0);
+    CHECK_CASE(REFERENCE_INVALID, 0xF4, 0x90);
+    CHECK_CASE(REFERENCE_INVALID, 0xE2, 'a');
+    CHECK_CASE(REFERENCE_INVALID, 0x80);
+
+    /* every code point, encoded and split at every byte */
+    for (value = 0; value <= 0x10FFFF; value++) {
+        uint8_t encoded[4];
+        int expected = (value >= 0xD800 && value <= 0xDFFF) ? REFERENCE_INVALID : REFERENCE_VALID;
+
+        if (value < 0x80) {
+            encoded[0] = (uint8_t)value;
+            length = 1;
+        } else if (value < 0x800) {
+            encoded[0] = (uint8_t)(0xC0 | (value >> 6));
+            encoded[1] = (uint8_t)(0x80 | (value & 0x3F));
+            length = 2;
+        } else if (value < 0x10000) {
+            encoded[0] = (uint8_t)(0xE0 | (value >> 12));
+            encoded[1] = (uint8_t)(0x80 | ((value >> 6) & 0x3F));
+            encoded[2] = (uint8_t)(0x80 | (value & 0x3F));
+            length = 3;
+        } else {
+            encoded[0] = (uint8_t)(0xF0 | (value >> 18));
+            encoded[1] = (uint8_t)(0x80 | ((value >> 12) & 0x3F));
+            encoded[2] = (uint8_t)(0x80 | ((value >> 6) & 0x3F));
+            encoded[3] = (uint8_t)(0x80 | (value & 0x3F));
+            length = 4;
+        }
+        for (i = 0; i <= length; i++) {
+            WATSON_CHECK_MSG(validate_split(encoded, length, i, i) == expected, "U+%04X split at %zu", value, i);
+        }
+        if (watson_test_failures > 0) {
+            return WATSON_TEST_RESULT();
+        }
+    }
+
+    /* every two and three byte sequence, whole and as a message ending early */
+    for (value = 0; value < 0x1000000; value++) {
+        uint8_t bytes[3] = {(uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value};
+        for (length = value < 0x10000 ? 2 : 3; length >= 1; length--) {
+            if (validate(bytes, length) != reference_validate(bytes, length)) {
+                WATSON_CHECK_MSG(0, "%02X %02X %02X length %zu", bytes[0], bytes[1], bytes[2], length);
+                return WATSON_TEST_RESULT();
+            }
+        }
+    }
+
+    /* random text with mostly ASCII runs, so the block scan hands off at every position */
+    for (round = 0; round < 200000 && watson_test_failures == 0; round++) {
+        int expected;
+        length = watson_test_random(&seed) % sizeof(text);
+        for (i = 0; i < length; i++) {
+            unsigned int r = watson_test_random(&seed);
+            if (r % 8 != 0) {
+                text[i] = (uint8_t)(r >> 8) & 0x7F;
+            } else if (r % 64 != 0) {
+                /* a well-formed lead and continuation soup, so long runs stay valid */
+                static const uint8_t bytes[] = {0xC3, 0xA9, 0xE2, 0x82, 0xAC, 0xF0, 0x9F, 0x98, 0x80};
+                text[i] = bytes[(r >> 8) % sizeof(bytes)];
+            } else {
+                text[i] = (uint8_t)(r >> 8);
+            }
+        }
+        expected = reference_validate(text, length);
+        i = length ? watson_test_random(&seed) % (length + 1) : 0;
+        j = i + (length - i ? watson_test_random(&seed) % (length - i + 1) : 0);
+        WATSON_CHECK_MSG(validate(text, length) == expected, "round %zu", round);
+        WATSON_CHECK_MSG(validate_split(text, length, i, j) == expected, "round %zu split at %zu and %zu", round, i, j);
+    }
+
+    /* a single bad byte after every length of ASCII prefix */
+    memset(text, 'x', sizeof(text));
+    for (i = 0; i < 80; i++) {
+        text[i] = 0xBF;
+        WATSON_CHECK_MSG(validate(text, 100) == REFERENCE_INVALID, "bad byte at %zu", i);
+        text[i] = 0xC3;
+        WATSON_CHECK_MSG(validate(text, i + 1) == REFERENCE_TRUNCATED, "lead byte at end %zu", i);
+        text[i] = 'x';
+    }
+
+    return WATSON_TEST_RESULT();
+}
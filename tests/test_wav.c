@@ -0,0 +1,149 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#include "watson_wav.h"
+#include "watson_test.h"
+#include <string.h>
+
+static void write_le16(unsigned char *dest, unsigned int value)
+{
+    dest[0] = (unsigned char)(value & 0xff);
+    dest[1] = (unsigned char)((value >> 8) & 0xff);
+}
+
+static void write_le32(unsigned char *dest, unsigned long value)
+{
+    write_le16(dest, (unsigned int)(value & 0xffff));
+    write_le16(dest + 2, (unsigned int)((value >> 16) & 0xffff));
+}
+
+static void test_written_header(void)
+{
+    unsigned char wav[WATSON_WAV_HEADER_SIZE + 64];
+    watson_wav_info info;
+
+    memset(wav, 0x55, sizeof(wav));
+    watson_wav_write_header(wav, 64, 22050, 1);
+
+    WATSON_CHECK(watson_wav_parse(wav, sizeof(wav), &info) == 0);
+    WATSON_CHECK(info.format == WATSON_WAV_FORMAT_PCM);
+    WATSON_CHECK(info.channels == 1);
+    WATSON_CHECK(info.sample_rate == 22050);
+    WATSON_CHECK(info.bits_per_sample == 16);
+    WATSON_CHECK(info.data_offset == WATSON_WAV_HEADER_SIZE);
+    WATSON_CHECK(info.data_length == 64);
+    WATSON_CHECK(watson_wav_sample_rate(wav, sizeof(wav)) == 22050);
+    WATSON_CHECK(watson_wav_tts_data_offset(wav, sizeof(wav)) == WATSON_WAV_HEADER_SIZE);
+}
+
+/* The service puts a LIST chunk before the data and leaves the data size unset */
+static void test_tts_stream_header(void)
+{
+    unsigned char wav[12 + 8 + 16 + 8 + 26 + 8 + 100];
+    unsigned char *cursor = wav;
+    watson_wav_info info;
+    size_t i;
+
+    memcpy(cursor, "RIFF", 4);
+    write_le32(cursor + 4, 0xffffffffUL);
+    memcpy(cursor + 8, "WAVE", 4);
+    cursor += 12;
+    memcpy(cursor, "fmt ", 4);
+    write_le32(cursor + 4, 16);
+    write_le16(cursor + 8, WATSON_WAV_FORMAT_PCM);
+    write_le16(cursor + 10, 1);
+    write_le32(cursor + 12, 22050);
+    write_le32(cursor + 16, 44100);
+    write_le16(cursor + 20, 2);
+    write_le16(cursor + 22, 16);
+    cursor += 8 + 16;
+    memcpy(cursor, "LIST", 4);
+    write_le32(cursor + 4, 26);
+    memset(cursor + 8, 'x', 26);
+    cursor += 8 + 26;
+    memcpy(cursor, "data", 4);
+    write_le32(cursor + 4, 0xffffffffUL);
+    cursor += 8;
+    for (i = 0; i < 100; i++) {
+        cursor[i] = (unsigned char)i;
+    }
+
+    WATSON_CHECK(watson_wav_parse(wav, sizeof(wav), &info) == 0);
+    WATSON_CHECK(info.data_offset == (size_t)(cursor - wav));
+    /* clamped to what is actually there */
+    WATSON_CHECK(info.data_length == 100);
+    WATSON_CHECK(watson_wav_tts_data_offset(wav, sizeof(wav)) == (size_t)(cursor - wav));
+
+    /* every truncation before the data chunk header is incomplete, not a crash */
+    for (i = 0; i < (size_t)(cursor - wav); i++) {
+        WATSON_CHECK_MSG(watson_wav_parse(wav, i, &info) != 0, "parsed a header cut at %zu bytes", i);
+    }
+}
+
+static void test_extensible_format(void)
+{
+    unsigned char wav[12 + 8 + 40 + 8 + 4];
+    unsigned char *cursor = wav;
+    watson_wav_info info;
+
+    memset(wav, 0, sizeof(wav));
+    memcpy(cursor, "RIFF", 4);
+    write_le32(cursor + 4, sizeof(wav) - 8);
+    memcpy(cursor + 8, "WAVE", 4);
+    cursor += 12;
+    memcpy(cursor, "fmt ", 4);
+    write_le32(cursor + 4, 40);
+    write_le16(cursor + 8, 0xFFFE);
+    write_le16(cursor + 10, 2);
+    write_le32(cursor + 12, 16000);
+    write_le16(cursor + 22, 16);
+    /* sub-format GUID starts with the actual format tag */
+    write_le16(cursor + 32, WATSON_WAV_FORMAT_PCM);
+    cursor += 8 + 40;
+    memcpy(cursor, "data", 4);
+    write_le32(cursor + 4, 4);
+
+    WATSON_CHECK(watson_wav_parse(wav, sizeof(wav), &info) == 0);
+    WATSON_CHECK(info.format == WATSON_WAV_FORMAT_PCM);
+    WATSON_CHECK(info.channels == 2);
+    WATSON_CHECK(info.sample_rate == 16000);
+    WATSON_CHECK(info.data_length == 4);
+}
+
+static void test_invalid(void)
+{
+    unsigned char wav[WATSON_WAV_HEADER_SIZE];
+    watson_wav_info info;
+
+    watson_wav_write_header(wav, 0, 16000, 1);
+    memcpy(wav, "RIFX", 4);
+    WATSON_CHECK(watson_wav_parse(wav, sizeof(wav), &info) != 0);
+
+    /* data before fmt has no format to go by */
+    watson_wav_write_header(wav, 0, 16000, 1);
+    memcpy(wav + 12, "data", 4);
+    WATSON_CHECK(watson_wav_parse(wav, sizeof(wav), &info) != 0);
+}
+
+int main(void)
+{
+    test_written_header();
+    test_tts_stream_header();
+    test_extensible_format();
+    test_invalid();
+    return WATSON_TEST_RESULT();
+}
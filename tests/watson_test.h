@@ -0,0 +1,59 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#ifndef WATSON_TEST_H
+#define WATSON_TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Minimal checks for the audio core regression tests, each test is its own executable run by ctest */
+
+static int watson_test_failures = 0;
+
+#define WATSON_CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            watson_test_failures++; \
+        } \
+    } while (0)
+
+#define WATSON_CHECK_MSG(condition, ...) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s: ", __FILE__, __LINE__, #condition); \
+            fprintf(stderr, __VA_ARGS__); \
+            fputc('\n', stderr); \
+            watson_test_failures++; \
+        } \
+    } while (0)
+
+#define WATSON_TEST_RESULT() (watson_test_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE)
+
+/* Deterministic xorshift so failures reproduce */
+static inline unsigned int watson_test_random(unsigned int *state)
+{
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+#endif
@@ -25,7 +25,13 @@
 @property (readonly) NSString *token;
 @property (copy, nonatomic) void (^tokenGenerator) (void (^tokenHandler)(NSString *token));
 
+// how long a generated token is used, and how long before it expires a token in use is refreshed in the background
+@property (nonatomic) NSTimeInterval tokenLifetime;
+@property (nonatomic) NSTimeInterval tokenRefreshMargin;
+@property (readonly) NSDate *tokenExpiry;
+
 - (void) invalidateToken;
 - (void) requestToken: (void(^)(AuthConfiguration *config)) completionHandler;
+- (void) prefetchToken;
 
 @end
@@ -15,40 +15,221 @@
  **/
 
 #import "AuthConfiguration.h"
+#import "AuthConfigurationInternal.h"
+#import "SpeechStreamingTaskDelegate.h"
+
+// Watson tokens are valid for an hour
+#define WATSONSDK_TOKEN_LIFETIME 3600
+#define WATSONSDK_TOKEN_REFRESH_MARGIN 300
+
+@interface AuthConfiguration ()
+
+// completion handlers waiting for the generation in flight, nil when none is running
+@property NSMutableArray *pendingTokenHandlers;
+@property (nonatomic, strong) dispatch_source_t tokenRefreshTimer;
+@property BOOL isTokenUsedSinceRefresh;
+@property NSURLSession *session;
+@property SpeechStreamingTaskDelegate *streamingDelegate;
+
+@end
 
 @implementation AuthConfiguration
 
 @synthesize basicAuthUsername = _basicAuthUsername;
 @synthesize basicAuthPassword = _basicAuthPassword;
+@synthesize token = _token;
+@synthesize tokenExpiry = _tokenExpiry;
 
 - (id) init
 {
     self = [super init];
     _token = nil;
+    _tokenLifetime = WATSONSDK_TOKEN_LIFETIME;
+    _tokenRefreshMargin = WATSONSDK_TOKEN_REFRESH_MARGIN;
     return self;
 }
 
+- (void)dealloc
+{
+    if (_tokenRefreshTimer != nil) {
+        dispatch_source_cancel(_tokenRefreshTimer);
+    }
+    [_session finishTasksAndInvalidate];
+}
+
+- (NSString *)token
+{
+    @synchronized (self) {
+        return _token;
+    }
+}
+
+- (NSDate *)tokenExpiry
+{
+    @synchronized (self) {
+        return _tokenExpiry;
+    }
+}
+
 - (void)invalidateToken
 {
-    _token = nil;
+    @synchronized (self) {
+        _token = nil;
+        _tokenExpiry = nil;
+        [self cancelTokenRefresh];
+    }
 }
 
+/**
+ *  requestToken - call the handler once a valid token is available. A cached token is used until
+ *  it expires; concurrent requests share one call to the tokenGenerator
+ *
+ *  @param completionHandler called with this configuration, possibly on the generator's thread
+ */
 - (void)requestToken:(void (^)(AuthConfiguration *))completionHandler
 {
-    if (self.tokenGenerator) {
-        if (!_token) {
-            self.tokenGenerator(^(NSString *token) {
-                _token = token;
-                completionHandler(self);
-            });
+    if (!self.tokenGenerator) {
+        completionHandler(self);
+        return;
+    }
+
+    BOOL isCached = NO;
+    BOOL shouldGenerate = NO;
+    @synchronized (self) {
+        if (_token && [_tokenExpiry timeIntervalSinceNow] > 0) {
+            isCached = YES;
+            self.isTokenUsedSinceRefresh = YES;
+            // inside the refresh margin with no timer to renew it, e.g. after a short tokenLifetime
+            if ([_tokenExpiry timeIntervalSinceNow] <= self.tokenRefreshMargin && self.tokenRefreshTimer == nil) {
+                shouldGenerate = [self beginTokenGeneration];
+            }
         } else {
-            completionHandler(self);
+            shouldGenerate = [self beginTokenGeneration];
+            [self.pendingTokenHandlers addObject:[completionHandler copy]];
         }
-    } else {
+    }
+
+    if (shouldGenerate) {
+        [self runTokenGenerator];
+    }
+    if (isCached) {
         completionHandler(self);
     }
 }
 
+/**
+ *  prefetchToken - generate a token ahead of the first request so no request waits for it
+ */
+- (void)prefetchToken
+{
+    if (!self.tokenGenerator) {
+        return;
+    }
+    BOOL shouldGenerate = NO;
+    @synchronized (self) {
+        if (!(_token && [_tokenExpiry timeIntervalSinceNow] > 0)) {
+            shouldGenerate = [self beginTokenGeneration];
+        }
+    }
+    if (shouldGenerate) {
+        [self runTokenGenerator];
+    }
+}
+
+#pragma mark token generation
+
+/**
+ *  Claim the single generation slot, called with self locked
+ *
+ *  @return YES if the caller has to runTokenGenerator, NO if a generation is already in flight
+ */
+- (BOOL)beginTokenGeneration
+{
+    if (self.pendingTokenHandlers != nil) {
+        return NO;
+    }
+    // requests made while it runs wait for it, unless the current token is still valid
+    self.pendingTokenHandlers = [[NSMutableArray alloc] init];
+    [self cancelTokenRefresh];
+    return YES;
+}
+
+/**
+ *  Call the tokenGenerator outside the lock, it may call back synchronously
+ */
+- (void)runTokenGenerator
+{
+    __weak AuthConfiguration *weakSelf = self;
+    self.tokenGenerator(^(NSString *token) {
+        [weakSelf didGenerateToken:token];
+    });
+}
+
+- (void)didGenerateToken:(NSString *)token
+{
+    NSArray *handlers;
+    @synchronized (self) {
+        if (token != nil) {
+            _token = token;
+            _tokenExpiry = [NSDate dateWithTimeIntervalSinceNow:self.tokenLifetime];
+            self.isTokenUsedSinceRefresh = NO;
+            [self scheduleTokenRefresh];
+        } else if (_token != nil && [_tokenExpiry timeIntervalSinceNow] <= 0) {
+            _token = nil;
+        }
+        handlers = self.pendingTokenHandlers;
+        self.pendingTokenHandlers = nil;
+    }
+
+    for (void (^handler)(AuthConfiguration *) in handlers) {
+        handler(self);
+    }
+}
+
+// called with self locked
+- (void)scheduleTokenRefresh
+{
+    [self cancelTokenRefresh];
+    NSTimeInterval delay = self.tokenLifetime - self.tokenRefreshMargin;
+    if (delay <= 0) {
+        return;
+    }
+
+    dispatch_source_t timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0));
+    dispatch_source_set_timer(timer, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), DISPATCH_TIME_FOREVER, (uint64_t)(delay * NSEC_PER_SEC / 10));
+    __weak AuthConfiguration *weakSelf = self;
+    dispatch_source_set_event_handler(timer, ^{
+        [weakSelf refreshTokenIfUsed];
+    });
+    dispatch_resume(timer);
+    self.tokenRefreshTimer = timer;
+}
+
+- (void)cancelTokenRefresh
+{
+    if (self.tokenRefreshTimer != nil) {
+        dispatch_source_cancel(self.tokenRefreshTimer);
+        self.tokenRefreshTimer = nil;
+    }
+}
+
+/**
+ *  only tokens that were used since the last generation are renewed, an idle configuration lets its token expire
+ */
+- (void)refreshTokenIfUsed
+{
+    BOOL shouldGenerate = NO;
+    @synchronized (self) {
+        [self cancelTokenRefresh];
+        if (self.isTokenUsedSinceRefresh) {
+            shouldGenerate = [self beginTokenGeneration];
+        }
+    }
+    if (shouldGenerate && self.tokenGenerator) {
+        [self runTokenGenerator];
+    }
+}
+
 - (NSMutableDictionary*) _createRequestHeaders {
     NSMutableDictionary *headers = [[NSMutableDictionary alloc] init];
     if (self.tokenGenerator) {
@@ -74,6 +255,61 @@
     return headers;
 }
 
+/**
+ *  sharedSession - one session per configuration so REST calls share its connection pool, TLS
+ *  sessions and HTTP/2 connections. Completion handlers run on the main queue
+ *
+ *  @return NSURLSession
+ */
+- (NSURLSession*) sharedSession {
+    @synchronized (self) {
+        if (self.session == nil) {
+            NSURLSessionConfiguration *sessionConfig = [NSURLSessionConfiguration defaultSessionConfiguration];
+            // the session keeps its delegate until it is invalidated, which happens in dealloc
+            self.streamingDelegate = [[SpeechStreamingTaskDelegate alloc] init];
+            self.session = [NSURLSession sessionWithConfiguration:sessionConfig delegate:self.streamingDelegate delegateQueue:[NSOperationQueue mainQueue]];
+        }
+        return self.session;
+    }
+}
+
+/**
+ *  streamingDataTaskWithRequest - a task on the shared session that hands over the body as it arrives
+ *  instead of once it is complete. Handlers run on a serial background queue
+ *
+ *  @param request           request
+ *  @param dataHandler       called with every chunk of the body
+ *  @param completionHandler called once after the last chunk
+ *
+ *  @return NSURLSessionDataTask, not resumed yet
+ */
+- (NSURLSessionDataTask*) streamingDataTaskWithRequest:(NSURLRequest*) request dataHandler:(void (^)(NSURLResponse*, NSData*)) dataHandler completionHandler:(void (^)(NSURLResponse*, NSError*)) completionHandler {
+    NSURLSession *session = [self sharedSession];
+    NSURLSessionDataTask *task = [session dataTaskWithRequest:request];
+    [self.streamingDelegate addTask:task dataHandler:dataHandler completionHandler:completionHandler];
+    return task;
+}
+
+/**
+ *  requestWithURL - a request for the shared session; headers are set on each request since the token changes
+ *
+ *  @param url          URL
+ *  @param headers      authentication and other headers
+ *  @param withoutCache ignore cached responses
+ *
+ *  @return NSMutableURLRequest
+ */
+- (NSMutableURLRequest*) requestWithURL:(NSURL*) url headers:(NSDictionary*) headers disableCache:(BOOL) withoutCache {
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:url];
+    if (withoutCache) {
+        [request setCachePolicy:NSURLRequestReloadIgnoringLocalCacheData];
+    }
+    for (NSString *headerName in headers) {
+        [request setValue:[headers objectForKey:headerName] forHTTPHeaderField:headerName];
+    }
+    return request;
+}
+
 - (NSDictionary*) createRequestHeaders {
     return [self _createRequestHeaders];
 }
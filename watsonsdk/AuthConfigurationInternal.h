@@ -19,4 +19,7 @@
 @interface AuthConfiguration (Internal)
 - (NSDictionary*) createRequestHeaders;
 - (NSDictionary*) createRequestHeadersWithXWatsonLearningOptOut;
+- (NSURLSession*) sharedSession;
+- (NSMutableURLRequest*) requestWithURL:(NSURL*) url headers:(NSDictionary*) headers disableCache:(BOOL) withoutCache;
+- (NSURLSessionDataTask*) streamingDataTaskWithRequest:(NSURLRequest*) request dataHandler:(void (^)(NSURLResponse*, NSData*)) dataHandler completionHandler:(void (^)(NSURLResponse*, NSError*)) completionHandler;
 @end
@@ -0,0 +1,32 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#import <Foundation/Foundation.h>
+
+typedef void (^SpeechStreamingDataHandler)(NSURLResponse *response, NSData *chunk);
+typedef void (^SpeechStreamingCompletionHandler)(NSURLResponse *response, NSError *error);
+
+/**
+ *  Delegate of a configuration's shared session. Tasks created with a completion handler never
+ *  reach it; streaming tasks registered here get their data as it arrives, on a serial queue
+ *  off the main thread so decoding does not compete with the UI
+ */
+@interface SpeechStreamingTaskDelegate : NSObject <NSURLSessionDataDelegate>
+
+- (void) addTask:(NSURLSessionTask*) task dataHandler:(SpeechStreamingDataHandler) dataHandler completionHandler:(SpeechStreamingCompletionHandler) completionHandler;
+
+@end
@@ -0,0 +1,99 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#import "SpeechStreamingTaskDelegate.h"
+
+@interface SpeechStreamingTask : NSObject
+
+@property (nonatomic, copy) SpeechStreamingDataHandler dataHandler;
+@property (nonatomic, copy) SpeechStreamingCompletionHandler completionHandler;
+
+@end
+
+@implementation SpeechStreamingTask
+@end
+
+@interface SpeechStreamingTaskDelegate ()
+
+@property NSMutableDictionary *tasks;
+@property (nonatomic, strong) dispatch_queue_t handlerQueue;
+
+@end
+
+@implementation SpeechStreamingTaskDelegate
+
+- (id) init {
+    self = [super init];
+    if (self) {
+        self.tasks = [[NSMutableDictionary alloc] init];
+        self.handlerQueue = dispatch_queue_create("com.ibm.watson.streaming", DISPATCH_QUEUE_SERIAL);
+    }
+    return self;
+}
+
+/**
+ *  Register a task before it is resumed
+ *
+ *  @param task              data task of the session this object is the delegate of
+ *  @param dataHandler       called with every chunk of the body, in order
+ *  @param completionHandler called once after the last chunk
+ */
+- (void) addTask:(NSURLSessionTask*) task dataHandler:(SpeechStreamingDataHandler) dataHandler completionHandler:(SpeechStreamingCompletionHandler) completionHandler {
+    SpeechStreamingTask *streamingTask = [[SpeechStreamingTask alloc] init];
+    streamingTask.dataHandler = dataHandler;
+    streamingTask.completionHandler = completionHandler;
+    @synchronized (self.tasks) {
+        [self.tasks setObject:streamingTask forKey:[NSNumber numberWithUnsignedInteger:task.taskIdentifier]];
+    }
+}
+
+- (SpeechStreamingTask*) streamingTaskFor:(NSURLSessionTask*) task remove:(BOOL) remove {
+    NSNumber *key = [NSNumber numberWithUnsignedInteger:task.taskIdentifier];
+    @synchronized (self.tasks) {
+        SpeechStreamingTask *streamingTask = [self.tasks objectForKey:key];
+        if (remove) {
+            [self.tasks removeObjectForKey:key];
+        }
+        return streamingTask;
+    }
+}
+
+#pragma mark - NSURLSessionDataDelegate
+
+- (void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask didReceiveData:(NSData *)data {
+    SpeechStreamingTask *streamingTask = [self streamingTaskFor:dataTask remove:NO];
+    if (streamingTask.dataHandler == nil) {
+        return;
+    }
+    NSURLResponse *response = dataTask.response;
+    dispatch_async(self.handlerQueue, ^{
+        streamingTask.dataHandler(response, data);
+    });
+}
+
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error {
+    SpeechStreamingTask *streamingTask = [self streamingTaskFor:task remove:YES];
+    if (streamingTask.completionHandler == nil) {
+        return;
+    }
+    NSURLResponse *response = task.response;
+    dispatch_async(self.handlerQueue, ^{
+        streamingTask.completionHandler(response, error);
+    });
+}
+
+@end
@@ -0,0 +1,299 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#include "watson_ogg_muxer.h"
+#include "opus_header.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define WATSON_OGG_VENDOR_STRING "IBM"
+#define WATSON_OGG_COMMENT_STRING "libopus"
+
+static void write_le32(unsigned char *dest, ogg_uint32_t value)
+{
+    dest[0] = (unsigned char)(value & 0xff);
+    dest[1] = (unsigned char)((value >> 8) & 0xff);
+    dest[2] = (unsigned char)((value >> 16) & 0xff);
+    dest[3] = (unsigned char)((value >> 24) & 0xff);
+}
+
+/* Largest packet libopus produces, 1275 bytes per 20ms plus the code 3 framing */
+#define OPUS_MAX_BYTES_PER_20MS 1275
+#define OPUS_MAX_FRAMING_BYTES 7
+/* Fixed part of an Ogg page header, the lacing table follows */
+#define OGG_PAGE_HEADER_BYTES 27
+
+typedef struct {
+    unsigned char *out;
+    size_t capacity;
+    size_t length;
+    int overflow;
+} page_writer;
+
+static void write_page(void *context, const unsigned char *header, long header_len,
+                       const unsigned char *body, long body_len)
+{
+    page_writer *writer = (page_writer *)context;
+    size_t needed = (size_t)header_len + (size_t)body_len;
+
+    if (writer->overflow || needed > writer->capacity - writer->length) {
+        writer->overflow = 1;
+        return;
+    }
+    memcpy(writer->out + writer->length, header, (size_t)header_len);
+    memcpy(writer->out + writer->length + header_len, body, (size_t)body_len);
+    writer->length += needed;
+}
+
+static int emit_page(watson_ogg_muxer *mux, watson_ogg_page_callback callback, void *context)
+{
+    if (callback) {
+        callback(context, mux->page.header, mux->page.header_len, mux->page.body, mux->page.body_len);
+    }
+    return 1;
+}
+
+int watson_ogg_muxer_init(watson_ogg_muxer *mux, int serialno)
+{
+    mux->packet_count = 0;
+    mux->granule_pos = 0;
+    mux->sample_rate = 48000;
+    mux->flush_interval = 0;
+    mux->max_packets_per_page = 0;
+    mux->page_fill = 0;
+    mux->page_start_granule = 0;
+    mux->packets_in_page = 0;
+    memset(&mux->page, 0, sizeof(mux->page));
+    return ogg_stream_init(&mux->stream, serialno);
+}
+
+void watson_ogg_muxer_set_page_control(watson_ogg_muxer *mux, int flush_interval_ms, int max_packets_per_page, int page_fill)
+{
+    mux->flush_interval = flush_interval_ms > 0 ? (ogg_int64_t)flush_interval_ms * 48 : 0;
+    mux->max_packets_per_page = max_packets_per_page > 0 ? max_packets_per_page : 0;
+    mux->page_fill = page_fill > 0 ? page_fill : 0;
+}
+
+void watson_ogg_muxer_clear(watson_ogg_muxer *mux)
+{
+    ogg_stream_clear(&mux->stream);
+}
+
+int watson_ogg_muxer_write_headers(watson_ogg_muxer *mux, opus_int32 sample_rate, int channels,
+                                   watson_ogg_page_callback callback, void *context)
+{
+    OpusHeader header;
+    unsigned char head_packet[19];
+    unsigned char tags_packet[8 + 4 + sizeof(WATSON_OGG_VENDOR_STRING) - 1 + 4 + 4 + sizeof(WATSON_OGG_COMMENT_STRING) - 1];
+    unsigned char *cursor;
+    int head_len;
+    int pages = 0;
+    ogg_packet op;
+
+    mux->packet_count = 0;
+    mux->granule_pos = 0;
+    mux->sample_rate = sample_rate > 0 ? sample_rate : 48000;
+    mux->page_start_granule = 0;
+    mux->packets_in_page = 0;
+
+    memset(&header, 0, sizeof(header));
+    header.channels = channels;
+    header.preskip = 0;
+    header.input_sample_rate = (ogg_uint32_t)sample_rate;
+    header.gain = 0;
+    header.channel_mapping = 0;
+    head_len = opus_header_to_packet(&header, head_packet, sizeof(head_packet));
+    if (head_len <= 0) {
+        return -1;
+    }
+
+    op.packet = head_packet;
+    op.bytes = head_len;
+    op.b_o_s = 1;
+    op.e_o_s = 0;
+    op.granulepos = 0;
+    op.packetno = mux->packet_count++;
+    if (ogg_stream_packetin(&mux->stream, &op) != 0) {
+        return -1;
+    }
+    while (ogg_stream_flush(&mux->stream, &mux->page)) {
+        pages += emit_page(mux, callback, context);
+    }
+
+    // OpusTags: vendor string followed by a single user comment
+    cursor = tags_packet;
+    memcpy(cursor, "OpusTags", 8);
+    cursor += 8;
+    write_le32(cursor, sizeof(WATSON_OGG_VENDOR_STRING) - 1);
+    cursor += 4;
+    memcpy(cursor, WATSON_OGG_VENDOR_STRING, sizeof(WATSON_OGG_VENDOR_STRING) - 1);
+    cursor += sizeof(WATSON_OGG_VENDOR_STRING) - 1;
+    write_le32(cursor, 1);
+    cursor += 4;
+    write_le32(cursor, sizeof(WATSON_OGG_COMMENT_STRING) - 1);
+    cursor += 4;
+    memcpy(cursor, WATSON_OGG_COMMENT_STRING, sizeof(WATSON_OGG_COMMENT_STRING) - 1);
+
+    op.packet = tags_packet;
+    op.bytes = sizeof(tags_packet);
+    op.b_o_s = 0;
+    op.e_o_s = 0;
+    op.granulepos = 0;
+    op.packetno = mux->packet_count++;
+    if (ogg_stream_packetin(&mux->stream, &op) != 0) {
+        return -1;
+    }
+    while (ogg_stream_flush(&mux->stream, &mux->page)) {
+        pages += emit_page(mux, callback, context);
+    }
+
+    return pages;
+}
+
+int watson_ogg_muxer_write_packet(watson_ogg_muxer *mux, const unsigned char *packet, long bytes, int frame_size,
+                                  watson_ogg_page_callback callback, void *context)
+{
+    int pages = 0;
+    ogg_packet op;
+
+    op.packet = (unsigned char *)packet;
+    op.bytes = bytes;
+    op.b_o_s = 0;
+    op.e_o_s = 0;
+    // Ogg Opus granule positions always count 48 kHz samples, whatever the input rate
+    mux->granule_pos += (ogg_int64_t)frame_size * 48000 / mux->sample_rate;
+    op.granulepos = mux->granule_pos;
+    op.packetno = mux->packet_count++;
+    if (ogg_stream_packetin(&mux->stream, &op) != 0) {
+        return -1;
+    }
+    mux->packets_in_page++;
+
+    if ((mux->max_packets_per_page > 0 && mux->packets_in_page >= mux->max_packets_per_page) ||
+        (mux->flush_interval > 0 && mux->granule_pos - mux->page_start_granule >= mux->flush_interval)) {
+        // close the page now so the audio goes out at a predictable cadence
+        while (ogg_stream_flush(&mux->stream, &mux->page)) {
+            pages += emit_page(mux, callback, context);
+        }
+    } else if (mux->page_fill > 0) {
+        while (ogg_stream_pageout_fill(&mux->stream, &mux->page, mux->page_fill)) {
+            pages += emit_page(mux, callback, context);
+        }
+    } else {
+        while (ogg_stream_pageout(&mux->stream, &mux->page)) {
+            pages += emit_page(mux, callback, context);
+        }
+    }
+
+    if (pages > 0) {
+        mux->page_start_granule = ogg_page_granulepos(&mux->page);
+        mux->packets_in_page = 0;
+    }
+    return pages;
+}
+
+static long max_packet_size(opus_int32 sample_rate, int frame_size)
+{
+    long frames_20ms = ((long)frame_size * 50 + sample_rate - 1) / sample_rate;
+    return OPUS_MAX_BYTES_PER_20MS * (frames_20ms > 0 ? frames_20ms : 1) + OPUS_MAX_FRAMING_BYTES;
+}
+
+size_t watson_ogg_muxer_encode_bound(const watson_ogg_muxer *mux, opus_int32 sample_rate, long samples, int frame_size)
+{
+    size_t frames = 0;
+    size_t body;
+    size_t lacing;
+    size_t pages;
+    size_t fill;
+
+    if (sample_rate <= 0 || frame_size <= 0 || samples < 0) {
+        return 0;
+    }
+    frames = (size_t)((samples + frame_size - 1) / frame_size);
+    // flushes close pages at libogg's 4096 bytes whatever the fill setting
+    fill = mux->page_fill > 0 && mux->page_fill < 4096 ? (size_t)mux->page_fill : 4096;
+
+    // packets left in the stream by an earlier call without flush are paged out by this one
+    body = (size_t)(mux->stream.body_fill - mux->stream.body_returned);
+    lacing = (size_t)mux->stream.lacing_fill;
+    if (frames > 0) {
+        long packet = max_packet_size(sample_rate, frame_size);
+        body += frames * (size_t)packet;
+        lacing += frames * (size_t)(packet / 255 + 1);
+    }
+    if (body == 0 && lacing == 0) {
+        return 0;
+    }
+
+    // every lacing value and body byte lands on exactly one page. A page closes once it holds
+    // the fill size, on 255 lacing values, or when forced by the packet or time limits, which
+    // happens at most once per packet, plus the final flush
+    pages = body / fill + lacing / 255 + frames + 2;
+    return body + lacing + pages * OGG_PAGE_HEADER_BYTES;
+}
+
+long watson_ogg_muxer_encode(watson_ogg_muxer *mux, watson_opus_encoder *enc, const opus_int16 *pcm, long samples,
+                             int frame_size, int flush, unsigned char *out, size_t capacity)
+{
+    page_writer writer;
+    opus_int16 *padded = NULL;
+    int channels;
+    long offset;
+
+    if (!mux || !enc || !pcm || !out || frame_size <= 0 || samples < 0) {
+        return -1;
+    }
+    channels = watson_opus_encoder_channels(enc);
+
+    writer.out = out;
+    writer.capacity = capacity;
+    writer.length = 0;
+    writer.overflow = 0;
+
+    for (offset = 0; offset < samples; offset += frame_size) {
+        const opus_int16 *frame = pcm + offset * channels;
+        const unsigned char *packet;
+        opus_int32 packet_len = 0;
+
+        if (samples - offset < frame_size) {
+            long remaining = samples - offset;
+            padded = calloc((size_t)frame_size * channels, sizeof(opus_int16));
+            if (!padded) {
+                return -1;
+            }
+            memcpy(padded, frame, (size_t)(remaining * channels) * sizeof(opus_int16));
+            frame = padded;
+        }
+
+        packet = watson_opus_encoder_encode_frame(enc, frame, frame_size, &packet_len);
+        if (!packet || watson_ogg_muxer_write_packet(mux, packet, packet_len, frame_size, write_page, &writer) < 0) {
+            free(padded);
+            return -1;
+        }
+    }
+    free(padded);
+
+    if (flush) {
+        while (ogg_stream_flush(&mux->stream, &mux->page)) {
+            emit_page(mux, write_page, &writer);
+        }
+        mux->page_start_granule = mux->granule_pos;
+        mux->packets_in_page = 0;
+    }
+
+    return writer.overflow ? -1 : (long)writer.length;
+}
@@ -0,0 +1,114 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#ifndef WATSON_OGG_MUXER_H
+#define WATSON_OGG_MUXER_H
+
+#include "ogg.h"
+#include "opus_types.h"
+#include "watson_opus_encoder.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  Receives every completed Ogg page, header and body point into libogg's page buffers
+ *  and are only valid for the duration of the call
+ */
+typedef void (*watson_ogg_page_callback)(void *context, const unsigned char *header, long header_len,
+                                         const unsigned char *body, long body_len);
+
+typedef struct {
+    ogg_stream_state stream;
+    ogg_page page;
+    ogg_int64_t packet_count;
+    ogg_int64_t granule_pos;
+    opus_int32 sample_rate;
+    ogg_int64_t flush_interval;     /* 48 kHz samples, 0 to let libogg decide */
+    int max_packets_per_page;       /* 0 for no limit */
+    int page_fill;                  /* body bytes before libogg closes a page, 0 for its default */
+    ogg_int64_t page_start_granule;
+    int packets_in_page;
+} watson_ogg_muxer;
+
+int watson_ogg_muxer_init(watson_ogg_muxer *mux, int serialno);
+void watson_ogg_muxer_clear(watson_ogg_muxer *mux);
+
+/**
+ *  Control when audio pages are closed. By default libogg only closes a page once it holds
+ *  about 4 kB, which at speech bitrates is seconds of audio
+ *
+ *  @param mux                  muxer
+ *  @param flush_interval_ms    flush a page once it spans this much audio, 0 to disable
+ *  @param max_packets_per_page flush a page once it holds this many packets, 0 to disable
+ *  @param page_fill            body size at which libogg closes a page on its own, 0 for its default
+ */
+void watson_ogg_muxer_set_page_control(watson_ogg_muxer *mux, int flush_interval_ms, int max_packets_per_page, int page_fill);
+
+/**
+ *  Write the OpusHead and OpusTags packets, each flushed onto its own page
+ *
+ *  @return number of pages emitted or -1 on error
+ */
+int watson_ogg_muxer_write_headers(watson_ogg_muxer *mux, opus_int32 sample_rate, int channels,
+                                   watson_ogg_page_callback callback, void *context);
+
+/**
+ *  Write one Opus packet, pages are emitted as libogg completes them. The granule position
+ *  advances in 48 kHz units for frame_size samples at the rate given to watson_ogg_muxer_write_headers
+ *
+ *  @return number of pages emitted or -1 on error
+ */
+int watson_ogg_muxer_write_packet(watson_ogg_muxer *mux, const unsigned char *packet, long bytes, int frame_size,
+                                  watson_ogg_page_callback callback, void *context);
+
+/**
+ *  Upper bound on the bytes produced by the next watson_ogg_muxer_encode call for a span of PCM,
+ *  including packets still buffered in the stream and the page settings of the muxer
+ *
+ *  @param mux         muxer the span will be written to
+ *  @param sample_rate encoder sample rate
+ *  @param samples     samples per channel
+ *  @param frame_size  samples per channel in each Opus frame
+ */
+size_t watson_ogg_muxer_encode_bound(const watson_ogg_muxer *mux, opus_int32 sample_rate, long samples, int frame_size);
+
+/**
+ *  Encode a contiguous span of PCM frame by frame and mux the packets, writing the
+ *  completed Ogg pages back to back into out. A trailing partial frame is padded with silence
+ *
+ *  @param mux        muxer
+ *  @param enc        encoder
+ *  @param pcm        interleaved 16-bit PCM
+ *  @param samples    samples per channel
+ *  @param frame_size samples per channel in each Opus frame
+ *  @param flush      also flush the packets still buffered in the stream onto a final page
+ *  @param out        destination
+ *  @param capacity   size of out, watson_ogg_muxer_encode_bound is always sufficient
+ *
+ *  @return number of bytes written or -1 on error
+ */
+long watson_ogg_muxer_encode(watson_ogg_muxer *mux, watson_opus_encoder *enc, const opus_int16 *pcm, long samples,
+                             int frame_size, int flush, unsigned char *out, size_t capacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
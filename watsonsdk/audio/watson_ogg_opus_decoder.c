@@ -0,0 +1,371 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#include "watson_ogg_opus_decoder.h"
+#include "ogg.h"
+#include "opus.h"
+#include "opus_multistream.h"
+#include "opus_header.h"
+#include "watson_pcm_convert.h"
+#include "watson_opus_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* 120ms at 48000 */
+#define MAX_FRAME_SIZE (960*6)
+
+/*Largest slice of input copied into the Ogg sync buffer at once*/
+#define FEED_CHUNK_SIZE 8192
+
+struct watson_ogg_opus_decoder {
+    ogg_sync_state oy;
+    ogg_stream_state os;
+    watson_pooled_decoder *st;
+    float *output;
+    opus_int16 *out;
+    long opus_serialno;
+    ogg_int64_t page_granule;
+    ogg_int64_t link_out;
+    opus_int64 packet_count;
+    opus_int32 rate;
+    int channels;
+    int preskip;
+    int gran_offset;
+    int has_opus_stream;
+    int has_tags_packet;
+    int total_links;
+    int stream_init;
+    watson_pcm_format format;
+    watson_pcm_callback callback;
+    watson_pcm_float_callback float_callback;
+    void *context;
+};
+
+typedef struct watson_ogg_opus_decoder decoder_state;
+
+/*Process an Opus header and setup the opus decoder based on it.*/
+static watson_pooled_decoder *process_header(ogg_packet *op, opus_int32 *rate, int *channels, int *preskip)
+{
+    int err;
+    watson_pooled_decoder *st;
+    OpusHeader header;
+
+    if (opus_header_parse(op->packet, (int)op->bytes, &header)==0)
+    {
+        fprintf(stderr, "Cannot parse header\n");
+        return NULL;
+    }
+
+    *channels = header.channels;
+
+    if(!*rate)*rate=header.input_sample_rate;
+    /*If the rate is unspecified we decode to 48000*/
+    if(*rate==0)*rate=48000;
+    if(*rate<8000||*rate>192000){
+        fprintf(stderr,"Warning: Crazy input_rate %d, decoding to 48000 instead.\n",*rate);
+        *rate=48000;
+    }
+
+    *preskip = header.preskip;
+    /*Decoders come from the process-wide pool, already reset*/
+    st = watson_opus_pool_acquire_decoder(48000, header.channels, header.nb_streams, header.nb_coupled, header.stream_map, &err);
+    if(err != OPUS_OK || !st){
+        fprintf(stderr, "Cannot create decoder: %s\n", opus_strerror(err));
+        return NULL;
+    }
+    return st;
+}
+
+/*Drop the pre-skip and anything past maxout from a decoded packet and hand
+ it to the callbacks. The trim is applied in place by offsetting into the
+ decode buffers, 16-bit output is converted from float only in both mode.*/
+static opus_int64 audio_write(decoder_state *d, int frame_size, opus_int64 maxout)
+{
+    int tmp_skip;
+    opus_int64 out_len;
+    maxout=maxout<0?0:maxout;
+
+    tmp_skip = (d->preskip>frame_size) ? frame_size : d->preskip;
+    d->preskip -= tmp_skip;
+
+    out_len=frame_size-tmp_skip;
+    if(out_len>maxout)out_len=maxout;
+    if(out_len<=0)
+        return 0;
+
+    if(d->format & WATSON_PCM_FLOAT32)
+    {
+        float *output=d->output+d->channels*tmp_skip;
+        if(d->float_callback)
+            d->float_callback(d->context, output, (int)out_len, d->channels);
+        if(d->format & WATSON_PCM_INT16)
+        {
+            watson_float_to_int16(d->out, output, (size_t)(out_len*d->channels));
+            if(d->callback)
+                d->callback(d->context, d->out, (int)out_len, d->channels);
+        }
+    } else if(d->callback)
+    {
+        d->callback(d->context, d->out+d->channels*tmp_skip, (int)out_len, d->channels);
+    }
+    return out_len;
+}
+
+static void decoder_init(decoder_state *d, opus_int32 sample_rate, watson_pcm_callback callback, void *context)
+{
+    memset(d, 0, sizeof(decoder_state));
+    d->rate = sample_rate;
+    d->channels = -1;
+    d->format = WATSON_PCM_INT16;
+    d->callback = callback;
+    d->context = context;
+    ogg_sync_init(&d->oy);
+}
+
+static void decoder_clear(decoder_state *d)
+{
+    watson_opus_pool_release_decoder(d->st);
+    if (d->stream_init) ogg_stream_clear(&d->os);
+    ogg_sync_clear(&d->oy);
+    free(d->output);
+    free(d->out);
+}
+
+/*Consume every packet available on the current page.
+ Returns -1 if the stream is invalid.*/
+static int decoder_packets(decoder_state *d, ogg_page *og)
+{
+    ogg_packet op;
+
+    while (ogg_stream_packetout(&d->os, &op) == 1)
+    {
+        /*OggOpus streams are identified by a magic string in the initial
+         stream header.*/
+        if (op.b_o_s && op.bytes>=8 && !memcmp(op.packet, "OpusHead", 8)) {
+            if(d->has_opus_stream && d->has_tags_packet)
+            {
+                /*If we're seeing another BOS OpusHead now it means
+                 the stream is chained without an EOS.*/
+                d->has_opus_stream=0;
+                watson_opus_pool_release_decoder(d->st);
+                d->st=NULL;
+                fprintf(stderr, "Warning: stream ended without EOS and a new stream began\n");
+            }
+            if(!d->has_opus_stream)
+            {
+                if(d->packet_count>0 && d->opus_serialno==d->os.serialno)
+                {
+                    fprintf(stderr, "Apparent chaining without changing serial number\n");
+                    return -1;
+                }
+                d->opus_serialno = d->os.serialno;
+                d->has_opus_stream = 1;
+                d->has_tags_packet = 0;
+                d->link_out = 0;
+                d->packet_count = 0;
+                d->total_links++;
+            } else {
+                fprintf(stderr, "Warning: ignoring opus stream\n");
+            }
+        }
+
+        if (!d->has_opus_stream || d->os.serialno != d->opus_serialno)
+            break;
+        /*If first packet in a logical stream, process the Opus header*/
+        if (d->packet_count==0)
+        {
+            int channels = 0;
+            watson_opus_pool_release_decoder(d->st);
+            d->st = process_header(&op, &d->rate, &channels, &d->preskip);
+            if (!d->st)
+                return -1;
+
+            if(ogg_stream_packetout(&d->os, &op)!=0 || og->header[og->header_len-1]==255)
+            {
+                /*The format specifies that the initial header and tags packets are on their
+                 own pages. To aid implementors in discovering that their files are wrong
+                 we reject them explicitly here. In some player designs files like this would
+                 fail even without an explicit test.*/
+                fprintf(stderr, "Extra packets on initial header page. Invalid stream.\n");
+                return -1;
+            }
+
+            /*Remember how many samples at the front we were told to skip
+             so that we can adjust the timestamp counting.*/
+            d->gran_offset=d->preskip;
+
+            if(channels>d->channels)
+            {
+                free(d->output);
+                free(d->out);
+                d->output=NULL;
+                d->out=NULL;
+                if(d->format & WATSON_PCM_FLOAT32)
+                {
+                    d->output=malloc(sizeof(float)*MAX_FRAME_SIZE*channels);
+                    if(!d->output)
+                        return -1;
+                }
+                if(d->format & WATSON_PCM_INT16)
+                {
+                    d->out=malloc(sizeof(opus_int16)*MAX_FRAME_SIZE*channels);
+                    if(!d->out)
+                        return -1;
+                }
+            }
+            d->channels=channels;
+        } else if (d->packet_count==1)
+        {
+            d->has_tags_packet=1;
+            if(ogg_stream_packetout(&d->os, &op)!=0 || og->header[og->header_len-1]==255)
+            {
+                fprintf(stderr, "Extra packets on initial tags page. Invalid stream.\n");
+                return -1;
+            }
+        } else {
+            int ret;
+            opus_int64 maxout;
+
+            /*Decode Opus packet, straight to 16-bit unless float output is wanted*/
+            if(d->format & WATSON_PCM_FLOAT32)
+                ret = opus_multistream_decode_float(d->st->decoder, (unsigned char*)op.packet, (int)op.bytes, d->output, MAX_FRAME_SIZE, 0);
+            else
+                ret = opus_multistream_decode(d->st->decoder, (unsigned char*)op.packet, (int)op.bytes, d->out, MAX_FRAME_SIZE, 0);
+
+            /*If the decoder returned less than zero, we have an error.*/
+            if (ret<0)
+            {
+                fprintf (stderr, "Decoding error: %s\n", opus_strerror(ret));
+                break;
+            }
+
+            /*This handles making sure that our output duration respects
+             the final end-trim by not letting the output sample count
+             get ahead of the granpos indicated value.*/
+            maxout=((d->page_granule-d->gran_offset)*d->rate/48000)-d->link_out;
+            d->link_out+=audio_write(d, ret, maxout);
+        }
+        d->packet_count++;
+    }
+    return 0;
+}
+
+static int decoder_feed(decoder_state *d, const unsigned char *data, size_t length)
+{
+    ogg_page og;
+    char *buffer;
+
+    /*Hand the input to the sync layer a slice at a time, so it only ever holds
+     one slice plus the page in progress, however large the input is.*/
+    while (length > 0)
+    {
+        size_t n = length < FEED_CHUNK_SIZE ? length : FEED_CHUNK_SIZE;
+
+        buffer = ogg_sync_buffer(&d->oy, (long)n);
+        if (!buffer)
+            return -1;
+        memcpy(buffer, data, n);
+        ogg_sync_wrote(&d->oy, (long)n);
+        data += n;
+        length -= n;
+
+        /*Loop for all complete pages we got*/
+        while (ogg_sync_pageout(&d->oy, &og)==1)
+        {
+            if (d->stream_init == 0) {
+                ogg_stream_init(&d->os, ogg_page_serialno(&og));
+                d->stream_init = 1;
+            }
+            if (ogg_page_serialno(&og) != d->os.serialno) {
+                /* so all streams are read. */
+                ogg_stream_reset_serialno(&d->os, ogg_page_serialno(&og));
+            }
+            /*Add page to the bitstream*/
+            ogg_stream_pagein(&d->os, &og);
+            d->page_granule = ogg_page_granulepos(&og);
+
+            if (decoder_packets(d, &og) < 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+watson_ogg_opus_decoder *watson_ogg_opus_decoder_create(opus_int32 sample_rate, watson_pcm_callback callback, void *context)
+{
+    decoder_state *d = malloc(sizeof(decoder_state));
+    if (!d)
+        return NULL;
+    decoder_init(d, sample_rate, callback, context);
+    return d;
+}
+
+void watson_ogg_opus_decoder_destroy(watson_ogg_opus_decoder *dec)
+{
+    if (!dec)
+        return;
+    decoder_clear(dec);
+    free(dec);
+}
+
+int watson_ogg_opus_decoder_feed(watson_ogg_opus_decoder *dec, const unsigned char *data, size_t length)
+{
+    if (!dec || (!data && length))
+        return -1;
+    return decoder_feed(dec, data, length);
+}
+
+int watson_ogg_opus_decoder_set_output(watson_ogg_opus_decoder *dec, watson_pcm_format format,
+                                       watson_pcm_float_callback float_callback)
+{
+    if (!dec || dec->channels > 0 || (format & WATSON_PCM_BOTH) == 0 || (format & ~WATSON_PCM_BOTH) != 0)
+        return -1;
+    dec->format = format;
+    dec->float_callback = float_callback;
+    return 0;
+}
+
+opus_int32 watson_ogg_opus_decoder_sample_rate(const watson_ogg_opus_decoder *dec)
+{
+    return dec && dec->st ? dec->rate : 0;
+}
+
+int watson_ogg_opus_decoder_channels(const watson_ogg_opus_decoder *dec)
+{
+    return dec && dec->st ? dec->channels : 0;
+}
+
+int watson_ogg_opus_decoder_has_stream(const watson_ogg_opus_decoder *dec)
+{
+    return dec && dec->total_links > 0;
+}
+
+int watson_ogg_opus_decode(const unsigned char *data, size_t length, opus_int32 sample_rate,
+                           watson_pcm_callback callback, void *context)
+{
+    decoder_state d;
+    int ret;
+
+    decoder_init(&d, sample_rate, callback, context);
+    ret = decoder_feed(&d, data, length);
+    if(ret == 0 && !d.total_links) {
+        fprintf (stderr, "This doesn't look like a Opus file\n");
+    }
+    decoder_clear(&d);
+    return ret;
+}
@@ -0,0 +1,123 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#ifndef WATSON_OGG_OPUS_DECODER_H
+#define WATSON_OGG_OPUS_DECODER_H
+
+#include <stddef.h>
+#include "opus_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  Receives decoded, interleaved 16-bit PCM. The buffer is only valid for the duration of the call
+ */
+typedef void (*watson_pcm_callback)(void *context, const opus_int16 *pcm, int samples, int channels);
+
+/**
+ *  Receives decoded, interleaved float PCM. The buffer is only valid for the duration of the call
+ */
+typedef void (*watson_pcm_float_callback)(void *context, const float *pcm, int samples, int channels);
+
+/**
+ *  Sample formats produced by the decoder
+ */
+typedef enum {
+    WATSON_PCM_INT16 = 1,
+    WATSON_PCM_FLOAT32 = 2,
+    WATSON_PCM_BOTH = WATSON_PCM_INT16 | WATSON_PCM_FLOAT32
+} watson_pcm_format;
+
+/**
+ *  Push-style Ogg Opus decoder, keeps the Ogg sync, stream and Opus decoder state between chunks
+ */
+typedef struct watson_ogg_opus_decoder watson_ogg_opus_decoder;
+
+/**
+ *  Create a streaming decoder
+ *
+ *  @param sample_rate output sample rate used for the end-trim computation, 0 to use the rate in the header
+ *  @param callback    called for every decoded packet
+ *  @param context     passed to the callback
+ *
+ *  @return decoder, or NULL if out of memory
+ */
+watson_ogg_opus_decoder *watson_ogg_opus_decoder_create(opus_int32 sample_rate, watson_pcm_callback callback, void *context);
+
+void watson_ogg_opus_decoder_destroy(watson_ogg_opus_decoder *dec);
+
+/**
+ *  Feed a chunk of an Ogg Opus stream, chunks may split pages anywhere.
+ *  PCM is delivered through the callback as soon as a page is complete
+ *
+ *  @param dec    decoder
+ *  @param data   Ogg Opus bytes
+ *  @param length number of bytes
+ *
+ *  @return 0 on success, -1 if the stream is invalid
+ */
+int watson_ogg_opus_decoder_feed(watson_ogg_opus_decoder *dec, const unsigned char *data, size_t length);
+
+/**
+ *  Select the output format, must be called before the first chunk is fed.
+ *  16-bit output (the default) decodes directly to int16 without an intermediate float buffer
+ *
+ *  @param dec            decoder
+ *  @param format         output format
+ *  @param float_callback receives float PCM in WATSON_PCM_FLOAT32 and WATSON_PCM_BOTH modes
+ *
+ *  @return 0 on success, -1 if the format is invalid or decoding has started
+ */
+int watson_ogg_opus_decoder_set_output(watson_ogg_opus_decoder *dec, watson_pcm_format format,
+                                       watson_pcm_float_callback float_callback);
+
+/**
+ *  Output sample rate, 0 until the header has been decoded
+ */
+opus_int32 watson_ogg_opus_decoder_sample_rate(const watson_ogg_opus_decoder *dec);
+
+/**
+ *  Number of output channels, 0 until the header has been decoded
+ */
+int watson_ogg_opus_decoder_channels(const watson_ogg_opus_decoder *dec);
+
+/**
+ *  Whether an Opus header has been seen in the data fed so far
+ */
+int watson_ogg_opus_decoder_has_stream(const watson_ogg_opus_decoder *dec);
+
+/**
+ *  Decode a complete Ogg Opus stream held in memory
+ *
+ *  @param data        Ogg Opus bytes
+ *  @param length      number of bytes
+ *  @param sample_rate output sample rate used for the end-trim computation, 0 to use the rate in the header
+ *  @param callback    called for every decoded packet
+ *  @param context     passed to the callback
+ *
+ *  @return 0 on success, -1 if the stream is invalid
+ */
+int watson_ogg_opus_decode(const unsigned char *data, size_t length, opus_int32 sample_rate,
+                           watson_pcm_callback callback, void *context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,175 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#include "watson_opus_encoder.h"
+#include <stdlib.h>
+
+struct watson_opus_encoder {
+    OpusEncoder *encoder;
+    opus_int32 sample_rate;
+    int channels;
+    int application;
+    opus_int32 default_complexity;
+    unsigned char output[WATSON_OPUS_MAX_PACKET_SIZE];
+};
+
+watson_opus_encoder *watson_opus_encoder_create(opus_int32 sample_rate, int channels, int application, int *error)
+{
+    int err = OPUS_OK;
+    watson_opus_encoder *enc = malloc(sizeof(watson_opus_encoder));
+    if (!enc) {
+        if (error) *error = OPUS_ALLOC_FAIL;
+        return NULL;
+    }
+    enc->encoder = opus_encoder_create(sample_rate, channels, application, &err);
+    if (err != OPUS_OK || !enc->encoder) {
+        free(enc);
+        if (error) *error = err != OPUS_OK ? err : OPUS_ALLOC_FAIL;
+        return NULL;
+    }
+    enc->sample_rate = sample_rate;
+    enc->channels = channels;
+    enc->application = application;
+    // the library default varies between versions, remember it so a reset can restore it
+    if (opus_encoder_ctl(enc->encoder, OPUS_GET_COMPLEXITY(&enc->default_complexity)) != OPUS_OK) {
+        enc->default_complexity = -1;
+    }
+    if (error) *error = OPUS_OK;
+    return enc;
+}
+
+void watson_opus_encoder_destroy(watson_opus_encoder *enc)
+{
+    if (!enc) return;
+    opus_encoder_destroy(enc->encoder);
+    free(enc);
+}
+
+int watson_opus_encoder_sample_rate(const watson_opus_encoder *enc)
+{
+    return enc->sample_rate;
+}
+
+int watson_opus_encoder_channels(const watson_opus_encoder *enc)
+{
+    return enc->channels;
+}
+
+int watson_opus_encoder_application(const watson_opus_encoder *enc)
+{
+    return enc->application;
+}
+
+int watson_opus_encoder_reset(watson_opus_encoder *enc)
+{
+    watson_opus_encoder_profile profile;
+    int err;
+
+    if (!enc) {
+        return OPUS_BAD_ARG;
+    }
+    // OPUS_RESET_STATE clears the signal history but keeps ctl settings, so restore those too
+    err = opus_encoder_ctl(enc->encoder, OPUS_RESET_STATE);
+    if (err != OPUS_OK) {
+        return err;
+    }
+    watson_opus_encoder_profile_init(&profile);
+    profile.complexity = enc->default_complexity;
+    return watson_opus_encoder_apply_profile(enc, &profile);
+}
+
+int watson_opus_encoder_set_bitrate(watson_opus_encoder *enc, opus_int32 bitrate)
+{
+    return opus_encoder_ctl(enc->encoder, OPUS_SET_BITRATE(bitrate));
+}
+
+void watson_opus_encoder_profile_init(watson_opus_encoder_profile *profile)
+{
+    profile->bitrate = OPUS_AUTO;
+    profile->complexity = -1;
+    profile->vbr = 1;
+    profile->dtx = 0;
+    profile->inband_fec = 0;
+    profile->packet_loss_perc = 0;
+}
+
+int watson_opus_encoder_apply_profile(watson_opus_encoder *enc, const watson_opus_encoder_profile *profile)
+{
+    int err;
+
+    if (!enc || !profile) {
+        return OPUS_BAD_ARG;
+    }
+    err = opus_encoder_ctl(enc->encoder, OPUS_SET_BITRATE(profile->bitrate));
+    if (err == OPUS_OK && profile->complexity >= 0) {
+        err = opus_encoder_ctl(enc->encoder, OPUS_SET_COMPLEXITY(profile->complexity));
+    }
+    if (err == OPUS_OK) {
+        err = opus_encoder_ctl(enc->encoder, OPUS_SET_VBR(profile->vbr ? 1 : 0));
+    }
+    if (err == OPUS_OK) {
+        err = opus_encoder_ctl(enc->encoder, OPUS_SET_DTX(profile->dtx ? 1 : 0));
+    }
+    if (err == OPUS_OK) {
+        err = opus_encoder_ctl(enc->encoder, OPUS_SET_INBAND_FEC(profile->inband_fec ? 1 : 0));
+    }
+    if (err == OPUS_OK) {
+        err = opus_encoder_ctl(enc->encoder, OPUS_SET_PACKET_LOSS_PERC(profile->packet_loss_perc));
+    }
+    return err;
+}
+
+int watson_opus_encoder_valid_frame_size(const watson_opus_encoder *enc, int frame_size)
+{
+    // Opus frames are 2.5, 5, 10, 20, 40 or 60 ms, i.e. rate/400 times 1, 2, 4, 8, 16 or 24
+    int unit;
+    int multiple;
+
+    if (!enc || frame_size <= 0) {
+        return 0;
+    }
+    unit = enc->sample_rate / 400;
+    if (frame_size % unit != 0) {
+        return 0;
+    }
+    multiple = frame_size / unit;
+    return multiple == 1 || multiple == 2 || multiple == 4 || multiple == 8 || multiple == 16 || multiple == 24;
+}
+
+opus_int32 watson_opus_encoder_encode(watson_opus_encoder *enc, const opus_int16 *pcm, int frame_size,
+                                      unsigned char *out, opus_int32 capacity)
+{
+    if (!enc || !pcm || !out) {
+        return OPUS_BAD_ARG;
+    }
+    return opus_encode(enc->encoder, pcm, frame_size, out, capacity);
+}
+
+const unsigned char *watson_opus_encoder_encode_frame(watson_opus_encoder *enc, const opus_int16 *pcm, int frame_size,
+                                                      opus_int32 *length)
+{
+    opus_int32 ret;
+    if (!enc) {
+        return NULL;
+    }
+    ret = watson_opus_encoder_encode(enc, pcm, frame_size, enc->output, WATSON_OPUS_MAX_PACKET_SIZE);
+    if (ret < 0) {
+        return NULL;
+    }
+    if (length) *length = ret;
+    return enc->output;
+}
@@ -0,0 +1,106 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#ifndef WATSON_OPUS_ENCODER_H
+#define WATSON_OPUS_ENCODER_H
+
+#include "opus.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Output arena size, large enough for a 120ms packet at the highest bitrate */
+#define WATSON_OPUS_MAX_PACKET_SIZE 16000
+
+typedef struct watson_opus_encoder watson_opus_encoder;
+
+/**
+ *  Encoder tuning applied with watson_opus_encoder_apply_profile
+ */
+typedef struct {
+    opus_int32 bitrate;      /* bits per second, OPUS_AUTO for the library default */
+    int complexity;          /* 0-10, -1 for the library default */
+    int vbr;                 /* 1 for variable, 0 for constant bitrate */
+    int dtx;                 /* 1 to send almost empty packets during silence */
+    int inband_fec;          /* 1 to embed forward error correction for the previous frame */
+    int packet_loss_perc;    /* expected packet loss, 0-100, decides how much FEC is spent */
+} watson_opus_encoder_profile;
+
+/**
+ *  Create an Opus encoder
+ *
+ *  @param sample_rate 8000, 12000, 16000, 24000 or 48000
+ *  @param channels    1 or 2
+ *  @param application OPUS_APPLICATION_VOIP, OPUS_APPLICATION_AUDIO or OPUS_APPLICATION_RESTRICTED_LOWDELAY
+ *  @param error       receives the opus error code, may be NULL
+ *
+ *  @return encoder or NULL
+ */
+watson_opus_encoder *watson_opus_encoder_create(opus_int32 sample_rate, int channels, int application, int *error);
+void watson_opus_encoder_destroy(watson_opus_encoder *enc);
+
+int watson_opus_encoder_sample_rate(const watson_opus_encoder *enc);
+int watson_opus_encoder_channels(const watson_opus_encoder *enc);
+int watson_opus_encoder_application(const watson_opus_encoder *enc);
+
+/**
+ *  Return the encoder to its freshly created state with OPUS_RESET_STATE and the default profile
+ *
+ *  @return OPUS_OK or an opus error code
+ */
+int watson_opus_encoder_reset(watson_opus_encoder *enc);
+int watson_opus_encoder_set_bitrate(watson_opus_encoder *enc, opus_int32 bitrate);
+
+/**
+ *  Fill a profile with the library defaults
+ */
+void watson_opus_encoder_profile_init(watson_opus_encoder_profile *profile);
+
+/**
+ *  Apply bitrate, complexity, VBR, DTX and FEC settings
+ *
+ *  @return OPUS_OK or the first opus error code
+ */
+int watson_opus_encoder_apply_profile(watson_opus_encoder *enc, const watson_opus_encoder_profile *profile);
+
+/**
+ *  Whether a frame size in samples is one Opus can encode at the encoder's rate (2.5 to 60 ms)
+ */
+int watson_opus_encoder_valid_frame_size(const watson_opus_encoder *enc, int frame_size);
+
+/**
+ *  Encode one frame into a caller provided buffer
+ *
+ *  @return length of the packet or a negative opus error code
+ */
+opus_int32 watson_opus_encoder_encode(watson_opus_encoder *enc, const opus_int16 *pcm, int frame_size,
+                                      unsigned char *out, opus_int32 capacity);
+
+/**
+ *  Encode one frame into the encoder's preallocated arena
+ *
+ *  @return pointer to the packet, valid until the next encode call; NULL on error
+ */
+const unsigned char *watson_opus_encoder_encode_frame(watson_opus_encoder *enc, const opus_int16 *pcm, int frame_size,
+                                                      opus_int32 *length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
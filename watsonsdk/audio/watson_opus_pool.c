@@ -0,0 +1,233 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#include "watson_opus_pool.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static watson_pooled_decoder *idle_decoders[WATSON_OPUS_POOL_SIZE];
+static int idle_decoder_count = 0;
+static watson_opus_encoder *idle_encoders[WATSON_OPUS_POOL_SIZE];
+static int idle_encoder_count = 0;
+
+static int decoder_matches(const watson_pooled_decoder *d, opus_int32 sample_rate, int channels, int streams,
+                           int coupled_streams, const unsigned char *mapping)
+{
+    return d->sample_rate == sample_rate && d->channels == channels && d->streams == streams &&
+           d->coupled_streams == coupled_streams && memcmp(d->mapping, mapping, (size_t)channels) == 0;
+}
+
+static void destroy_decoder(watson_pooled_decoder *decoder)
+{
+    opus_multistream_decoder_destroy(decoder->decoder);
+    free(decoder);
+}
+
+static watson_pooled_decoder *create_decoder(opus_int32 sample_rate, int channels, int streams,
+                                             int coupled_streams, const unsigned char *mapping, int *error)
+{
+    int err = OPUS_OK;
+    watson_pooled_decoder *decoder = malloc(sizeof(watson_pooled_decoder));
+    if (!decoder) {
+        if (error) *error = OPUS_ALLOC_FAIL;
+        return NULL;
+    }
+    decoder->decoder = opus_multistream_decoder_create(sample_rate, channels, streams, coupled_streams, mapping, &err);
+    if (err != OPUS_OK || !decoder->decoder) {
+        free(decoder);
+        if (error) *error = err != OPUS_OK ? err : OPUS_ALLOC_FAIL;
+        return NULL;
+    }
+    decoder->sample_rate = sample_rate;
+    decoder->channels = channels;
+    decoder->streams = streams;
+    decoder->coupled_streams = coupled_streams;
+    memset(decoder->mapping, 0, sizeof(decoder->mapping));
+    memcpy(decoder->mapping, mapping, (size_t)channels);
+    if (error) *error = OPUS_OK;
+    return decoder;
+}
+
+watson_pooled_decoder *watson_opus_pool_acquire_decoder(opus_int32 sample_rate, int channels, int streams,
+                                                        int coupled_streams, const unsigned char *mapping, int *error)
+{
+    watson_pooled_decoder *decoder = NULL;
+    int i;
+
+    if (channels < 1 || channels > 255 || !mapping) {
+        if (error) *error = OPUS_BAD_ARG;
+        return NULL;
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    for (i = idle_decoder_count - 1; i >= 0; i--) {
+        if (decoder_matches(idle_decoders[i], sample_rate, channels, streams, coupled_streams, mapping)) {
+            decoder = idle_decoders[i];
+            idle_decoders[i] = idle_decoders[--idle_decoder_count];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    if (decoder) {
+        if (error) *error = OPUS_OK;
+        return decoder;
+    }
+    return create_decoder(sample_rate, channels, streams, coupled_streams, mapping, error);
+}
+
+void watson_opus_pool_release_decoder(watson_pooled_decoder *decoder)
+{
+    if (!decoder) {
+        return;
+    }
+    // reset outside the lock, it only touches this decoder
+    if (opus_multistream_decoder_ctl(decoder->decoder, OPUS_RESET_STATE) != OPUS_OK) {
+        destroy_decoder(decoder);
+        return;
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    if (idle_decoder_count < WATSON_OPUS_POOL_SIZE) {
+        idle_decoders[idle_decoder_count++] = decoder;
+        decoder = NULL;
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    if (decoder) {
+        destroy_decoder(decoder);
+    }
+}
+
+watson_opus_encoder *watson_opus_pool_acquire_encoder(opus_int32 sample_rate, int channels, int application, int *error)
+{
+    watson_opus_encoder *enc = NULL;
+    int i;
+
+    pthread_mutex_lock(&pool_lock);
+    for (i = idle_encoder_count - 1; i >= 0; i--) {
+        if (watson_opus_encoder_sample_rate(idle_encoders[i]) == sample_rate &&
+            watson_opus_encoder_channels(idle_encoders[i]) == channels &&
+            watson_opus_encoder_application(idle_encoders[i]) == application) {
+            enc = idle_encoders[i];
+            idle_encoders[i] = idle_encoders[--idle_encoder_count];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    if (enc) {
+        if (error) *error = OPUS_OK;
+        return enc;
+    }
+    return watson_opus_encoder_create(sample_rate, channels, application, error);
+}
+
+void watson_opus_pool_release_encoder(watson_opus_encoder *enc)
+{
+    if (!enc) {
+        return;
+    }
+    if (watson_opus_encoder_reset(enc) != OPUS_OK) {
+        watson_opus_encoder_destroy(enc);
+        return;
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    if (idle_encoder_count < WATSON_OPUS_POOL_SIZE) {
+        idle_encoders[idle_encoder_count++] = enc;
+        enc = NULL;
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    if (enc) {
+        watson_opus_encoder_destroy(enc);
+    }
+}
+
+void watson_opus_pool_prewarm(opus_int32 sample_rate, int channels, int encoders, int decoders)
+{
+    // family 0 layout, the same the decoder builds from an OpusHead with no mapping table
+    unsigned char mapping[2] = {0, 1};
+    int streams = 1;
+    int coupled_streams = channels > 1 ? 1 : 0;
+    int idle_encoders_for_key = 0;
+    int idle_decoders_for_key = 0;
+    int i;
+
+    if (channels < 1 || channels > 2) {
+        return;
+    }
+
+    // top up to the requested number of idle states, so repeated calls do not grow the pool
+    pthread_mutex_lock(&pool_lock);
+    for (i = 0; i < idle_encoder_count; i++) {
+        if (watson_opus_encoder_sample_rate(idle_encoders[i]) == sample_rate &&
+            watson_opus_encoder_channels(idle_encoders[i]) == channels &&
+            watson_opus_encoder_application(idle_encoders[i]) == OPUS_APPLICATION_VOIP) {
+            idle_encoders_for_key++;
+        }
+    }
+    for (i = 0; i < idle_decoder_count; i++) {
+        if (decoder_matches(idle_decoders[i], 48000, channels, streams, coupled_streams, mapping)) {
+            idle_decoders_for_key++;
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    for (i = idle_encoders_for_key; i < encoders && i < WATSON_OPUS_POOL_SIZE; i++) {
+        watson_opus_encoder *enc = watson_opus_encoder_create(sample_rate, channels, OPUS_APPLICATION_VOIP, NULL);
+        if (!enc) {
+            break;
+        }
+        watson_opus_pool_release_encoder(enc);
+    }
+    for (i = idle_decoders_for_key; i < decoders && i < WATSON_OPUS_POOL_SIZE; i++) {
+        watson_pooled_decoder *decoder = create_decoder(48000, channels, streams, coupled_streams, mapping, NULL);
+        if (!decoder) {
+            break;
+        }
+        watson_opus_pool_release_decoder(decoder);
+    }
+}
+
+void watson_opus_pool_drain(void)
+{
+    watson_pooled_decoder *decoders[WATSON_OPUS_POOL_SIZE];
+    watson_opus_encoder *encoders[WATSON_OPUS_POOL_SIZE];
+    int decoder_count;
+    int encoder_count;
+    int i;
+
+    pthread_mutex_lock(&pool_lock);
+    decoder_count = idle_decoder_count;
+    encoder_count = idle_encoder_count;
+    memcpy(decoders, idle_decoders, sizeof(decoders));
+    memcpy(encoders, idle_encoders, sizeof(encoders));
+    idle_decoder_count = 0;
+    idle_encoder_count = 0;
+    pthread_mutex_unlock(&pool_lock);
+
+    for (i = 0; i < decoder_count; i++) {
+        destroy_decoder(decoders[i]);
+    }
+    for (i = 0; i < encoder_count; i++) {
+        watson_opus_encoder_destroy(encoders[i]);
+    }
+}
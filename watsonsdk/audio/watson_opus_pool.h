@@ -0,0 +1,83 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#ifndef WATSON_OPUS_POOL_H
+#define WATSON_OPUS_POOL_H
+
+#include "opus.h"
+#include "opus_multistream.h"
+#include "watson_opus_encoder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Idle states kept per kind, beyond this released states are destroyed */
+#define WATSON_OPUS_POOL_SIZE 8
+
+/**
+ *  A multistream decoder together with the layout it was created for
+ */
+typedef struct {
+    OpusMSDecoder *decoder;
+    opus_int32 sample_rate;
+    int channels;
+    int streams;
+    int coupled_streams;
+    unsigned char mapping[255];
+} watson_pooled_decoder;
+
+/**
+ *  Take a decoder for the layout from the process-wide pool, creating one if none is idle.
+ *  Pooled decoders come back reset with OPUS_RESET_STATE
+ *
+ *  @return decoder or NULL, error receives the opus error code
+ */
+watson_pooled_decoder *watson_opus_pool_acquire_decoder(opus_int32 sample_rate, int channels, int streams,
+                                                        int coupled_streams, const unsigned char *mapping, int *error);
+void watson_opus_pool_release_decoder(watson_pooled_decoder *decoder);
+
+/**
+ *  Take an encoder for the rate, channels and application from the pool, creating one if none is idle.
+ *  Pooled encoders come back with OPUS_RESET_STATE and the default profile
+ *
+ *  @return encoder or NULL, error receives the opus error code
+ */
+watson_opus_encoder *watson_opus_pool_acquire_encoder(opus_int32 sample_rate, int channels, int application, int *error);
+void watson_opus_pool_release_encoder(watson_opus_encoder *enc);
+
+/**
+ *  Create idle states ahead of time so the first session does not pay for them. Tops the pool up
+ *  to the given counts, calling it again does not add more
+ *
+ *  @param sample_rate encoder rate, decoders always run at 48 kHz
+ *  @param channels    mono or stereo, decoders use the default channel mapping
+ *  @param encoders    idle encoders wanted for OPUS_APPLICATION_VOIP
+ *  @param decoders    idle decoders wanted
+ */
+void watson_opus_pool_prewarm(opus_int32 sample_rate, int channels, int encoders, int decoders);
+
+/**
+ *  Destroy every idle state, e.g. on a memory warning
+ */
+void watson_opus_pool_drain(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
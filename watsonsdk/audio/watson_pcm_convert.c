@@ -0,0 +1,139 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#include "watson_pcm_convert.h"
+#include <math.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define WATSON_CONVERT_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WATSON_CONVERT_SSE2 1
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+/* vminnmq/vmaxnmq are needed for the scalar NaN behaviour, they are ARMv8 only */
+#include <arm_neon.h>
+#define WATSON_CONVERT_NEON 1
+#endif
+
+/*
+ The scalar reference is floor(.5 + v) on the clamped value. Adding .5 in
+ single precision can round up values just below a half, so the vector paths
+ truncate and then look at the exact fractional part instead:
+ result = trunc(v) + (frac >= .5) - (frac < -.5).
+ The clamp is ordered min then max with the constant second so a NaN sample
+ saturates to 32767 like fminf/fmaxf do.
+ */
+
+static opus_int16 float_to_int16(float x)
+{
+    return (opus_int16)floor(.5 + fmaxf(-32768, fminf(x * 32768.f, 32767)));
+}
+
+void watson_float_to_int16(opus_int16 *dst, const float *src, size_t count)
+{
+    size_t i = 0;
+
+#if defined(WATSON_CONVERT_AVX2)
+    {
+        const __m256 scale = _mm256_set1_ps(32768.f);
+        const __m256 hi = _mm256_set1_ps(32767.f);
+        const __m256 lo = _mm256_set1_ps(-32768.f);
+        const __m256 half = _mm256_set1_ps(.5f);
+        const __m256 neg_half = _mm256_set1_ps(-.5f);
+
+        for (; i + 16 <= count; i += 16) {
+            __m256 v0 = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), hi), lo);
+            __m256 v1 = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale), hi), lo);
+            __m256i t0 = _mm256_cvttps_epi32(v0);
+            __m256i t1 = _mm256_cvttps_epi32(v1);
+            __m256 f0 = _mm256_sub_ps(v0, _mm256_cvtepi32_ps(t0));
+            __m256 f1 = _mm256_sub_ps(v1, _mm256_cvtepi32_ps(t1));
+            /* comparison masks are all ones, i.e. -1 as an integer */
+            t0 = _mm256_sub_epi32(t0, _mm256_castps_si256(_mm256_cmp_ps(f0, half, _CMP_GE_OQ)));
+            t0 = _mm256_add_epi32(t0, _mm256_castps_si256(_mm256_cmp_ps(f0, neg_half, _CMP_LT_OQ)));
+            t1 = _mm256_sub_epi32(t1, _mm256_castps_si256(_mm256_cmp_ps(f1, half, _CMP_GE_OQ)));
+            t1 = _mm256_add_epi32(t1, _mm256_castps_si256(_mm256_cmp_ps(f1, neg_half, _CMP_LT_OQ)));
+            /* packs works per 128-bit lane, restore sample order */
+            _mm256_storeu_si256((__m256i *)(dst + i), _mm256_permute4x64_epi64(_mm256_packs_epi32(t0, t1), 0xD8));
+        }
+    }
+#endif
+
+#if defined(WATSON_CONVERT_SSE2)
+    {
+        const __m128 scale = _mm_set1_ps(32768.f);
+        const __m128 hi = _mm_set1_ps(32767.f);
+        const __m128 lo = _mm_set1_ps(-32768.f);
+        const __m128 half = _mm_set1_ps(.5f);
+        const __m128 neg_half = _mm_set1_ps(-.5f);
+
+        for (; i + 8 <= count; i += 8) {
+            __m128 v0 = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), hi), lo);
+            __m128 v1 = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), hi), lo);
+            __m128i t0 = _mm_cvttps_epi32(v0);
+            __m128i t1 = _mm_cvttps_epi32(v1);
+            __m128 f0 = _mm_sub_ps(v0, _mm_cvtepi32_ps(t0));
+            __m128 f1 = _mm_sub_ps(v1, _mm_cvtepi32_ps(t1));
+            t0 = _mm_sub_epi32(t0, _mm_castps_si128(_mm_cmpge_ps(f0, half)));
+            t0 = _mm_add_epi32(t0, _mm_castps_si128(_mm_cmplt_ps(f0, neg_half)));
+            t1 = _mm_sub_epi32(t1, _mm_castps_si128(_mm_cmpge_ps(f1, half)));
+            t1 = _mm_add_epi32(t1, _mm_castps_si128(_mm_cmplt_ps(f1, neg_half)));
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(t0, t1));
+        }
+    }
+#endif
+
+#if defined(WATSON_CONVERT_NEON)
+    {
+        const float32x4_t scale = vdupq_n_f32(32768.f);
+        const float32x4_t hi = vdupq_n_f32(32767.f);
+        const float32x4_t lo = vdupq_n_f32(-32768.f);
+        const float32x4_t half = vdupq_n_f32(.5f);
+        const float32x4_t neg_half = vdupq_n_f32(-.5f);
+
+        for (; i + 8 <= count; i += 8) {
+            float32x4_t v0 = vmaxnmq_f32(vminnmq_f32(vmulq_f32(vld1q_f32(src + i), scale), hi), lo);
+            float32x4_t v1 = vmaxnmq_f32(vminnmq_f32(vmulq_f32(vld1q_f32(src + i + 4), scale), hi), lo);
+            int32x4_t t0 = vcvtq_s32_f32(v0);
+            int32x4_t t1 = vcvtq_s32_f32(v1);
+            float32x4_t f0 = vsubq_f32(v0, vcvtq_f32_s32(t0));
+            float32x4_t f1 = vsubq_f32(v1, vcvtq_f32_s32(t1));
+            t0 = vsubq_s32(t0, vreinterpretq_s32_u32(vcgeq_f32(f0, half)));
+            t0 = vaddq_s32(t0, vreinterpretq_s32_u32(vcltq_f32(f0, neg_half)));
+            t1 = vsubq_s32(t1, vreinterpretq_s32_u32(vcgeq_f32(f1, half)));
+            t1 = vaddq_s32(t1, vreinterpretq_s32_u32(vcltq_f32(f1, neg_half)));
+            vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(t0), vqmovn_s32(t1)));
+        }
+    }
+#endif
+
+    for (; i < count; i++) {
+        dst[i] = float_to_int16(src[i]);
+    }
+}
+
+void watson_float_to_int16_scalar(opus_int16 *dst, const float *src, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        dst[i] = float_to_int16(src[i]);
+    }
+}
@@ -0,0 +1,52 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#ifndef WATSON_PCM_CONVERT_H
+#define WATSON_PCM_CONVERT_H
+
+#include <stddef.h>
+#include "opus_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  Convert float PCM in [-1, 1] to 16-bit with saturation, rounding half up.
+ *  Uses SSE2, AVX2 or NEON when available; every path produces the same output
+ *  as floor(.5 + fmaxf(-32768, fminf(x * 32768, 32767)))
+ *
+ *  @param dst   destination, count samples
+ *  @param src   source, count samples
+ *  @param count number of samples
+ */
+void watson_float_to_int16(opus_int16 *dst, const float *src, size_t count);
+
+/**
+ *  The same conversion one sample at a time, the reference the vector paths are checked against
+ *
+ *  @param dst   destination, count samples
+ *  @param src   source, count samples
+ *  @param count number of samples
+ */
+void watson_float_to_int16_scalar(opus_int16 *dst, const float *src, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
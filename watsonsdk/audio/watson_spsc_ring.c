@@ -0,0 +1,109 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#include "watson_spsc_ring.h"
+#include <stdlib.h>
+#include <string.h>
+
+int watson_spsc_ring_init(watson_spsc_ring *ring, size_t capacity)
+{
+    size_t size = 1;
+
+    while (size < capacity) {
+        size <<= 1;
+    }
+    ring->buffer = malloc(size);
+    if (!ring->buffer) {
+        return -1;
+    }
+    ring->capacity = size;
+    ring->mask = size - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+    return 0;
+}
+
+void watson_spsc_ring_destroy(watson_spsc_ring *ring)
+{
+    free(ring->buffer);
+    ring->buffer = NULL;
+    ring->capacity = 0;
+    ring->mask = 0;
+}
+
+size_t watson_spsc_ring_write(watson_spsc_ring *ring, const void *data, size_t length)
+{
+    // head and tail run freely and are only masked on access, so head - tail is the fill level
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t space = ring->capacity - (head - tail);
+    size_t count = length < space ? length : space;
+    size_t offset = head & ring->mask;
+    size_t first = ring->capacity - offset;
+
+    if (count < length) {
+        atomic_fetch_add_explicit(&ring->dropped, length - count, memory_order_relaxed);
+    }
+    if (count == 0) {
+        return 0;
+    }
+    if (first > count) {
+        first = count;
+    }
+    memcpy(ring->buffer + offset, data, first);
+    memcpy(ring->buffer, (const unsigned char *)data + first, count - first);
+
+    // publish the bytes before the new head becomes visible to the consumer
+    atomic_store_explicit(&ring->head, head + count, memory_order_release);
+    return count;
+}
+
+size_t watson_spsc_ring_read(watson_spsc_ring *ring, void *out, size_t length)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t available = head - tail;
+    size_t count = length < available ? length : available;
+    size_t offset = tail & ring->mask;
+    size_t first = ring->capacity - offset;
+
+    if (count == 0) {
+        return 0;
+    }
+    if (first > count) {
+        first = count;
+    }
+    memcpy(out, ring->buffer + offset, first);
+    memcpy((unsigned char *)out + first, ring->buffer, count - first);
+
+    // release the space only after the bytes have been copied out
+    atomic_store_explicit(&ring->tail, tail + count, memory_order_release);
+    return count;
+}
+
+size_t watson_spsc_ring_readable(watson_spsc_ring *ring)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    return head - tail;
+}
+
+size_t watson_spsc_ring_take_dropped(watson_spsc_ring *ring)
+{
+    return atomic_exchange_explicit(&ring->dropped, 0, memory_order_relaxed);
+}
@@ -0,0 +1,81 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#ifndef WATSON_SPSC_RING_H
+#define WATSON_SPSC_RING_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  Lock-free single-producer/single-consumer byte ring. The producer only moves head and the
+ *  consumer only moves tail, so neither side blocks or allocates, which makes it safe to write
+ *  from a real-time audio callback
+ */
+typedef struct {
+    unsigned char *buffer;
+    size_t capacity;
+    size_t mask;
+    atomic_size_t head;
+    atomic_size_t tail;
+    atomic_size_t dropped;
+} watson_spsc_ring;
+
+/**
+ *  Allocate the ring storage
+ *
+ *  @param ring     ring
+ *  @param capacity requested size in bytes, rounded up to a power of two
+ *
+ *  @return 0 on success, -1 if out of memory
+ */
+int watson_spsc_ring_init(watson_spsc_ring *ring, size_t capacity);
+void watson_spsc_ring_destroy(watson_spsc_ring *ring);
+
+/**
+ *  Producer side. Writes as much of data as fits, the rest is counted as dropped
+ *
+ *  @return number of bytes written
+ */
+size_t watson_spsc_ring_write(watson_spsc_ring *ring, const void *data, size_t length);
+
+/**
+ *  Consumer side. Reads up to length bytes
+ *
+ *  @return number of bytes read
+ */
+size_t watson_spsc_ring_read(watson_spsc_ring *ring, void *out, size_t length);
+
+/**
+ *  Bytes available to the consumer
+ */
+size_t watson_spsc_ring_readable(watson_spsc_ring *ring);
+
+/**
+ *  Bytes the producer could not write since the last call, resets the counter
+ */
+size_t watson_spsc_ring_take_dropped(watson_spsc_ring *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
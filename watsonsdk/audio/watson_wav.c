@@ -0,0 +1,132 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#include "watson_wav.h"
+#include <string.h>
+
+static void write_le16(unsigned char *dest, uint16_t value)
+{
+    dest[0] = (unsigned char)(value & 0xff);
+    dest[1] = (unsigned char)((value >> 8) & 0xff);
+}
+
+static void write_le32(unsigned char *dest, uint32_t value)
+{
+    dest[0] = (unsigned char)(value & 0xff);
+    dest[1] = (unsigned char)((value >> 8) & 0xff);
+    dest[2] = (unsigned char)((value >> 16) & 0xff);
+    dest[3] = (unsigned char)((value >> 24) & 0xff);
+}
+
+static uint16_t read_le16(const unsigned char *src)
+{
+    return (uint16_t)(src[0] | (src[1] << 8));
+}
+
+static uint32_t read_le32(const unsigned char *src)
+{
+    return (uint32_t)src[0] | ((uint32_t)src[1] << 8) | ((uint32_t)src[2] << 16) | ((uint32_t)src[3] << 24);
+}
+
+void watson_wav_write_header(unsigned char *header, uint32_t data_length, uint32_t sample_rate, int channels)
+{
+    uint16_t block_align = (uint16_t)(channels * 2);
+
+    memcpy(header, "RIFF", 4);  // RIFF/WAVE header
+    write_le32(header + 4, data_length + WATSON_WAV_HEADER_SIZE - 8);
+    memcpy(header + 8, "WAVE", 4);
+    memcpy(header + 12, "fmt ", 4);  // 'fmt ' chunk
+    write_le32(header + 16, 16);  // size of 'fmt ' chunk
+    write_le16(header + 20, 1);  // format = 1, PCM
+    write_le16(header + 22, (uint16_t)channels);
+    write_le32(header + 24, sample_rate);
+    write_le32(header + 28, sample_rate * block_align);  // byte rate
+    write_le16(header + 32, block_align);
+    write_le16(header + 34, 16);  // bits per sample
+    memcpy(header + 36, "data", 4);
+    write_le32(header + 40, data_length);
+}
+
+uint32_t watson_wav_sample_rate(const unsigned char *wav, size_t length)
+{
+    if (length < 28) {
+        return 0;
+    }
+    return read_le32(wav + 24);
+}
+
+size_t watson_wav_tts_data_offset(const unsigned char *wav, size_t length)
+{
+    size_t offset = 12;
+
+    // walk the chunks looking for 'data', the service leaves its size unset so only the position is used
+    while (length >= 12 && offset + 8 <= length) {
+        uint32_t chunk_size = read_le32(wav + offset + 4);
+        if (memcmp(wav + offset, "data", 4) == 0) {
+            return offset + 8;
+        }
+        if (chunk_size > length - offset - 8) {
+            break;
+        }
+        offset += 8 + chunk_size + (chunk_size & 1);
+    }
+
+    offset = WATSON_WAV_HEADER_SIZE + WATSON_WAV_TTS_METADATA_SIZE;
+    return offset < length ? offset : length;
+}
+
+int watson_wav_parse(const unsigned char *wav, size_t length, watson_wav_info *info)
+{
+    size_t offset = 12;
+    int has_format = 0;
+
+    if (length < 12 || memcmp(wav, "RIFF", 4) != 0 || memcmp(wav + 8, "WAVE", 4) != 0) {
+        return -1;
+    }
+    memset(info, 0, sizeof(*info));
+
+    while (offset + 8 <= length) {
+        const unsigned char *chunk = wav + offset;
+        size_t available = length - offset - 8;
+        uint32_t chunk_size = read_le32(chunk + 4);
+
+        if (memcmp(chunk, "data", 4) == 0) {
+            if (!has_format) {
+                return -1;
+            }
+            info->data_offset = offset + 8;
+            info->data_length = chunk_size < available ? chunk_size : available;
+            return 0;
+        }
+        if (chunk_size > available) {
+            break;
+        }
+        if (memcmp(chunk, "fmt ", 4) == 0 && chunk_size >= 16) {
+            info->format = read_le16(chunk + 8);
+            info->channels = read_le16(chunk + 10);
+            info->sample_rate = read_le32(chunk + 12);
+            info->bits_per_sample = read_le16(chunk + 22);
+            // WAVE_FORMAT_EXTENSIBLE keeps the actual format in the first two bytes of the sub-format GUID
+            if (info->format == 0xFFFE && chunk_size >= 40) {
+                info->format = read_le16(chunk + 32);
+            }
+            has_format = 1;
+        }
+        offset += 8 + chunk_size + (chunk_size & 1);
+    }
+    return -1;
+}
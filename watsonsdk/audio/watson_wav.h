@@ -0,0 +1,84 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#ifndef WATSON_WAV_H
+#define WATSON_WAV_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WATSON_WAV_HEADER_SIZE 44
+/* The service's streamed wav carries a metadata chunk after the canonical header */
+#define WATSON_WAV_TTS_METADATA_SIZE 48
+#define WATSON_WAV_FORMAT_PCM 1
+
+typedef struct
+{
+    uint16_t format;            /* WATSON_WAV_FORMAT_PCM for integer PCM, the sub-format for WAVE_FORMAT_EXTENSIBLE */
+    uint16_t channels;
+    uint32_t sample_rate;
+    uint16_t bits_per_sample;
+    size_t   data_offset;
+    size_t   data_length;
+} watson_wav_info;
+
+/**
+ *  Write a canonical 44 byte RIFF/WAVE header for 16-bit PCM
+ *
+ *  @param header      destination, at least WATSON_WAV_HEADER_SIZE bytes
+ *  @param data_length number of PCM bytes that follow the header
+ *  @param sample_rate sample rate in Hz
+ *  @param channels    number of channels
+ */
+void watson_wav_write_header(unsigned char *header, uint32_t data_length, uint32_t sample_rate, int channels);
+
+/**
+ *  Read the sample rate of a wav header
+ *
+ *  @return sample rate, or 0 if the buffer is too short
+ */
+uint32_t watson_wav_sample_rate(const unsigned char *wav, size_t length);
+
+/**
+ *  Offset of the PCM payload in a wav synthesized by the service, falls back to the
+ *  fixed header and metadata size when no data chunk can be found
+ *
+ *  @return offset, or length if the buffer holds no payload
+ */
+size_t watson_wav_tts_data_offset(const unsigned char *wav, size_t length);
+
+/**
+ *  Read the 'fmt ' and 'data' chunks of a RIFF/WAVE buffer. A data chunk whose size is
+ *  unset or runs past the end of the buffer is clamped to the bytes available
+ *
+ *  @param wav    buffer starting with the RIFF header
+ *  @param length buffer length
+ *  @param info   receives the format and the position of the payload
+ *
+ *  @return 0 on success, -1 if the buffer is not a wav or lacks either chunk
+ */
+int watson_wav_parse(const unsigned char *wav, size_t length, watson_wav_info *info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
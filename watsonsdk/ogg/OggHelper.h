@@ -16,9 +16,14 @@
 
 #import <Foundation/Foundation.h>
 
+@class OpusHelper;
+
 
 @interface OggHelper : NSObject
 - (OggHelper *) init;
 - (NSData *) getOggOpusHeader: (int) sampleRate;
 - (NSMutableData *) writePacket: (NSData*) data frameSize:(int) frameSize;
+- (void) setFlushInterval:(int) milliseconds maxPacketsPerPage:(int) maxPackets;
+- (NSData *) writePacketBytes: (const uint8_t*) bytes length:(NSUInteger) length frameSize:(int) frameSize;
+- (NSData *) encodePCM: (const int16_t*) pcm samples:(NSUInteger) samples frameSize:(int) frameSize encoder:(OpusHelper*) encoder flush:(BOOL) flush;
 @end
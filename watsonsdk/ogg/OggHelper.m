@@ -15,13 +15,14 @@
  **/
 
 #import "OggHelper.h"
-#import "ogg.h"
+#import "OpusHelperInternal.h"
+#import "watson_ogg_muxer.h"
+
+static void appendPage(void *context, const unsigned char *header, long header_len, const unsigned char *body, long body_len);
+static void gatherPage(void *context, const unsigned char *header, long header_len, const unsigned char *body, long body_len);
 
 @interface OggHelper () {
-    ogg_page oggPage;
-    ogg_int64_t packetCount;
-    ogg_int16_t granulePos;
-    ogg_stream_state streamState;
+    watson_ogg_muxer muxer;
 }
 
 @end
@@ -35,163 +36,132 @@
  */
 - (OggHelper *) init{
     if (self = [super init]) {
-        granulePos = 0;
-        packetCount = 0;
-        
-        ogg_stream_init(&streamState, arc4random()%8888);
+        watson_ogg_muxer_init(&muxer, arc4random()%8888);
         
         return self;
     }
     return nil;
 }
 
+- (void) dealloc {
+    watson_ogg_muxer_clear(&muxer);
+}
+
 /**
- *  Write int - Little-endian
+ *  Get data of OggOpus packet
+ *
+ *  @param sampleRate Audio sample rate
  *
- *  @param dest   Destination
- *  @param offset Offset
- *  @param value  Value
+ *  @return NSMutableData instance
  */
-void writeInt(unsigned char *dest, int offset, int value) {
-    for(int i = 0;i < 4;i++) {
-        dest[offset + i]=(unsigned char)(0xff & ((unsigned int)value)>>(i*8));
-    }
+- (NSData *) getOggOpusHeader:(int) sampleRate{
+    NSMutableData *newData = [[NSMutableData alloc] initWithCapacity:0];
+    watson_ogg_muxer_write_headers(&muxer, sampleRate, 1, appendPage, (__bridge void *)newData);
+    return newData;
 }
 
 /**
- *  Write short - Little-endian
+ *  Control the page cadence, pages are closed once they span the interval or hold maxPackets packets
+ *  instead of when libogg considers them full
  *
- *  @param dest   Destination
- *  @param offset Offset
- *  @param value  Value
+ *  @param milliseconds Audio per page, 0 to disable
+ *  @param maxPackets   Packets per page, 0 to disable
  */
-void writeShort(unsigned char *dest, int offset, int value) {
-    for(int i = 0;i < 2;i++) {
-        dest[offset + i]=(unsigned char)(0xff & ((unsigned int)value)>>(i*8));
-    }
+- (void) setFlushInterval:(int) milliseconds maxPacketsPerPage:(int) maxPackets{
+    watson_ogg_muxer_set_page_control(&muxer, milliseconds, maxPackets, 0);
 }
 
 /**
- *  Write string - Little-endian
+ *  Write OggOpus packet
+ *
+ *  @param data      Opus data
+ *  @param frameSize Frame size
  *
- *  @param dest   Destination
- *  @param offset Offset
- *  @param value  Value
- *  @param length Length
+ *  @return NSMutableData instance or nil
  */
-void writeString(unsigned char *dest, int offset, unsigned char *value, int length) {
-    unsigned char *tempPointr = dest + offset;
-    memcpy(tempPointr, value, length);
+- (NSMutableData *) writePacket: (NSData*) data frameSize:(int) frameSize{
+    NSMutableData *newData = [NSMutableData new];
+    if (watson_ogg_muxer_write_packet(&muxer, [data bytes], (long)[data length], frameSize, appendPage, (__bridge void *)newData) > 0) {
+        return newData;
+    }
+    return nil;
 }
 
 /**
- *  Get data of OggOpus packet
+ *  Write OggOpus packet from a raw buffer, the bytes are copied into the stream state so the buffer can be reused.
+ *  Page headers and bodies are gathered as separate spans of a dispatch_data rather than concatenated
  *
- *  @param sampleRate Audio sample rate
+ *  @param bytes     Opus packet
+ *  @param length    Length of the packet
+ *  @param frameSize Frame size
  *
- *  @return NSMutableData instance
+ *  @return NSData instance or nil if no page was completed
  */
-- (NSData *) getOggOpusHeader:(int) sampleRate{
-    packetCount = 0, granulePos = 0;
-    long headerSize = 19;
-    unsigned char opusHeader[headerSize];
-    int offset = 0;
-    // 0 - 7: OpusHead
-    writeString(opusHeader, offset + 0, (unsigned char *)"OpusHead", 8);
-    // Version, MUST The version number MUST always be '1' for this version of the encapsulation specification.
-    opusHeader[offset + 8] = 1;
-    // Output Channel Count
-    opusHeader[offset + 9] = 1;
-    // Pre-skip
-    writeShort(opusHeader, offset + 10, 0);
-    // Input Sample Rate (Hz)
-    writeInt(opusHeader, offset + 12, sampleRate);
-    // Output Gain (Q7.8 in dB), +/- 128 dB
-    writeShort(opusHeader, offset + 16, 0);
-    // Mapping Family (For channel mapping family 0, this value defaults to C-1 (i.e., 0 for mono and 1 for stereo), and is not coded.)
-    opusHeader[offset + 18] = 0;
-
-    ogg_packet opusHeaderPacket;
-    opusHeaderPacket.packet = opusHeader;
-    opusHeaderPacket.bytes = headerSize;
-    opusHeaderPacket.b_o_s = 1;
-    opusHeaderPacket.e_o_s = 0;
-    opusHeaderPacket.granulepos = granulePos;
-    opusHeaderPacket.packetno = packetCount++;
-    ogg_stream_packetin(&streamState, &opusHeaderPacket);
-    ogg_stream_flush(&streamState, &oggPage);
-    
-    NSMutableData *newData = [[NSMutableData alloc] initWithCapacity:0];
-    [newData appendBytes:oggPage.header length:oggPage.header_len];
-    [newData appendBytes:oggPage.body length:oggPage.body_len];
-    
-//    NSLog(@"[Encoder] Ogg header, %ld bytes are written\n", opusHeaderPacket.bytes);
-
-    offset = 0;
-    NSString *comments = @"libopus";
-
-    int commentsLength = (int)[comments lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
-//    NSLog(@"Comments length=%d", commentsLength);
-    unsigned char opusComments[commentsLength + 28];
-    writeString(opusComments, offset, (unsigned char *)"OpusTags", 8);
-    
-    NSString *vendorString = @"IBM";
-    int vendorStringLength = (int) vendorString.length;
-    // Vendor String Length
-    writeInt(opusComments, offset + 8, (int) vendorStringLength);
-    // Vendor String
-    writeString(opusComments, offset + 12, (unsigned char*)[comments cStringUsingEncoding:NSUTF8StringEncoding], vendorStringLength);
-    // User Comment List Length
-    writeInt(opusComments, offset + 20, 1);
-    // Vendor comment size
-    writeInt(opusComments, offset + 24, commentsLength);
-    // Vendor comment
-    writeString(opusComments, offset + 28, (unsigned char*)[comments cStringUsingEncoding:NSUTF8StringEncoding], commentsLength);
-    
-    ogg_packet opusCommentsPacket;
-    opusCommentsPacket.packet = opusComments;
-    opusCommentsPacket.bytes = commentsLength + 8;
-    opusCommentsPacket.b_o_s = 0;
-    opusCommentsPacket.e_o_s = 0;
-    opusCommentsPacket.granulepos = 0;
-    opusCommentsPacket.packetno = packetCount++;
-    ogg_stream_packetin(&streamState, &opusCommentsPacket);
-    ogg_stream_flush(&streamState, &oggPage);
-    
-    [newData appendBytes:oggPage.header length:oggPage.header_len];
-    [newData appendBytes:oggPage.body length:oggPage.body_len];
-
-//    NSLog(@"[Encoder] Ogg comments, %ld bytes are written\n", opusCommentsPacket.bytes);
-    
-    return newData;
+- (NSData *) writePacketBytes: (const uint8_t*) bytes length:(NSUInteger) length frameSize:(int) frameSize{
+    dispatch_data_t pages = dispatch_data_empty;
+    if (watson_ogg_muxer_write_packet(&muxer, bytes, (long)length, frameSize, gatherPage, (void *)&pages) > 0) {
+        return (NSData *)pages;
+    }
+    return nil;
 }
 
 /**
- *  Write OggOpus packet
+ *  Encode a contiguous span of PCM and mux it in one call, the pages are written into a single allocation
  *
- *  @param data      Opus data
+ *  @param pcm       Interleaved 16-bit PCM
+ *  @param samples   Number of samples per channel, a trailing partial frame is padded with silence
  *  @param frameSize Frame size
+ *  @param encoder   OpusHelper with an encoder created
+ *  @param flush     Flush the last page instead of leaving packets buffered for the next call
  *
- *  @return NSMutableData instance or nil
+ *  @return NSData with the Ogg pages, empty if no page was completed, nil on error
  */
-- (NSMutableData *) writePacket: (NSData*) data frameSize:(int) frameSize{
-    ogg_packet packet;
-    packet.packet = (unsigned char *)[data bytes];
-    packet.bytes = (long)([data length]);
-    packet.b_o_s = 0;
-    packet.e_o_s = 0;
-    granulePos += (frameSize * 2);
-    packet.granulepos = granulePos;
-    packet.packetno = packetCount++;
-    ogg_stream_packetin(&streamState, &packet);
-
-    if (ogg_stream_pageout(&streamState, &oggPage)) {
-        NSMutableData *newData = [NSMutableData new];
-        [newData appendBytes:oggPage.header length:oggPage.header_len];
-        [newData appendBytes:oggPage.body length:oggPage.body_len];
-        return newData;
+- (NSData *) encodePCM: (const int16_t*) pcm samples:(NSUInteger) samples frameSize:(int) frameSize encoder:(OpusHelper*) encoder flush:(BOOL) flush{
+    watson_opus_encoder *enc = [encoder encoder];
+    if (enc == NULL || pcm == NULL) {
+        return nil;
     }
-    return nil;
+
+    size_t capacity = watson_ogg_muxer_encode_bound(&muxer, watson_opus_encoder_sample_rate(enc), (long)samples, frameSize);
+    if (capacity == 0) {
+        return [NSData data];
+    }
+    unsigned char *pages = malloc(capacity);
+    if (pages == NULL) {
+        return nil;
+    }
+
+    long length = watson_ogg_muxer_encode(&muxer, enc, pcm, (long)samples, frameSize, flush ? 1 : 0, pages, capacity);
+    if (length < 0) {
+        free(pages);
+        return nil;
+    }
+    if (length == 0) {
+        free(pages);
+        return [NSData data];
+    }
+
+    // the bound is generous, give the unused tail back without copying the pages
+    unsigned char *trimmed = realloc(pages, (size_t)length);
+    return [NSData dataWithBytesNoCopy:(trimmed ? trimmed : pages) length:(NSUInteger)length freeWhenDone:YES];
+}
+
+#pragma mark static methods
+
+static void appendPage(void *context, const unsigned char *header, long header_len, const unsigned char *body, long body_len)
+{
+    NSMutableData *data = (__bridge NSMutableData *)context;
+    [data appendBytes:header length:header_len];
+    [data appendBytes:body length:body_len];
+}
+
+static void gatherPage(void *context, const unsigned char *header, long header_len, const unsigned char *body, long body_len)
+{
+    // libogg reuses its page buffers, so each span is copied once; the spans themselves are chained, not joined
+    dispatch_data_t *pages = (__strong dispatch_data_t *)context;
+    dispatch_data_t headerData = dispatch_data_create(header, header_len, NULL, DISPATCH_DATA_DESTRUCTOR_DEFAULT);
+    dispatch_data_t bodyData = dispatch_data_create(body, body_len, NULL, DISPATCH_DATA_DESTRUCTOR_DEFAULT);
+    *pages = dispatch_data_create_concat(dispatch_data_create_concat(*pages, headerData), bodyData);
 }
 
 @end
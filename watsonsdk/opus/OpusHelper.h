@@ -22,7 +22,13 @@
 @property (nonatomic,strong) dispatch_queue_t processingQueue;
 @property (nonatomic) NSUInteger bitrate;
 
++ (void) prewarmPoolWithSampleRate:(int) sampleRate encoders:(int) encoders decoders:(int) decoders;
++ (void) drainPool;
 - (BOOL) createEncoder: (int) sampleRate;
+- (BOOL) configureEncoderWithBitrate:(NSInteger) bitrate complexity:(NSInteger) complexity variableBitrate:(BOOL) variableBitrate dtx:(BOOL) dtx inbandFEC:(BOOL) inbandFEC packetLossPercentage:(NSInteger) packetLossPercentage;
+- (BOOL) isValidFrameSize:(int) frameSize;
 - (NSData*) encode:(NSData*) pcmData frameSize:(int) frameSize;
+- (const uint8_t*) encodeFrame:(const int16_t*) pcm frameSize:(int) frameSize length:(NSUInteger*) length;
+- (NSInteger) encodeFrame:(const int16_t*) pcm frameSize:(int) frameSize into:(uint8_t*) buffer capacity:(NSUInteger) capacity;
 - (NSData*) opusToPCM:(NSData*) oggOpus sampleRate:(long) sampleRate;
 @end
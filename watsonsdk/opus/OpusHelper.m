@@ -16,36 +16,58 @@
 
 #import "OpusHelper.h"
 #import "opus.h"
-#import "opus_multistream.h"
-#import "opus_defines.h"
-#import "ogg.h"
-#import "opus_header.h"
+#import "watson_opus_encoder.h"
+#import "watson_opus_pool.h"
+#import "watson_ogg_opus_decoder.h"
 
-/* 120ms at 48000 */
-#define MAX_FRAME_SIZE (960*6)
-#define float2int(flt) ((int)(floor(.5+flt)))
+static void appendPCM(void *context, const opus_int16 *pcm, int samples, int channels);
 
+// tags each processingQueue with its helper so work already running on it is not dispatched again
+static char kProcessingQueueKey;
 
 @interface OpusHelper()
 
-@property (nonatomic) OpusEncoder *encoder;
-@property (nonatomic) uint8_t *encoderOutputBuffer;
-@property (nonatomic) NSUInteger encoderBufferLength;
+@property (nonatomic) watson_opus_encoder *encoder;
 
 @end
 
 
 @implementation OpusHelper
 
+- (instancetype) init {
+    if (self = [super init]) {
+        // serial queue the encoder is driven from, keeps encoding off the audio callback thread
+        _processingQueue = dispatch_queue_create("com.ibm.watson.opus.processing", DISPATCH_QUEUE_SERIAL);
+        dispatch_queue_set_specific(_processingQueue, &kProcessingQueueKey, (__bridge void *)self, NULL);
+    }
+    return self;
+}
+
 - (void) dealloc {
     if (_encoder) {
-        opus_encoder_destroy(_encoder);
-    }
-    if (_encoderOutputBuffer) {
-        free(_encoderOutputBuffer);
+        // back to the pool, reset, for the next session
+        watson_opus_pool_release_encoder(_encoder);
     }
 }
 
+/**
+ *  Make sure mono encoder and decoder states are idle ahead of the next session, they are shared by every OpusHelper in the process
+ *
+ *  @param sampleRate Encoder sample rate, decoders always run at 48000
+ *  @param encoders   Number of encoders
+ *  @param decoders   Number of decoders
+ */
++ (void) prewarmPoolWithSampleRate:(int) sampleRate encoders:(int) encoders decoders:(int) decoders {
+    watson_opus_pool_prewarm(sampleRate, 1, encoders, decoders);
+}
+
+/**
+ *  Free the idle encoder and decoder states, e.g. on a memory warning
+ */
++ (void) drainPool {
+    watson_opus_pool_drain();
+}
+
 
 - (void) setBitrate:(NSUInteger)bitrate {
     if (!_encoder) {
@@ -53,7 +75,7 @@
     }
     _bitrate = bitrate;
     dispatch_async(self.processingQueue, ^{
-        opus_encoder_ctl(_encoder, OPUS_SET_BITRATE(bitrate));
+        watson_opus_encoder_set_bitrate(_encoder, (opus_int32)bitrate);
     });
 }
 
@@ -73,18 +95,71 @@
     // sample rates are 8000,12000,16000,24000,48000
     // number of channels 1 or 2 mono stereo
     // app type choices OPUS_APPLICATION_VOIP,OPUS_APPLICATION_AUDIO,OPUS_APPLICATION_RESTRICTED_LOWDELAY
-    self.encoder = opus_encoder_create(sampleRate, 1, OPUS_APPLICATION_VOIP, &opusError);
+    self.encoder = watson_opus_pool_acquire_encoder(sampleRate, 1, OPUS_APPLICATION_VOIP, &opusError);
     if (opusError != OPUS_OK) {
         NSLog(@"Error setting up opus encoder, error code is %@",[self opusErrorMessage:opusError]);
         return NO;
     }
     
-    self.encoderBufferLength = 16000;
-    self.encoderOutputBuffer = malloc(_encoderBufferLength * sizeof(uint8_t));
-    
     return YES;
 }
 
+/**
+ *  Apply an encoder profile, runs on the processing queue so it never races an encode
+ *
+ *  @param bitrate              Bits per second, 0 or less for the library default
+ *  @param complexity           0 to 10, lower values cost less CPU; -1 for the library default
+ *  @param variableBitrate      YES for VBR, NO for CBR
+ *  @param dtx                  Send almost empty packets during silence
+ *  @param inbandFEC            Embed forward error correction for the previous frame
+ *  @param packetLossPercentage Expected packet loss, decides how much FEC is spent
+ *
+ *  @return BOOL
+ */
+- (BOOL) configureEncoderWithBitrate:(NSInteger) bitrate complexity:(NSInteger) complexity variableBitrate:(BOOL) variableBitrate dtx:(BOOL) dtx inbandFEC:(BOOL) inbandFEC packetLossPercentage:(NSInteger) packetLossPercentage {
+    if (!_encoder) {
+        return NO;
+    }
+
+    watson_opus_encoder_profile profile;
+    watson_opus_encoder_profile_init(&profile);
+    if (bitrate > 0) {
+        profile.bitrate = (opus_int32)bitrate;
+        _bitrate = bitrate;
+    }
+    profile.complexity = complexity > 10 ? 10 : (int)complexity;
+    profile.vbr = variableBitrate ? 1 : 0;
+    profile.dtx = dtx ? 1 : 0;
+    profile.inband_fec = inbandFEC ? 1 : 0;
+    profile.packet_loss_perc = packetLossPercentage < 0 ? 0 : (packetLossPercentage > 100 ? 100 : (int)packetLossPercentage);
+
+    __block int opusError = OPUS_OK;
+    if (dispatch_get_specific(&kProcessingQueueKey) == (__bridge void *)self) {
+        // called from an encode completion, a dispatch_sync here would deadlock
+        opusError = watson_opus_encoder_apply_profile(_encoder, &profile);
+    } else {
+        dispatch_sync(self.processingQueue, ^{
+            opusError = watson_opus_encoder_apply_profile(_encoder, &profile);
+        });
+    }
+    if (opusError != OPUS_OK) {
+        NSLog(@"Error configuring opus encoder, error code is %@",[self opusErrorMessage:opusError]);
+        return NO;
+    }
+    return YES;
+}
+
+/**
+ *  Whether a frame size can be encoded at the encoder's sample rate
+ *
+ *  @param frameSize Frame size in samples
+ *
+ *  @return BOOL
+ */
+- (BOOL) isValidFrameSize:(int) frameSize {
+    return watson_opus_encoder_valid_frame_size(_encoder, frameSize) != 0;
+}
+
 - (NSString*) opusErrorMessage:(int)errorCode {
     switch (errorCode) {
         case OPUS_BAD_ARG:
@@ -113,27 +188,59 @@
  *  @param pcmData   PCM data
  *  @param frameSize Frame size
  *
- *  @return NSMutableData
+ *  @return NSData
  */
 - (NSData*) encode:(NSData*) pcmData frameSize:(int) frameSize{
-    
-    opus_int16 *data  = (opus_int16*) [pcmData bytes];
-    uint8_t *outBuffer  = malloc(pcmData.length * sizeof(uint8_t));
-    
-    // The length of the encoded packet
-    opus_int32 encodedByteCount = opus_encode(_encoder, data, frameSize, outBuffer, (opus_int32)pcmData.length);
-    
-    if (encodedByteCount < 0) {
-        NSLog(@"encoding error %@",[self opusErrorMessage:encodedByteCount]);
+    NSUInteger encodedByteCount = 0;
+    const uint8_t *encoded = [self encodeFrame:(const int16_t*) [pcmData bytes] frameSize:frameSize length:&encodedByteCount];
+
+    if (encoded == NULL) {
         return nil;
     }
+    return [NSData dataWithBytes:encoded length:encodedByteCount];
+}
+
+/**
+ *  Encode one frame into the preallocated encoder output buffer, no allocation is made per frame
+ *
+ *  @param pcm       16-bit PCM samples, frameSize samples per channel
+ *  @param frameSize Frame size
+ *  @param length    Receives the length of the encoded packet
+ *
+ *  @return pointer to the encoded packet, only valid until the next call; NULL on error
+ */
+- (const uint8_t*) encodeFrame:(const int16_t*) pcm frameSize:(int) frameSize length:(NSUInteger*) length{
+    opus_int32 encodedByteCount = 0;
+    const uint8_t *encoded = watson_opus_encoder_encode_frame(_encoder, pcm, frameSize, &encodedByteCount);
+
+    if (encoded == NULL) {
+        NSLog(@"encoding error");
+        return NULL;
+    }
+    if (length) {
+        *length = (NSUInteger) encodedByteCount;
+    }
+    return encoded;
+}
 
-    // Opus data initialized with size in the first byte
-    NSMutableData *outputData = [[NSMutableData alloc] initWithCapacity:frameSize*2];
-    // Append Opus data
-    [outputData appendData:[NSData dataWithBytes:outBuffer length:encodedByteCount]];
+/**
+ *  Encode one frame into a caller provided buffer
+ *
+ *  @param pcm       16-bit PCM samples, frameSize samples per channel
+ *  @param frameSize Frame size
+ *  @param buffer    Output buffer
+ *  @param capacity  Size of the output buffer in bytes
+ *
+ *  @return length of the encoded packet or a negative opus error code
+ */
+- (NSInteger) encodeFrame:(const int16_t*) pcm frameSize:(int) frameSize into:(uint8_t*) buffer capacity:(NSUInteger) capacity{
+    // The length of the encoded packet
+    opus_int32 encodedByteCount = watson_opus_encoder_encode(_encoder, pcm, frameSize, buffer, (opus_int32)capacity);
 
-    return outputData;
+    if (encodedByteCount < 0) {
+        NSLog(@"encoding error %@",[self opusErrorMessage:encodedByteCount]);
+    }
+    return encodedByteCount;
 }
 
 /**
@@ -160,282 +267,22 @@
     
     NSMutableData *pcmOut = [[NSMutableData alloc] init];
     
-    
-    ogg_sync_state oy;
-    ogg_page       og;
-    ogg_packet     op;
-    ogg_stream_state os;
-    ogg_int64_t audio_size=0;
-    long opus_serialno=0;
-    ogg_int64_t page_granule=0;
-    ogg_int64_t link_out=0;
-    OpusMSDecoder *st=NULL;
-    opus_int64 packet_count=0;
-    
-    //int eos=0; // stored value is never read
-    int channels=-1;
-    int mapping_family;
-    int rate=(int)sampleRate;
-    int wav_format=0;
-    int preskip=0;
-    int gran_offset=0;
-    int has_opus_stream=0;
-    int has_tags_packet=0;
-    int fp=0;
-    int streams=0;
-    int frame_size=0;
-    int total_links=0;
-    int stream_init = 0;
-    float manual_gain=0;
-    float gain=1;
-    float *output=0;
-    
-    ogg_sync_init(&oy);
-    
-    int processedByteCount = 0;
-    int opusLength = [[NSNumber numberWithLong:[oggopus length]] intValue];
-    
-    while (processedByteCount < opusLength)
-    {
-        char *data;
-        int buffersize = (200 < opusLength - processedByteCount) ? 200 : opusLength - processedByteCount;
-        data = ogg_sync_buffer(&oy, buffersize);
-        
-        NSRange range = {processedByteCount, buffersize};
-        [oggopus getBytes:data range:range];
-        processedByteCount += buffersize;
-        
-        ogg_sync_wrote(&oy, buffersize);
-        
-        /*Loop for all complete pages we got (most likely only one)*/
-        while (ogg_sync_pageout(&oy, &og)==1)
-        {
-            if (stream_init == 0) {
-                ogg_stream_init(&os, ogg_page_serialno(&og));
-                stream_init = 1;
-            }
-            if (ogg_page_serialno(&og) != os.serialno) {
-                /* so all streams are read. */
-                ogg_stream_reset_serialno(&os, ogg_page_serialno(&og));
-            }
-            /*Add page to the bitstream*/
-            ogg_stream_pagein(&os, &og);
-            page_granule = ogg_page_granulepos(&og);
-            
-            /*Extract all available packets*/
-            while (ogg_stream_packetout(&os, &op) == 1)
-            {
-                /*OggOpus streams are identified by a magic string in the initial
-                 stream header.*/
-                if (op.b_o_s && op.bytes>=8 && !memcmp(op.packet, "OpusHead", 8)) {
-                    if(has_opus_stream && has_tags_packet)
-                    {
-                        /*If we're seeing another BOS OpusHead now it means
-                         the stream is chained without an EOS.*/
-                        has_opus_stream=0;
-                        if(st)opus_multistream_decoder_destroy(st);
-                        st=NULL;
-                        NSLog(@"Warning: stream ended without EOS and a new stream began");
-                    }
-                    if(!has_opus_stream)
-                    {
-                        if(packet_count>0 && opus_serialno==os.serialno)
-                        {
-                            NSLog(@"Apparent chaining without changing serial number");
-                            return nil;
-                        }
-                        opus_serialno = os.serialno;
-                        has_opus_stream = 1;
-                        has_tags_packet = 0;
-                        link_out = 0;
-                        packet_count = 0;
-                        //eos = 0; // stored value is never read
-                        total_links++;
-                    } else {
-                        NSLog(@"Warning: ignoring opus stream");
-                    }
-                }
-                
-                
-                if (!has_opus_stream || os.serialno != opus_serialno)
-                    break;
-                /*If first packet in a logical stream, process the Opus header*/
-                if (packet_count==0)
-                {
-                    st = process_header(&op, &rate, &mapping_family, &channels, &preskip, &gain, manual_gain, &streams, wav_format);
-                    if (!st)
-                        return nil;
-                    
-                    if(ogg_stream_packetout(&os, &op)!=0 || og.header[og.header_len-1]==255)
-                    {
-                        /*The format specifies that the initial header and tags packets are on their
-                         own pages. To aid implementors in discovering that their files are wrong
-                         we reject them explicitly here. In some player designs files like this would
-                         fail even without an explicit test.*/
-                        fprintf(stderr, "Extra packets on initial header page. Invalid stream.\n");
-                        return nil;
-                    }
-                    
-                    /*Remember how many samples at the front we were told to skip
-                     so that we can adjust the timestamp counting.*/
-                    gran_offset=preskip;
-                    
-                    if(!output)output=malloc(sizeof(float)*MAX_FRAME_SIZE*channels);
-                    
-                    
-                } else if (packet_count==1)
-                {
-                    has_tags_packet=1;
-                    if(ogg_stream_packetout(&os, &op)!=0 || og.header[og.header_len-1]==255)
-                    {
-                        NSLog(@"Extra packets on initial tags page. Invalid stream.");
-                        return nil;
-                    }
-                } else {
-                    int ret;
-                    opus_int64 maxout;
-                    opus_int64 outsamp;
-                    
-                    
-                    
-                    /*Decode Opus packet*/
-                    ret = opus_multistream_decode_float(st, (unsigned char*)op.packet, (int)op.bytes, output, MAX_FRAME_SIZE, 0);
-                    
-                    /*If the decoder returned less than zero, we have an error.*/
-                    if (ret<0)
-                    {
-                        fprintf (stderr, "Decoding error: %s\n", opus_strerror(ret));
-                        break;
-                    }
-                    frame_size = ret;
-                    
-                    
-                    /*This handles making sure that our output duration respects
-                     the final end-trim by not letting the output sample count
-                     get ahead of the granpos indicated value.*/
-                    maxout=((page_granule-gran_offset)*rate/48000)-link_out;
-                    outsamp=audio_write(output, channels, frame_size, pcmOut, &preskip, 1,0>maxout?0:maxout,fp);
-                    link_out+=outsamp;
-                    audio_size+=(fp?4:2)*outsamp*channels;
-                }
-                packet_count++;
-                
-                
-            }
-            
-        }
-        
-    }
-    
-    if(!total_links)fprintf (stderr, "This doesn't look like a Opus file\n");
-    opus_multistream_decoder_destroy(st);
-    if (stream_init)
-        ogg_stream_clear(&os);
-    ogg_sync_clear(&oy);
-    if(output) {
-        free(output);
+    int ret = watson_ogg_opus_decode([oggopus bytes], [oggopus length], (opus_int32)sampleRate, appendPCM, (__bridge void *)pcmOut);
+    if (ret < 0) {
+        NSLog(@"Invalid Ogg Opus stream");
+        return nil;
     }
     
-    
-    
     return pcmOut;
 }
 
 
 #pragma mark static methods
 
-/*Process an Opus header and setup the opus decoder based on it.
- It takes several pointers for header values which are needed
- elsewhere in the code.*/
-static OpusMSDecoder *process_header(ogg_packet *op, opus_int32 *rate,
-                                     int *mapping_family, int *channels, int *preskip, float *gain,
-                                     float manual_gain, int *streams, int wav_format)
-{
-    int err;
-    OpusMSDecoder *st;
-    OpusHeader header;
-    
-    if (opus_header_parse(op->packet, (int)op->bytes, &header)==0)
-    {
-        fprintf(stderr, "Cannot parse header\n");
-        return NULL;
-    }
-    
-    *mapping_family = header.channel_mapping;
-    *channels = header.channels;
-    
-
-    if(!*rate)*rate=header.input_sample_rate;
-    /*If the rate is unspecified we decode to 48000*/
-    if(*rate==0)*rate=48000;
-    if(*rate<8000||*rate>192000){
-        fprintf(stderr,"Warning: Crazy input_rate %d, decoding to 48000 instead.\n",*rate);
-        *rate=48000;
-    }
-
-    if(header.input_sample_rate != *rate)
-        fprintf(stderr, "\n\n\n*** Sample rate detected: %d, using: %d ***\n\n\n", header.input_sample_rate, *rate);
-
-    *preskip = header.preskip;
-    st = opus_multistream_decoder_create(48000, header.channels, header.nb_streams, header.nb_coupled, header.stream_map, &err);
-    if(err != OPUS_OK){
-        fprintf(stderr, "Cannot create decoder: %s\n", opus_strerror(err));
-        return NULL;
-    }
-    if (!st)
-    {
-        fprintf (stderr, "Decoder initialization failed: %s\n", opus_strerror(err));
-        return NULL;
-    }
-    
-    *streams=header.nb_streams;
-    
-    fprintf(stderr, "Decoding to %d Hz (%d channel%s)", *rate,
-            *channels, *channels>1?"s":"");
-    if(header.version!=1)fprintf(stderr, ", Header v%d",header.version);
-    fprintf(stderr, "\n");
-
-    if (header.gain!=0)fprintf(stderr,"Playback gain: %f dB\n", header.gain/256.);
-    if (manual_gain!=0)fprintf(stderr,"Manual gain: %f dB\n", manual_gain);
-    
-    
-    return st;
-}
-
-static opus_int64 audio_write(float *pcm, int channels, int frame_size, NSMutableData *fout,
-                              int *skip, int file, opus_int64 maxout, int fp)
+static void appendPCM(void *context, const opus_int16 *pcm, int samples, int channels)
 {
-    opus_int64 sampout=0;
-    int i,tmp_skip;
-    unsigned out_len;
-    short *out;
-    float *output;
-    out=alloca(sizeof(short)*MAX_FRAME_SIZE*channels);
-    maxout=maxout<0?0:maxout;
-    
-    if (skip){
-        tmp_skip = (*skip>frame_size) ? (int)frame_size : *skip;
-        *skip -= tmp_skip;
-    } else {
-        tmp_skip = 0;
-    }
-    
-    output=pcm+channels*tmp_skip;
-    out_len=frame_size-tmp_skip;
-    //frame_size=0; // stored value is never read
-    
-    for (i=0;i<(int)out_len*channels;i++){
-        out[i]=(short)float2int(fmaxf(-32768,fminf(output[i]*32768.f,32767)));
-    }
-    
-    if(maxout>0)
-    {
-        [fout appendBytes:out length:out_len*2];
-        sampout+=out_len;
-        //maxout-=out_len; // stored value is never read
-    }
-    
-    return sampout;
+    NSMutableData *pcmOut = (__bridge NSMutableData *)context;
+    [pcmOut appendBytes:pcm length:samples * channels * sizeof(opus_int16)];
 }
 
 @end
@@ -0,0 +1,42 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#import <Foundation/Foundation.h>
+
+typedef NS_ENUM(NSInteger, OpusStreamDecoderOutputFormat) {
+    OpusStreamDecoderOutputInt16,
+    OpusStreamDecoderOutputFloat32,
+    OpusStreamDecoderOutputBoth
+};
+
+typedef void (^OpusStreamDecoderPCMHandler)(NSData *pcm);
+
+/**
+ *  Push-style Ogg Opus decoder, feed chunks as they arrive and receive 16-bit PCM per decoded packet
+ */
+@interface OpusStreamDecoder : NSObject
+
+@property (readonly) long sampleRate;
+@property (readonly) int channels;
+@property (readonly) OpusStreamDecoderOutputFormat outputFormat;
+
+- (instancetype) initWithSampleRate:(long) sampleRate handler:(OpusStreamDecoderPCMHandler) handler;
+- (instancetype) initWithSampleRate:(long) sampleRate outputFormat:(OpusStreamDecoderOutputFormat) outputFormat handler:(OpusStreamDecoderPCMHandler) handler floatHandler:(OpusStreamDecoderPCMHandler) floatHandler;
+- (BOOL) decodeChunk:(NSData*) chunk;
+- (BOOL) decodeBytes:(const uint8_t*) bytes length:(NSUInteger) length;
+- (BOOL) hasOpusStream;
+@end
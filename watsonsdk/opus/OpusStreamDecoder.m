@@ -0,0 +1,140 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#import "OpusStreamDecoder.h"
+#import "watson_ogg_opus_decoder.h"
+
+static void handlePCM(void *context, const opus_int16 *pcm, int samples, int channels);
+static void handleFloatPCM(void *context, const float *pcm, int samples, int channels);
+
+@interface OpusStreamDecoder()
+
+@property (nonatomic) watson_ogg_opus_decoder *decoder;
+@property (nonatomic, copy) OpusStreamDecoderPCMHandler handler;
+@property (nonatomic, copy) OpusStreamDecoderPCMHandler floatHandler;
+
+@end
+
+@implementation OpusStreamDecoder
+
+/**
+ *  Initialize a streaming decoder
+ *
+ *  @param sampleRate Output sample rate, 0 to use the rate in the Opus header
+ *  @param handler    Called with interleaved 16-bit PCM for every decoded packet
+ *
+ *  @return OpusStreamDecoder instance
+ */
+- (instancetype) initWithSampleRate:(long) sampleRate handler:(OpusStreamDecoderPCMHandler) handler {
+    return [self initWithSampleRate:sampleRate outputFormat:OpusStreamDecoderOutputInt16 handler:handler floatHandler:nil];
+}
+
+/**
+ *  Initialize a streaming decoder with a choice of output format, 16-bit output decodes directly without a float pass
+ *
+ *  @param sampleRate   Output sample rate, 0 to use the rate in the Opus header
+ *  @param outputFormat 16-bit, 32-bit float or both
+ *  @param handler      Called with interleaved 16-bit PCM for every decoded packet
+ *  @param floatHandler Called with interleaved float PCM for every decoded packet
+ *
+ *  @return OpusStreamDecoder instance
+ */
+- (instancetype) initWithSampleRate:(long) sampleRate outputFormat:(OpusStreamDecoderOutputFormat) outputFormat handler:(OpusStreamDecoderPCMHandler) handler floatHandler:(OpusStreamDecoderPCMHandler) floatHandler {
+    if (self = [super init]) {
+        _handler = handler;
+        _floatHandler = floatHandler;
+        _outputFormat = outputFormat;
+        _decoder = watson_ogg_opus_decoder_create((opus_int32)sampleRate, handlePCM, (__bridge void *)self);
+        if (_decoder == NULL) {
+            return nil;
+        }
+
+        watson_pcm_format format = WATSON_PCM_INT16;
+        if (outputFormat == OpusStreamDecoderOutputFloat32) {
+            format = WATSON_PCM_FLOAT32;
+        } else if (outputFormat == OpusStreamDecoderOutputBoth) {
+            format = WATSON_PCM_BOTH;
+        }
+        watson_ogg_opus_decoder_set_output(_decoder, format, handleFloatPCM);
+    }
+    return self;
+}
+
+- (void) dealloc {
+    if (_decoder) {
+        watson_ogg_opus_decoder_destroy(_decoder);
+    }
+}
+
+- (long) sampleRate {
+    return watson_ogg_opus_decoder_sample_rate(_decoder);
+}
+
+- (int) channels {
+    return watson_ogg_opus_decoder_channels(_decoder);
+}
+
+- (BOOL) hasOpusStream {
+    return watson_ogg_opus_decoder_has_stream(_decoder) != 0;
+}
+
+/**
+ *  Decode the next chunk of an Ogg Opus stream, chunks do not need to be page aligned
+ *
+ *  @param chunk Ogg Opus data
+ *
+ *  @return NO if the stream is invalid
+ */
+- (BOOL) decodeChunk:(NSData*) chunk {
+    return [self decodeBytes:[chunk bytes] length:[chunk length]];
+}
+
+/**
+ *  Decode the next chunk of an Ogg Opus stream from a raw buffer
+ *
+ *  @param bytes  Ogg Opus bytes
+ *  @param length Number of bytes
+ *
+ *  @return NO if the stream is invalid
+ */
+- (BOOL) decodeBytes:(const uint8_t*) bytes length:(NSUInteger) length {
+    if (watson_ogg_opus_decoder_feed(_decoder, bytes, length) < 0) {
+        NSLog(@"Invalid Ogg Opus stream");
+        return NO;
+    }
+    return YES;
+}
+
+#pragma mark static methods
+
+static void handlePCM(void *context, const opus_int16 *pcm, int samples, int channels)
+{
+    OpusStreamDecoder *decoder = (__bridge OpusStreamDecoder *)context;
+    if (decoder.handler) {
+        decoder.handler([NSData dataWithBytes:pcm length:sizeof(opus_int16) * samples * channels]);
+    }
+}
+
+static void handleFloatPCM(void *context, const float *pcm, int samples, int channels)
+{
+    OpusStreamDecoder *decoder = (__bridge OpusStreamDecoder *)context;
+    if (decoder.floatHandler) {
+        decoder.floatHandler([NSData dataWithBytes:pcm length:sizeof(float) * samples * channels]);
+    }
+}
+
+@end
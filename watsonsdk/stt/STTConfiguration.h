@@ -30,14 +30,32 @@
 //#define WATSONSDK_AUDIO_CODEC_TYPE_FLAC @"audio/flac"
 #define WATSONSDK_AUDIO_CODEC_TYPE_OPUS @"audio/ogg;codecs=opus"
 #define WATSONSDK_AUDIO_FRAME_SIZE 160
+#define WATSONSDK_AUDIO_FRAME_DURATION 10
+#define WATSONSDK_OGG_PAGE_FLUSH_INTERVAL 100
 #define WATSONSDK_AUDIO_SAMPLE_RATE 16000.0
 
 // timeout
 #define WATSONSDK_INACTIVITY_TIMEOUT 30
 
+// audio buffered while the socket is not ready for it
+#define WATSONSDK_AUDIO_BUFFER_MAX_BYTES (1024 * 1024)
+#define WATSONSDK_AUDIO_BUFFER_MAX_DURATION 60
+#define WATSONSDK_AUDIO_BUFFER_BLOCK_TIMEOUT 1
+#define WATSONSDK_AUDIO_FRAME_LENGTH (32 * 1024)
+
+// seconds between pings on a websocket kept open between recognitions
+#define WATSONSDK_KEEP_ALIVE_INTERVAL 20
+
 // models
 #define WATSONSDK_DEFAULT_STT_MODEL @"en-US_BroadbandModel"
 
+// what to do with audio that does not fit in the buffer kept while the socket is not ready for it
+typedef NS_ENUM(NSInteger, STTAudioBufferOverflowPolicy) {
+    STTAudioBufferOverflowDrop = 0,     // discard the oldest audio, the Ogg stream header is kept
+    STTAudioBufferOverflowBlock,        // make the writer wait for room, then drop after audioBufferBlockTimeout
+    STTAudioBufferOverflowSpillToDisk   // move the oldest audio to a temporary file and send it from there
+};
+
 @interface STTConfiguration : AuthConfiguration
 
 @property NSString *apiURL;
@@ -59,6 +77,44 @@
 @property NSURL *apiEndpoint;
 @property BOOL isCertificateValidationDisabled;
 
+// opus encoder profile, used when audioCodec is WATSONSDK_AUDIO_CODEC_TYPE_OPUS
+@property NSInteger opusFrameDuration;      // milliseconds per packet: 10, 20, 40 or 60
+@property NSInteger opusBitrate;            // bits per second, 0 for the encoder default
+@property NSInteger opusComplexity;         // 0-10, lower values cost less CPU; -1 for the encoder default
+@property BOOL opusVariableBitrate;
+@property BOOL opusDTX;                     // discontinuous transmission during silence
+@property BOOL opusInbandFEC;
+@property NSInteger opusPacketLossPercentage;
+@property NSInteger opusPageFlushInterval;  // milliseconds of audio per Ogg page, 0 to let libogg fill pages
+@property NSInteger opusMaxPacketsPerPage;  // 0 for no limit
+
+// hand captured audio to a separate encode queue instead of encoding on the AudioQueue callback thread
+@property BOOL pipelinedCapture;
+
+// negotiate permessage-deflate so interim results arrive compressed, off by default; the server may decline
+@property BOOL perMessageDeflate;
+@property NSInteger perMessageDeflateWindowBits;        // 9-15, smaller windows use less memory per connection
+@property BOOL perMessageDeflateNoContextTakeover;      // reset the compression context after every message
+
+// network threads the websockets of all sessions are spread over; shared by the process, the largest value in use wins
+@property NSUInteger networkThreadCount;
+@property BOOL networkThreadLeastLoaded;                // assign sessions to the least busy thread instead of by hash
+@property NSInteger networkThreadIndex;                 // pin this session to one network thread, -1 to let the pool choose
+
+// audio queued until the service is listening, flushed in frames of at most audioFrameLength bytes
+@property NSInteger audioBufferMaxBytes;
+@property NSTimeInterval audioBufferMaxDuration;        // seconds a chunk may wait in memory, 0 for no limit
+@property STTAudioBufferOverflowPolicy audioBufferOverflowPolicy;
+@property NSTimeInterval audioBufferBlockTimeout;       // longest wait of a blocked writer
+@property NSInteger audioFrameLength;
+
+// keep the websocket open once a recognition finishes and start the next one on it
+@property BOOL keepAliveConnection;
+@property NSTimeInterval keepAliveInterval;             // seconds between pings while idle, 0 to never ping
+
+// log each stage of a recognize as it happens, SpeechToText timingTrace records them either way
+@property BOOL timingTraceLogging;
+
 - (id)init;
 
 - (NSURL*)getModelsServiceURL;
@@ -66,5 +122,6 @@
 - (NSURL*)getWebSocketRecognizeURL;
 
 - (NSString *)getStartMessage;
+- (int)getOpusFrameSize;
 
 @end
@@ -40,6 +40,35 @@
     [self setSmartFormatting:NO];
     [self setTimestamps:NO];
     [self setWordConfidence:NO];
+    [self setPipelinedCapture:YES];
+
+    [self setOpusFrameDuration:WATSONSDK_AUDIO_FRAME_DURATION];
+    [self setOpusBitrate:0];
+    [self setOpusComplexity:-1];
+    [self setOpusVariableBitrate:YES];
+    [self setOpusDTX:NO];
+    [self setOpusInbandFEC:NO];
+    [self setOpusPacketLossPercentage:0];
+    [self setOpusPageFlushInterval:WATSONSDK_OGG_PAGE_FLUSH_INTERVAL];
+    [self setOpusMaxPacketsPerPage:0];
+
+    [self setPerMessageDeflate:NO];
+    [self setPerMessageDeflateWindowBits:15];
+    [self setPerMessageDeflateNoContextTakeover:NO];
+
+    [self setNetworkThreadCount:1];
+    [self setNetworkThreadLeastLoaded:NO];
+    [self setNetworkThreadIndex:-1];
+
+    [self setAudioBufferMaxBytes:WATSONSDK_AUDIO_BUFFER_MAX_BYTES];
+    [self setAudioBufferMaxDuration:WATSONSDK_AUDIO_BUFFER_MAX_DURATION];
+    [self setAudioBufferOverflowPolicy:STTAudioBufferOverflowDrop];
+    [self setAudioBufferBlockTimeout:WATSONSDK_AUDIO_BUFFER_BLOCK_TIMEOUT];
+    [self setAudioFrameLength:WATSONSDK_AUDIO_FRAME_LENGTH];
+
+    [self setKeepAliveConnection:NO];
+    [self setKeepAliveInterval:WATSONSDK_KEEP_ALIVE_INTERVAL];
+    [self setTimingTraceLogging:NO];
 
     return self;
 }
@@ -98,6 +127,24 @@
     return url;
 }
 
+/**
+ *  Number of samples in each Opus frame for the configured frame duration
+ *
+ *  @return frame size, WATSONSDK_AUDIO_FRAME_SIZE if the duration is not one Opus supports here
+ */
+- (int)getOpusFrameSize {
+    switch (self.opusFrameDuration) {
+        case 10:
+        case 20:
+        case 40:
+        case 60:
+            return (int)(WATSONSDK_AUDIO_SAMPLE_RATE * self.opusFrameDuration / 1000);
+        default:
+            NSLog(@"Unsupported opus frame duration %ldms, using %dms", (long)self.opusFrameDuration, WATSONSDK_AUDIO_FRAME_DURATION);
+            return WATSONSDK_AUDIO_FRAME_SIZE;
+    }
+}
+
 /**
  *  Organize JSON string for start message of WebSockets
  *
@@ -0,0 +1,57 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#import <Foundation/Foundation.h>
+
+// stages of a recognize, in the order they usually happen
+#define WATSONSDK_TRACE_RECOGNIZE @"recognize"
+#define WATSONSDK_TRACE_PERMISSION_REQUESTED @"permission_requested"
+#define WATSONSDK_TRACE_TOKEN_READY @"token_ready"
+#define WATSONSDK_TRACE_SOCKET_OPEN @"socket_open"
+#define WATSONSDK_TRACE_PERMISSION_GRANTED @"permission_granted"
+#define WATSONSDK_TRACE_AUDIO_STARTED @"audio_started"
+#define WATSONSDK_TRACE_LISTENING @"listening"
+#define WATSONSDK_TRACE_FIRST_AUDIO_SENT @"first_audio_sent"
+#define WATSONSDK_TRACE_FIRST_RESULT @"first_result"
+#define WATSONSDK_TRACE_FINAL_RESULT @"final_result"
+
+/**
+ *  Time of each stage of a recognize, relative to the start of the trace. Only the first
+ *  mark of a stage is kept. Thread safe
+ */
+@interface STTTimingTrace : NSObject
+
+// log every stage as it is marked
+@property (atomic) BOOL logsStages;
+
+- (void) mark:(NSString*) stage;
+
+/**
+ *  milliseconds from the start of the trace to each stage
+ *
+ *  @return NSDictionary of stage name to NSNumber
+ */
+- (NSDictionary*) stages;
+
+/**
+ *  stage names in the order they were marked
+ *
+ *  @return NSArray of NSString
+ */
+- (NSArray*) orderedStages;
+
+@end
@@ -0,0 +1,77 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#import "STTTimingTrace.h"
+
+@interface STTTimingTrace ()
+
+@property NSTimeInterval startTime;
+@property NSMutableDictionary *times;
+@property NSMutableArray *order;
+
+@end
+
+@implementation STTTimingTrace
+
+- (id) init {
+    self = [super init];
+    if (self) {
+        // system uptime is monotonic, wall clock changes do not skew the trace
+        self.startTime = [[NSProcessInfo processInfo] systemUptime];
+        self.times = [[NSMutableDictionary alloc] init];
+        self.order = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
+- (void) mark:(NSString*) stage {
+    double elapsed = ([[NSProcessInfo processInfo] systemUptime] - self.startTime) * 1000.0;
+    @synchronized (self) {
+        if ([self.times objectForKey:stage] != nil) {
+            return;
+        }
+        [self.times setObject:[NSNumber numberWithDouble:elapsed] forKey:stage];
+        [self.order addObject:stage];
+    }
+    if (self.logsStages) {
+        NSLog(@"[stt trace] %@ +%.1f ms", stage, elapsed);
+    }
+}
+
+- (NSDictionary*) stages {
+    @synchronized (self) {
+        return [self.times copy];
+    }
+}
+
+- (NSArray*) orderedStages {
+    @synchronized (self) {
+        return [self.order copy];
+    }
+}
+
+- (NSString*) description {
+    NSMutableString *description = [NSMutableString stringWithString:@"STTTimingTrace"];
+    @synchronized (self) {
+        for (NSString *stage in self.order) {
+            [description appendFormat:@" %@=%.1fms", stage, [[self.times objectForKey:stage] doubleValue]];
+        }
+    }
+    return description;
+}
+
+@end
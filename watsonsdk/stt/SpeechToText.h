@@ -21,6 +21,7 @@
 #import "WebSocketAudioStreamer.h"
 #import "OpusHelper.h"
 #import "OggHelper.h"
+#import "STTTimingTrace.h"
 
 @interface SpeechToText : NSObject <NSURLSessionDelegate>
 
@@ -59,6 +60,29 @@
  */
 - (void) recognize:(void (^)(NSDictionary*, NSError*)) recognizeHandler;
 
+/**
+ *  stream a pre-recorded file to the STT service as fast as the connection allows
+ *
+ *  @param path             WAV or raw 16-bit PCM file, mono at 16000 Hz; the file is memory mapped
+ *  @param recognizeHandler (^)(NSDictionary*, NSError*)
+ *  @param dataHandler      (^) (NSData*)
+ */
+- (void) recognizeFile:(NSString*) path recognizeHandler:(void (^)(NSDictionary*, NSError*)) recognizeHandler dataHandler: (void (^) (NSData*)) dataHandler;
+
+/**
+ *  stream audio held in memory to the STT service as fast as the connection allows
+ *
+ *  @param audioData        WAV or raw 16-bit PCM, mono at 16000 Hz
+ *  @param recognizeHandler (^)(NSDictionary*, NSError*)
+ *  @param dataHandler      (^) (NSData*)
+ */
+- (void) recognizeData:(NSData*) audioData recognizeHandler:(void (^)(NSDictionary*, NSError*)) recognizeHandler dataHandler: (void (^) (NSData*)) dataHandler;
+
+/**
+ *  open the websocket before the first recognize, used when keepAliveConnection is set
+ */
+- (void) prewarm;
+
 /**
  *  stopRecording and streaming audio from the device microphone
  *
@@ -137,6 +161,13 @@
  */
 -(BOOL) isFinalTranscript:(NSDictionary*) results;
 
+/**
+ *  timingTrace - stages of the current or last recognize, with their time since it was called
+ *
+ *  @return STTTimingTrace
+ */
+- (STTTimingTrace*) timingTrace;
+
 /**
  *  getPowerLevel - listen for updates to the Db level of the speaker, can be used for a voice wave visualization
  *
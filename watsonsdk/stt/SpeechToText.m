@@ -16,13 +16,26 @@
 
 #import <SpeechToText.h>
 #import "AuthConfigurationInternal.h"
+#import "watson_spsc_ring.h"
+#import "watson_wav.h"
 
 // type defs for block callbacks
 #define NUM_BUFFERS 3
+// seconds of 16-bit audio the capture ring holds before the encode queue falls behind
+#define CAPTURE_RING_SECONDS 4
+// recognizeData: encodes this much audio per websocket message and keeps at most
+// FILE_CHUNKS_IN_FLIGHT chunks queued ahead of the network queue
+#define FILE_CHUNK_SECONDS 1
+#define FILE_CHUNKS_IN_FLIGHT 4
+// 60 ms at 16000 Hz, the longest Opus frame getOpusFrameSize returns
+#define MAX_OPUS_FRAME_SIZE 960
 typedef void (^RecognizeCallbackBlockType)(NSDictionary*, NSError*);
 typedef void (^PowerLevelCallbackBlockType)(float);
 typedef void (^AudioDataCallbackBlockType)(NSData*);
 
+// per-session context handed to the audio callback through inUserData, so every SpeechToText
+// instance runs its own encoder, muxer and socket. The object references are owned by the
+// SpeechToText instance and outlive the AudioQueue, which is disposed synchronously
 typedef struct
 {
     AudioStreamBasicDescription  dataFormat;
@@ -32,6 +45,18 @@ typedef struct
     SInt64                       currentPacket;
     bool                         recording;
     int                          slot;
+    watson_spsc_ring             *captureRing;
+    bool                         compressedOpus;
+    int                          opusFrameSize;
+    int                          recordedLength;
+    // without the capture ring, the samples short of a whole Opus frame wait here for the next buffer
+    int16_t                      pendingPCM[MAX_OPUS_FRAME_SIZE];
+    int                          pendingSamples;
+    __unsafe_unretained WebSocketAudioStreamer *audioStreamer;
+    __unsafe_unretained OpusHelper *opus;
+    __unsafe_unretained OggHelper *ogg;
+    __unsafe_unretained dispatch_source_t captureSource;
+    __unsafe_unretained dispatch_queue_t networkQueue;
 } RecordingState;
 
 
@@ -42,7 +67,11 @@ typedef struct
 @property OggHelper *ogg;
 @property OpusHelper* opus;
 @property RecordingState recordState;
+@property BOOL isNewRecordingAllowed;
+@property STTTimingTrace *trace;
 @property WebSocketAudioStreamer* audioStreamer;
+@property (nonatomic, strong) dispatch_queue_t networkQueue;
+@property (nonatomic, strong) dispatch_source_t captureSource;
 @property (nonatomic, copy) RecognizeCallbackBlockType recognizeCallback;
 @property (nonatomic, copy) PowerLevelCallbackBlockType powerLevelCallback;
 
@@ -58,16 +87,6 @@ typedef struct
 @synthesize audioDataCallback;
 @synthesize ogg = _ogg;
 
-
-// static for use by c code
-static BOOL isNewRecordingAllowed;
-static BOOL isCompressedOpus;
-static int audioRecordedLength;
-
-id audioStreamerRef;
-id opusRef;
-id oggRef;
-
 #pragma mark public methods
 
 /**
@@ -93,13 +112,21 @@ id oggRef;
     self = [super init];
     self.config = config;
     // set audio encoding flags so they are accessible in c audio callbacks
-    isCompressedOpus = [config.audioCodec isEqualToString:WATSONSDK_AUDIO_CODEC_TYPE_OPUS] ? YES : NO;
-    isNewRecordingAllowed = YES;
+    _recordState.compressedOpus = [config.audioCodec isEqualToString:WATSONSDK_AUDIO_CODEC_TYPE_OPUS] ? true : false;
+    _recordState.opusFrameSize = WATSONSDK_AUDIO_FRAME_SIZE;
+    self.isNewRecordingAllowed = YES;
 
     // setup opus helper
     self.opus = [[OpusHelper alloc] init];
     [self.opus createEncoder: WATSONSDK_AUDIO_SAMPLE_RATE];
-    opusRef = self->_opus;
+    _recordState.opus = self.opus;
+
+    // writes to the streamer are serialized here, after the encode stage
+    self.networkQueue = dispatch_queue_create("com.ibm.watson.stt.network", DISPATCH_QUEUE_SERIAL);
+    _recordState.networkQueue = self.networkQueue;
+
+    // fetch a token now so the first recognize does not wait for it
+    [config prefetchToken];
 
     return self;
 }
@@ -145,25 +172,34 @@ id oggRef;
     self.audioDataCallback = dataHandler;
     self.powerLevelCallback = powerHandler;
 
-    if (!isNewRecordingAllowed) {
+    if (!self.isNewRecordingAllowed) {
         // don't allow a new recording to be allowed until this transaction has completed
         // NSError *recordError = [SpeechUtility raiseErrorWithMessage:@"A voice query is already in progress"];
         // self.recognizeCallback(nil, recordError);
         return;
     }
-    isNewRecordingAllowed = NO;
+    self.isNewRecordingAllowed = NO;
+    [self startTrace];
+
+    // the token fetch, DNS, TLS and the upgrade, and the capture pipeline, are set up
+    // speculatively while the user answers the permission prompt
+    [self initializeStreaming];
+    [self prepareRecordingAudio];
 
     if ([[AVAudioSession sharedInstance] respondsToSelector:@selector(requestRecordPermission:)]) {
         // iOS 7.x and above. Needs to ask permission
+        [self.trace mark:WATSONSDK_TRACE_PERMISSION_REQUESTED];
         [[AVAudioSession sharedInstance] requestRecordPermission:^(BOOL granted) {
             // Make sure to startRecordingAudio on a thread that has a run loop otherwise audio will not work
             [[NSOperationQueue mainQueue] addOperationWithBlock:^{
                 if (granted) {
                     // Permission granted
+                    [self.trace mark:WATSONSDK_TRACE_PERMISSION_GRANTED];
                     [self startRecordingAudio];
                 } else {
                     // Permission denied
-                    isNewRecordingAllowed = YES;
+                    [self cancelSpeculativeStart];
+                    self.isNewRecordingAllowed = YES;
                     NSError *recordError = [SpeechUtility raiseErrorWithMessage:@"Record permission denied"];
                     self.recognizeCallback(nil, recordError);
                 }
@@ -175,20 +211,182 @@ id oggRef;
     }
 }
 
+/**
+ *  stream a pre-recorded file to the STT service as fast as the connection allows
+ *
+ *  @param path             WAV or raw 16-bit PCM file, mono at 16000 Hz; the file is memory mapped
+ *  @param recognizeHandler (^)(NSDictionary*, NSError*)
+ *  @param dataHandler      (^) (NSData*)
+ */
+- (void) recognizeFile:(NSString*) path recognizeHandler:(void (^)(NSDictionary*, NSError*)) recognizeHandler dataHandler: (void (^) (NSData*)) dataHandler {
+    NSError *error = nil;
+    NSData *audioData = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedAlways error:&error];
+    if (audioData == nil) {
+        if (recognizeHandler) {
+            recognizeHandler(nil, error);
+        }
+        return;
+    }
+    [self recognizeData:audioData recognizeHandler:recognizeHandler dataHandler:dataHandler];
+}
+
+/**
+ *  stream audio held in memory to the STT service as fast as the connection allows
+ *
+ *  @param audioData        WAV or raw 16-bit PCM, mono at 16000 Hz
+ *  @param recognizeHandler (^)(NSDictionary*, NSError*)
+ *  @param dataHandler      (^) (NSData*)
+ */
+- (void) recognizeData:(NSData*) audioData recognizeHandler:(void (^)(NSDictionary*, NSError*)) recognizeHandler dataHandler: (void (^) (NSData*)) dataHandler {
+    if (!self.isNewRecordingAllowed) {
+        return;
+    }
+
+    const unsigned char *bytes = [audioData bytes];
+    size_t length = [audioData length];
+    size_t offset = 0;
+    watson_wav_info info;
+
+    if (watson_wav_parse(bytes, length, &info) == 0) {
+        if (info.format != WATSON_WAV_FORMAT_PCM || info.bits_per_sample != 16 || info.channels != 1 || info.sample_rate != (uint32_t)WATSONSDK_AUDIO_SAMPLE_RATE) {
+            if (recognizeHandler) {
+                recognizeHandler(nil, [SpeechUtility raiseErrorWithMessage:@"Only 16-bit mono PCM at 16000 Hz can be recognized"]);
+            }
+            return;
+        }
+        offset = info.data_offset;
+        length = info.data_length;
+    } else if (length >= 4 && memcmp(bytes, "RIFF", 4) == 0) {
+        if (recognizeHandler) {
+            recognizeHandler(nil, [SpeechUtility raiseErrorWithMessage:@"Malformed WAV data"]);
+        }
+        return;
+    }
+    length -= length % sizeof(int16_t);
+
+    self.isNewRecordingAllowed = NO;
+    // there is no capture to stop, the recognition is over once the service is done with the audio
+    __weak SpeechToText *weakSelf = self;
+    self.recognizeCallback = ^(NSDictionary *results, NSError *error) {
+        if (recognizeHandler) {
+            recognizeHandler(results, error);
+        }
+        if (results == nil) {
+            [[NSOperationQueue mainQueue] addOperationWithBlock:^{
+                weakSelf.isNewRecordingAllowed = YES;
+            }];
+        }
+    };
+    self.audioDataCallback = dataHandler;
+    self.powerLevelCallback = nil;
+    [self startTrace];
+
+    [self initializeStreaming];
+    _recordState.recordedLength = (int)MIN(length, (size_t)INT_MAX);
+
+    BOOL compressed = _recordState.compressedOpus;
+    int frameSize = _recordState.opusFrameSize;
+    size_t chunkLength = (size_t)(WATSONSDK_AUDIO_SAMPLE_RATE * FILE_CHUNK_SECONDS);
+    if (compressed) {
+        chunkLength -= chunkLength % frameSize;
+    }
+    chunkLength *= sizeof(int16_t);
+
+    OpusHelper *opus = self.opus;
+    OggHelper *ogg = self.ogg;
+    WebSocketAudioStreamer *streamer = self.audioStreamer;
+    dispatch_queue_t networkQueue = self.networkQueue;
+    dispatch_semaphore_t inFlight = dispatch_semaphore_create(FILE_CHUNKS_IN_FLIGHT);
+
+    // encode on the encoder's queue once the service is listening, so no audio waits in the
+    // pre-listening buffer where its overflow policy could drop it. A chunk is in flight until
+    // the socket has written it out, and never more than FILE_CHUNKS_IN_FLIGHT are
+    void (^pump)(void) = ^{
+        size_t position = 0;
+        while (position < length) {
+            size_t count = MIN(chunkLength, length - position);
+            BOOL last = position + count == length;
+            NSData *payload;
+
+            if (compressed) {
+                const unsigned char *pcm = (const unsigned char *)[audioData bytes] + offset + position;
+                NSData *aligned = nil;
+                if (((uintptr_t)pcm % sizeof(int16_t)) != 0) {
+                    aligned = [NSData dataWithBytes:pcm length:count];
+                    pcm = [aligned bytes];
+                }
+                payload = [ogg encodePCM:(const int16_t *)pcm
+                                 samples:count / sizeof(int16_t)
+                               frameSize:frameSize
+                                 encoder:opus
+                                   flush:last];
+            } else {
+                payload = [audioData subdataWithRange:NSMakeRange(offset + position, count)];
+            }
+            position += count;
+
+            if (payload == nil || [payload length] == 0) {
+                continue;
+            }
+            dispatch_semaphore_wait(inFlight, DISPATCH_TIME_FOREVER);
+            dispatch_async(networkQueue, ^{
+                [streamer writeData:payload sent:^{
+                    dispatch_semaphore_signal(inFlight);
+                }];
+            });
+        }
+
+        dispatch_async(networkQueue, ^{
+            [streamer sendEndOfStreamMarker];
+        });
+    };
+    [streamer whenListening:^(BOOL listening) {
+        // when the connection fails first the recognize handler has the error already
+        if (listening) {
+            dispatch_async(opus.processingQueue, pump);
+        }
+    }];
+}
+
+/**
+ *  open the websocket ahead of the first recognize so its handshake is off the critical path.
+ *  The socket is used by the next recognize when keepAliveConnection is set
+ */
+- (void) prewarm {
+    if (!self.config.keepAliveConnection || !self.isNewRecordingAllowed || [self.audioStreamer isReusable]) {
+        return;
+    }
+
+    WebSocketAudioStreamer *streamer = [[WebSocketAudioStreamer alloc] init];
+    [streamer prewarm];
+    self.audioStreamer = streamer;
+    [self.config requestToken:^(AuthConfiguration *config) {
+        [streamer connect:(STTConfiguration*)config
+                  headers:[config createRequestHeadersWithXWatsonLearningOptOut]];
+    }];
+}
+
 /**
  *  send out end marker of a stream
  *
  *  @return YES if the data has been sent directly; NO if the data is bufferred because the connection is not established
  */
 -(BOOL) endTransmission {
-    return [[self audioStreamer] sendEndOfStreamMarker];
+    // go through the network queue so the marker follows any audio still being handed over
+    __block BOOL sent = NO;
+    dispatch_sync(self.networkQueue, ^{
+        sent = [[self audioStreamer] sendEndOfStreamMarker];
+    });
+    return sent;
 }
 
 /**
  *  Disconnect
  */
 -(void) endConnection {
-    [[self audioStreamer] disconnect:@"Manually terminating socket connection"];
+    dispatch_sync(self.networkQueue, ^{
+        [[self audioStreamer] disconnect:@"Manually terminating socket connection"];
+    });
 }
 
 /**
@@ -201,6 +399,15 @@ id oggRef;
     [self endTransmission];
 }
 
+/**
+ *  timingTrace - stages of the current or last recognize, with their time since it was called
+ *
+ *  @return STTTimingTrace
+ */
+- (STTTimingTrace*) timingTrace {
+    return self.trace;
+}
+
 /**
  *  listModels - List speech models supported by the service
  *
@@ -339,18 +546,11 @@ id oggRef;
  *  @param withoutCache disable cache
  */
 - (void) performGet:(void (^)(NSDictionary*, NSError*))handler forURL:(NSURL*)url disableCache:(BOOL) withoutCache {
-    // Create and set authentication headers
-    NSURLSessionConfiguration *defaultConfigObject = [NSURLSessionConfiguration defaultSessionConfiguration];
-    
-    if(withoutCache)
-        [defaultConfigObject setURLCache:nil];
-    
     [self.config requestToken:^(AuthConfiguration *config) {
-        NSDictionary* headers = [config createRequestHeaders];
-        [defaultConfigObject setHTTPAdditionalHeaders:headers];
-        NSURLSession *defaultSession = [NSURLSession sessionWithConfiguration: defaultConfigObject delegate: self delegateQueue: [NSOperationQueue mainQueue]];
-        
-        NSURLSessionDataTask * dataTask = [defaultSession dataTaskWithURL:url completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+        // Create and set authentication headers
+        NSURLRequest *request = [config requestWithURL:url headers:[config createRequestHeaders] disableCache:withoutCache];
+
+        NSURLSessionDataTask * dataTask = [[config sharedSession] dataTaskWithRequest:request completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
             [SpeechUtility processJSON:handler config:config response:response data:data error:error];
         }];
         
@@ -360,16 +560,45 @@ id oggRef;
 
 
 /**
- *  Start recording audio
+ *  Start a new timing trace for a recognize
  */
-- (void) startRecordingAudio {
-    // lets start the socket connection right away
-    [self initializeStreaming];
+- (void) startTrace {
+    self.trace = [[STTTimingTrace alloc] init];
+    self.trace.logsStages = self.config.timingTraceLogging;
+    [self.trace mark:WATSONSDK_TRACE_RECOGNIZE];
+}
+
+/**
+ *  Everything recording needs that does not touch the microphone, so it can run before permission is granted
+ */
+- (void) prepareRecordingAudio {
     [self setupAudioFormat:&_recordState.dataFormat];
-    
+
     _recordState.currentPacket = 0;
-    audioRecordedLength = 0;
-    
+    _recordState.recordedLength = 0;
+    _recordState.pendingSamples = 0;
+
+    if (self.config.pipelinedCapture) {
+        [self startCapturePipeline];
+    }
+}
+
+/**
+ *  Undo the speculative connection and capture setup when recording is not allowed
+ */
+- (void) cancelSpeculativeStart {
+    [self stopCapturePipeline];
+    WebSocketAudioStreamer *streamer = self.audioStreamer;
+    dispatch_sync(self.networkQueue, ^{
+        [streamer cancel:@"Record permission denied"];
+    });
+    self.audioStreamer = nil;
+}
+
+/**
+ *  Start recording audio, prepareRecordingAudio and initializeStreaming have run already
+ */
+- (void) startRecordingAudio {
     OSStatus status = AudioQueueNewInput(&_recordState.dataFormat,
                                          AudioInputStreamingCallback,
                                          &_recordState,
@@ -390,6 +619,7 @@ id oggRef;
         _recordState.recording = true;
         status = AudioQueueStart(_recordState.queue, NULL);
         if (status == 0) {
+            [self.trace mark:WATSONSDK_TRACE_AUDIO_STARTED];
 
             UInt32 enableMetering = 1;
             status = AudioQueueSetProperty(_recordState.queue, kAudioQueueProperty_EnableLevelMetering, &enableMetering, sizeof(enableMetering));
@@ -410,7 +640,7 @@ id oggRef;
  *  Stop recording
  */
 - (void) stopRecordingAudio {
-    if(isNewRecordingAllowed) {
+    if(self.isNewRecordingAllowed) {
         NSLog(@"### Record stopped ###");
         return;
     }
@@ -429,9 +659,126 @@ id oggRef;
     if(_recordState.queue != NULL){
         AudioQueueDispose(_recordState.queue, YES);
     }
-    isNewRecordingAllowed = YES;
+    // the queue is stopped synchronously so no callback can write to the ring any more
+    [self stopCapturePipeline];
+    [self flushPendingAudio];
+    self.isNewRecordingAllowed = YES;
+}
+
+/**
+ *  Set up the capture ring and the dispatch source that wakes the encode queue.
+ *  The audio callback only copies into the ring and signals, it never encodes, allocates or blocks
+ */
+- (void) startCapturePipeline {
+    watson_spsc_ring *ring = malloc(sizeof(watson_spsc_ring));
+    if (ring == NULL || watson_spsc_ring_init(ring, (size_t)(WATSONSDK_AUDIO_SAMPLE_RATE * sizeof(int16_t) * CAPTURE_RING_SECONDS)) != 0) {
+        NSLog(@"Unable to allocate the capture ring, encoding on the audio thread");
+        free(ring);
+        return;
+    }
+    _recordState.captureRing = ring;
+
+    // signals coalesce, one drain handles everything written since the last one
+    dispatch_source_t source = dispatch_source_create(DISPATCH_SOURCE_TYPE_DATA_ADD, 0, 0, self.opus.processingQueue);
+    __weak SpeechToText *weakSelf = self;
+    dispatch_source_set_event_handler(source, ^{
+        [weakSelf drainCapturedAudio:NO];
+    });
+    self.captureSource = source;
+    _recordState.captureSource = source;
+    dispatch_resume(source);
+}
+
+/**
+ *  Drain what is left in the capture ring and release it
+ */
+- (void) stopCapturePipeline {
+    if (self.captureSource == nil) {
+        return;
+    }
+    dispatch_source_cancel(self.captureSource);
+    _recordState.captureSource = nil;
+    self.captureSource = nil;
+
+    // runs after any drain already queued, then the ring can be released
+    dispatch_sync(self.opus.processingQueue, ^{
+        [self drainCapturedAudio:YES];
+    });
+    watson_spsc_ring_destroy(_recordState.captureRing);
+    free(_recordState.captureRing);
+    _recordState.captureRing = NULL;
+}
+
+/**
+ *  Encode stage, runs on the encoder's processing queue. Takes whole frames out of the capture ring,
+ *  encodes them when compressing and passes the result on to the network queue
+ *
+ *  @param flush take a trailing partial frame as well and flush the last Ogg page
+ */
+- (void) drainCapturedAudio:(BOOL) flush {
+    watson_spsc_ring *ring = _recordState.captureRing;
+    if (ring == NULL) {
+        return;
+    }
+
+    size_t dropped = watson_spsc_ring_take_dropped(ring);
+    if (dropped > 0) {
+        NSLog(@"Encoder fell behind, dropped %zu bytes of captured audio", dropped);
+    }
+
+    size_t available = watson_spsc_ring_readable(ring);
+    available -= available % sizeof(int16_t);
+    if (_recordState.compressedOpus && !flush) {
+        available -= available % (_recordState.opusFrameSize * sizeof(int16_t));
+    }
+    if (available == 0) {
+        return;
+    }
+
+    NSMutableData *pcm = [NSMutableData dataWithLength:available];
+    watson_spsc_ring_read(ring, [pcm mutableBytes], available);
+
+    NSData *payload = pcm;
+    if (_recordState.compressedOpus) {
+        payload = [self.ogg encodePCM:(const int16_t *)[pcm bytes]
+                              samples:available / sizeof(int16_t)
+                            frameSize:_recordState.opusFrameSize
+                              encoder:self.opus
+                                flush:flush];
+    }
+    if (payload == nil || [payload length] == 0) {
+        return;
+    }
+
+    WebSocketAudioStreamer *streamer = self.audioStreamer;
+    dispatch_async(self.networkQueue, ^{
+        [streamer writeData:payload];
+    });
 }
 
+/**
+ *  Encode the partial frame the audio callback held back, padded with silence, and flush the last Ogg page
+ */
+- (void) flushPendingAudio {
+    if (!_recordState.compressedOpus || _recordState.pendingSamples == 0) {
+        return;
+    }
+
+    NSData *payload = [self.ogg encodePCM:_recordState.pendingPCM
+                                  samples:(NSUInteger)_recordState.pendingSamples
+                                frameSize:_recordState.opusFrameSize
+                                  encoder:self.opus
+                                    flush:YES];
+    _recordState.pendingSamples = 0;
+    if (payload == nil || [payload length] == 0) {
+        return;
+    }
+
+    WebSocketAudioStreamer *streamer = self.audioStreamer;
+    dispatch_async(self.networkQueue, ^{
+        [streamer writeData:payload];
+    });
+}
 
 /**
  *  samplePeakPower - Get the decibel level from the AudioQueue
@@ -457,31 +804,59 @@ id oggRef;
  */
 - (void) initializeStreaming {
 
-    // init the websocket streamer
-    self.audioStreamer = [[WebSocketAudioStreamer alloc] init];
-    [self.audioStreamer setRecognizeHandler:recognizeCallback];
-    [self.audioStreamer setAudioDataHandler:audioDataCallback];
-
-    // connect if we are not connected
-    if(![self.audioStreamer isWebSocketConnected]) {
+    if (self.config.keepAliveConnection && [self.audioStreamer isReusable]) {
+        // a prewarmed socket, or one kept open by the last recognition: skip the handshake
+        [self.audioStreamer setRecognizeHandler:recognizeCallback];
+        [self.audioStreamer setAudioDataHandler:audioDataCallback];
+        [self.audioStreamer setTimingTrace:self.trace];
+        [self.audioStreamer startRecognition];
+    } else {
+        // init the websocket streamer
+        WebSocketAudioStreamer *streamer = [[WebSocketAudioStreamer alloc] init];
+        self.audioStreamer = streamer;
+        [streamer setRecognizeHandler:recognizeCallback];
+        [streamer setAudioDataHandler:audioDataCallback];
+        [streamer setTimingTrace:self.trace];
+
+        STTTimingTrace *trace = self.trace;
         [self.config requestToken:^(AuthConfiguration *config) {
-            [self.audioStreamer connect:(STTConfiguration*)config
-                                headers:[config createRequestHeadersWithXWatsonLearningOptOut]];
+            [trace mark:WATSONSDK_TRACE_TOKEN_READY];
+            [streamer connect:(STTConfiguration*)config
+                      headers:[config createRequestHeadersWithXWatsonLearningOptOut]];
         }];
     }
 
     // Adding Ogg Header
-    if(isCompressedOpus){
+    if(_recordState.compressedOpus){
+        // apply the encoder profile for this recording
+        STTConfiguration *config = self.config;
+        _recordState.opusFrameSize = [config getOpusFrameSize];
+        if (![self.opus isValidFrameSize:_recordState.opusFrameSize]) {
+            _recordState.opusFrameSize = WATSONSDK_AUDIO_FRAME_SIZE;
+        }
+        [self.opus configureEncoderWithBitrate:config.opusBitrate
+                                    complexity:config.opusComplexity
+                               variableBitrate:config.opusVariableBitrate
+                                           dtx:config.opusDTX
+                                     inbandFEC:config.opusInbandFEC
+                          packetLossPercentage:config.opusPacketLossPercentage];
+
         // Adding Ogg instance
         // setup ogg helper
         self.ogg = [[OggHelper alloc] init];
-        oggRef = self->_ogg;
-        // Indicate sample rate
-        [self.audioStreamer writeData:[[self ogg] getOggOpusHeader:WATSONSDK_AUDIO_SAMPLE_RATE]];
+        [self.ogg setFlushInterval:(int)config.opusPageFlushInterval maxPacketsPerPage:(int)config.opusMaxPacketsPerPage];
+        _recordState.ogg = self.ogg;
+        // Indicate sample rate. Like every other write this goes through networkQueue, the Block
+        // overflow policy may wait there and the header must stay ahead of the first audio
+        NSData *oggHeader = [[self ogg] getOggOpusHeader:WATSONSDK_AUDIO_SAMPLE_RATE];
+        WebSocketAudioStreamer *streamer = self.audioStreamer;
+        dispatch_async(self.networkQueue, ^{
+            [streamer writeData:oggHeader];
+        });
     }
     
     // set a pointer to the wsuploader class so it is accessible in the c callback
-    audioStreamerRef = self.audioStreamer;
+    _recordState.audioStreamer = self.audioStreamer;
 }
 
 #pragma mark audio
@@ -499,37 +874,55 @@ id oggRef;
     format->mFormatFlags = kLinearPCMFormatFlagIsSignedInteger | kLinearPCMFormatFlagIsPacked;
 }
 
-int getAudioRecordedLengthInMs()
+- (int) audioRecordedLengthInMs
 {
-    return audioRecordedLength/32;
+    return _recordState.recordedLength/32;
 }
 
-void sendAudioOpusEncoded(NSData *data)
+// every write goes through the network queue, so audio stays behind the Ogg header and ahead of
+// the end of stream marker, and a Block overflow policy never waits on the audio thread
+static void sendAudio(RecordingState *recordState, NSData *data)
+{
+    WebSocketAudioStreamer *streamer = recordState->audioStreamer;
+    dispatch_async(recordState->networkQueue, ^{
+        [streamer writeData:data];
+    });
+}
+
+static void sendAudioOpusEncoded(RecordingState *recordState, NSData *data)
 {
     if (data!=nil && [data length]!=0) {
-        
-        NSUInteger length = [data length];
-        NSUInteger chunkSize = WATSONSDK_AUDIO_FRAME_SIZE * 2;
-        NSUInteger offset = 0;
-        
-        do {
-            NSUInteger thisChunkSize = length - offset > chunkSize ? chunkSize : length - offset;
-            NSData* chunk = [NSData dataWithBytesNoCopy:(char *)[data bytes] + offset
-                                                 length:thisChunkSize
-                                           freeWhenDone:NO];
-            
-            // opus encode block
-            NSData *compressed = [opusRef encode:chunk frameSize:WATSONSDK_AUDIO_FRAME_SIZE];
+        // the encoder pads a trailing partial frame with silence, so only whole frames are
+        // encoded and the rest is carried over to the next buffer, as drainCapturedAudio does
+        int frameSize = recordState->opusFrameSize;
+        int pending = recordState->pendingSamples;
+        NSUInteger samples = pending + [data length] / sizeof(int16_t);
+        NSUInteger whole = samples - samples % frameSize;
+
+        const int16_t *buffer = [data bytes];
+        NSMutableData *joined = nil;
+        if (pending > 0) {
+            joined = [NSMutableData dataWithLength:samples * sizeof(int16_t)];
+            memcpy([joined mutableBytes], recordState->pendingPCM, pending * sizeof(int16_t));
+            memcpy((int16_t *)[joined mutableBytes] + pending, buffer, (samples - pending) * sizeof(int16_t));
+            buffer = [joined bytes];
+        }
+        recordState->pendingSamples = (int)(samples - whole);
+        memcpy(recordState->pendingPCM, buffer + whole, recordState->pendingSamples * sizeof(int16_t));
+        if (whole == 0) {
+            return;
+        }
 
-            if(compressed != nil){
-                NSMutableData *newData = [oggRef writePacket:compressed frameSize:WATSONSDK_AUDIO_FRAME_SIZE];
-                if(newData != nil){
-                    [audioStreamerRef writeData:newData];
-                }
-            }
+        // encode and mux the whole frames in one pass
+        NSData *pages = [recordState->ogg encodePCM:buffer
+                                            samples:whole
+                                          frameSize:frameSize
+                                            encoder:recordState->opus
+                                              flush:NO];
 
-            offset += thisChunkSize;
-        } while (offset < length);
+        if(pages != nil && [pages length] != 0){
+            sendAudio(recordState, pages);
+        }
     }
 }
 
@@ -546,13 +939,20 @@ void AudioInputStreamingCallback(
     OSStatus status=0;
     RecordingState* recordState = (RecordingState*)inUserData;
     
-    NSData *data = [NSData  dataWithBytes:inBuffer->mAudioData length:inBuffer->mAudioDataByteSize];
-    audioRecordedLength += [data length];
+    recordState->recordedLength += inBuffer->mAudioDataByteSize;
+
+    if(recordState->captureRing != NULL) {
+        // pipelined: hand the samples to the encode queue and return the buffer straight away
+        watson_spsc_ring_write(recordState->captureRing, inBuffer->mAudioData, inBuffer->mAudioDataByteSize);
+        dispatch_source_merge_data(recordState->captureSource, 1);
+    } else {
+        NSData *data = [NSData  dataWithBytes:inBuffer->mAudioData length:inBuffer->mAudioDataByteSize];
 
-    if(isCompressedOpus)
-        sendAudioOpusEncoded(data);
-    else
-        [audioStreamerRef writeData:data];
+        if(recordState->compressedOpus)
+            sendAudioOpusEncoded(recordState, data);
+        else
+            sendAudio(recordState, data);
+    }
 
     if(status == 0) {
         recordState->currentPacket += inNumberPacketDescriptions;
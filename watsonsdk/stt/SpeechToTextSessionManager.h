@@ -0,0 +1,65 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#import <Foundation/Foundation.h>
+#import "SpeechToText.h"
+
+/**
+ *  Runs several independent recognition streams side by side. Every session is its own
+ *  SpeechToText instance with its own Opus encoder, Ogg muxer and websocket
+ */
+@interface SpeechToTextSessionManager : NSObject
+
+// 0 for no limit
+@property (nonatomic, readonly) NSUInteger maxConcurrentSessions;
+
++(id)initWithMaxConcurrentSessions:(NSUInteger) maxConcurrentSessions;
+-(id)initWithMaxConcurrentSessions:(NSUInteger) maxConcurrentSessions;
+
+/**
+ *  start a new session streaming audio from the device microphone to the STT service
+ *
+ *  @param config           configuration for this session, it can be shared between sessions
+ *  @param recognizeHandler (^)(NSDictionary*, NSError*)
+ *  @param dataHandler      (^) (NSData*)
+ *  @param powerHandler     (^)(float)
+ *
+ *  @return the running session, nil if maxConcurrentSessions are already running. The session ends
+ *          and frees its slot when the socket closes or the recognize handler gets an error
+ */
+- (SpeechToText*) startSessionWithConfig:(STTConfiguration*) config recognizeHandler:(void (^)(NSDictionary*, NSError*)) recognizeHandler dataHandler: (void (^) (NSData*)) dataHandler powerHandler: (void (^)(float)) powerHandler;
+
+/**
+ *  stop recording, send the end marker and release the slot held by a session
+ *
+ *  @param session SpeechToText returned by startSessionWithConfig:
+ */
+- (void) endSession:(SpeechToText*) session;
+
+/**
+ *  end every running session
+ */
+- (void) endAllSessions;
+
+/**
+ *  sessions started by this manager that have not ended yet
+ *
+ *  @return NSArray of SpeechToText
+ */
+- (NSArray*) activeSessions;
+
+@end
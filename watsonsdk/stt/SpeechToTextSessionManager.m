@@ -0,0 +1,123 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#import "SpeechToTextSessionManager.h"
+
+@interface SpeechToTextSessionManager()
+
+@property (nonatomic, readwrite) NSUInteger maxConcurrentSessions;
+@property NSMutableArray *sessions;
+
+@end
+
+@implementation SpeechToTextSessionManager
+
+/**
+ *  Static method to return a SpeechToTextSessionManager
+ *
+ *  @param maxConcurrentSessions upper bound of sessions running at the same time, 0 for no limit
+ *
+ *  @return SpeechToTextSessionManager
+ */
++(id)initWithMaxConcurrentSessions:(NSUInteger) maxConcurrentSessions {
+    return [[self alloc] initWithMaxConcurrentSessions:maxConcurrentSessions];
+}
+
+/**
+ *  init method to return a SpeechToTextSessionManager
+ *
+ *  @param maxConcurrentSessions upper bound of sessions running at the same time, 0 for no limit
+ *
+ *  @return SpeechToTextSessionManager
+ */
+-(id)initWithMaxConcurrentSessions:(NSUInteger) maxConcurrentSessions {
+    self = [super init];
+    if (self) {
+        self.maxConcurrentSessions = maxConcurrentSessions;
+        self.sessions = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
+- (id)init {
+    return [self initWithMaxConcurrentSessions:0];
+}
+
+- (SpeechToText*) startSessionWithConfig:(STTConfiguration*) config recognizeHandler:(void (^)(NSDictionary*, NSError*)) recognizeHandler dataHandler: (void (^) (NSData*)) dataHandler powerHandler: (void (^)(float)) powerHandler {
+    SpeechToText *session = [[SpeechToText alloc] initWithConfig:config];
+
+    @synchronized (self.sessions) {
+        if (self.maxConcurrentSessions > 0 && [self.sessions count] >= self.maxConcurrentSessions) {
+            return nil;
+        }
+        [self.sessions addObject:session];
+    }
+
+    // the streamer reports a closed socket with neither results nor an error, the slot is free from then on.
+    // A denied microphone or a failed connection only reports an error, so that ends the session as well
+    __weak SpeechToTextSessionManager *weakSelf = self;
+    __weak SpeechToText *weakSession = session;
+    [session recognize:^(NSDictionary *results, NSError *error) {
+        if (recognizeHandler) {
+            recognizeHandler(results, error);
+        }
+        if (error != nil) {
+            // not from inside the streamer's callback, ending the session closes its socket
+            dispatch_async(dispatch_get_main_queue(), ^{
+                [weakSelf endSession:weakSession];
+            });
+        } else if (results == nil) {
+            [weakSelf removeSession:weakSession];
+        }
+    } dataHandler:dataHandler powerHandler:powerHandler];
+
+    return session;
+}
+
+- (void) endSession:(SpeechToText*) session {
+    if (session == nil) {
+        return;
+    }
+    [session endRecognize];
+    [session endConnection];
+    [self removeSession:session];
+}
+
+- (void) endAllSessions {
+    for (SpeechToText *session in [self activeSessions]) {
+        [self endSession:session];
+    }
+}
+
+- (NSArray*) activeSessions {
+    @synchronized (self.sessions) {
+        return [self.sessions copy];
+    }
+}
+
+#pragma mark private methods
+
+- (void) removeSession:(SpeechToText*) session {
+    if (session == nil) {
+        return;
+    }
+    @synchronized (self.sessions) {
+        [self.sessions removeObjectIdenticalTo:session];
+    }
+}
+
+@end
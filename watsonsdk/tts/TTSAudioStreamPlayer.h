@@ -0,0 +1,35 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#import <Foundation/Foundation.h>
+#import <AudioToolbox/AudioQueue.h>
+
+/**
+ *  Plays 16-bit PCM as it is decoded through a small set of AudioQueue buffers, playback
+ *  starts once a couple of buffers are queued instead of waiting for the whole utterance
+ */
+@interface TTSAudioStreamPlayer : NSObject
+
+@property (readonly) long sampleRate;
+@property (readonly) int channels;
+
+- (instancetype) initWithSampleRate:(long) sampleRate channels:(int) channels;
+- (BOOL) enqueuePCM:(NSData*) pcm;
+- (void) finish:(void (^)(NSError*)) completionHandler;
+- (void) stop;
+
+@end
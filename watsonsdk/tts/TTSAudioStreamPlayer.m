@@ -0,0 +1,257 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#import "TTSAudioStreamPlayer.h"
+
+#define NUM_PLAYBACK_BUFFERS 4
+#define PLAYBACK_BUFFER_DURATION_MS 40
+// buffers queued before playback starts, enough to ride out jitter between chunks
+#define PLAYBACK_START_BUFFERS 2
+
+@interface TTSAudioStreamPlayer() {
+    AudioQueueRef _queue;
+    AudioQueueBufferRef _buffers[NUM_PLAYBACK_BUFFERS];
+    AudioQueueBufferRef _freeBuffers[NUM_PLAYBACK_BUFFERS];
+    int _freeBufferCount;
+}
+
+@property NSMutableData *pendingPCM;
+@property (assign) UInt32 bufferByteSize;
+@property (assign) UInt32 frameSize;
+@property (assign) BOOL isStarted;
+@property (assign) BOOL isFinishing;
+@property (assign) BOOL isStopRequested;
+@property (assign) BOOL isStopped;
+@property (nonatomic, copy) void (^completionHandler)(NSError*);
+@property NSError *error;
+
+@end
+
+@implementation TTSAudioStreamPlayer
+
+/**
+ *  Create an output queue for interleaved 16-bit PCM
+ *
+ *  @param sampleRate sample rate of the PCM
+ *  @param channels   number of channels
+ *
+ *  @return TTSAudioStreamPlayer instance, nil if the queue cannot be created
+ */
+- (instancetype) initWithSampleRate:(long) sampleRate channels:(int) channels {
+    if (self = [super init]) {
+        _sampleRate = sampleRate;
+        _channels = channels;
+        _pendingPCM = [[NSMutableData alloc] init];
+        _frameSize = (UInt32)(sizeof(SInt16) * channels);
+        _bufferByteSize = (UInt32)(sampleRate * PLAYBACK_BUFFER_DURATION_MS / 1000) * _frameSize;
+
+        AudioStreamBasicDescription format;
+        memset(&format, 0, sizeof(format));
+        format.mSampleRate = sampleRate;
+        format.mFormatID = kAudioFormatLinearPCM;
+        format.mFormatFlags = kLinearPCMFormatFlagIsSignedInteger | kLinearPCMFormatFlagIsPacked;
+        format.mChannelsPerFrame = channels;
+        format.mBitsPerChannel = 16;
+        format.mFramesPerPacket = 1;
+        format.mBytesPerFrame = _frameSize;
+        format.mBytesPerPacket = _frameSize;
+
+        // no run loop, callbacks come on the queue's own thread so playback does not depend on the main thread
+        OSStatus status = AudioQueueNewOutput(&format, AudioOutputCallback, (__bridge void *)self, NULL, NULL, 0, &_queue);
+        if (status != noErr) {
+            NSLog(@"Cannot create the audio output queue: %d", (int)status);
+            return nil;
+        }
+        AudioQueueAddPropertyListener(_queue, kAudioQueueProperty_IsRunning, AudioRunningListener, (__bridge void *)self);
+
+        for (int i = 0; i < NUM_PLAYBACK_BUFFERS; i++) {
+            status = AudioQueueAllocateBuffer(_queue, _bufferByteSize, &_buffers[i]);
+            if (status != noErr) {
+                NSLog(@"Cannot allocate an audio output buffer: %d", (int)status);
+                return nil;
+            }
+            _freeBuffers[_freeBufferCount++] = _buffers[i];
+        }
+    }
+    return self;
+}
+
+- (void) dealloc {
+    if (_queue) {
+        AudioQueueRemovePropertyListener(_queue, kAudioQueueProperty_IsRunning, AudioRunningListener, (__bridge void *)self);
+        AudioQueueDispose(_queue, true);
+    }
+}
+
+/**
+ *  Queue decoded PCM for playback
+ *
+ *  @param pcm interleaved 16-bit PCM, whole frames
+ *
+ *  @return NO once the player has been stopped or has failed
+ */
+- (BOOL) enqueuePCM:(NSData*) pcm {
+    @synchronized (self) {
+        if (self.isStopped || self.isFinishing || self.error) {
+            return NO;
+        }
+        [self.pendingPCM appendData:pcm];
+        [self fillBuffers];
+        return self.error == nil;
+    }
+}
+
+/**
+ *  No more PCM is coming, play out what is queued
+ *
+ *  @param completionHandler called on the main queue once the last buffer has played
+ */
+- (void) finish:(void (^)(NSError*)) completionHandler {
+    @synchronized (self) {
+        if (self.isStopped) {
+            return;
+        }
+        self.completionHandler = completionHandler;
+        self.isFinishing = YES;
+        [self fillBuffers];
+    }
+}
+
+/**
+ *  Stop playback right away, the completion handler is not called
+ */
+- (void) stop {
+    @synchronized (self) {
+        if (self.isStopped) {
+            return;
+        }
+        self.isStopped = YES;
+        self.completionHandler = nil;
+        [self.pendingPCM setLength:0];
+    }
+    // a synchronous stop waits for the output callback, which takes the lock
+    AudioQueueStop(_queue, true);
+}
+
+#pragma mark private methods
+
+/**
+ *  Move pending PCM into free buffers, start the queue once enough is queued and request
+ *  the asynchronous stop when finishing with nothing left. Called with the lock held
+ */
+- (void) fillBuffers {
+    while (_freeBufferCount > 0) {
+        NSUInteger length = MIN([self.pendingPCM length], self.bufferByteSize);
+        // partial buffers only for the tail of the utterance
+        if (length == 0 || (length < self.bufferByteSize && !self.isFinishing)) {
+            break;
+        }
+
+        AudioQueueBufferRef buffer = _freeBuffers[--_freeBufferCount];
+        memcpy(buffer->mAudioData, [self.pendingPCM bytes], length);
+        buffer->mAudioDataByteSize = (UInt32)length;
+        [self.pendingPCM replaceBytesInRange:NSMakeRange(0, length) withBytes:NULL length:0];
+
+        OSStatus status = AudioQueueEnqueueBuffer(_queue, buffer, 0, NULL);
+        if (status != noErr) {
+            _freeBuffers[_freeBufferCount++] = buffer;
+            [self failWithStatus:status];
+            return;
+        }
+    }
+
+    int queuedBuffers = NUM_PLAYBACK_BUFFERS - _freeBufferCount;
+    if (!self.isStarted && (queuedBuffers >= PLAYBACK_START_BUFFERS || (self.isFinishing && queuedBuffers > 0))) {
+        OSStatus status = AudioQueueStart(_queue, NULL);
+        if (status != noErr) {
+            [self failWithStatus:status];
+            return;
+        }
+        self.isStarted = YES;
+    }
+
+    if (self.isFinishing && !self.isStopRequested && [self.pendingPCM length] == 0) {
+        self.isStopRequested = YES;
+        if (self.isStarted) {
+            // plays out the queued buffers, the running listener reports the end
+            AudioQueueStop(_queue, false);
+        } else {
+            [self complete];
+        }
+    }
+}
+
+- (void) failWithStatus:(OSStatus) status {
+    NSLog(@"Audio output queue error: %d", (int)status);
+    self.error = [NSError errorWithDomain:NSOSStatusErrorDomain code:status userInfo:nil];
+    if (self.isFinishing && !self.isStopRequested) {
+        self.isStopRequested = YES;
+        [self complete];
+    }
+}
+
+/**
+ *  Hand the result to the completion handler on the main queue, called with the lock held
+ */
+- (void) complete {
+    void (^completionHandler)(NSError*) = self.completionHandler;
+    NSError *error = self.error;
+    self.completionHandler = nil;
+    if (completionHandler) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completionHandler(error);
+        });
+    }
+}
+
+- (void) bufferDidPlay:(AudioQueueBufferRef) buffer {
+    @synchronized (self) {
+        _freeBuffers[_freeBufferCount++] = buffer;
+        if (!self.isStopped) {
+            [self fillBuffers];
+        }
+    }
+}
+
+- (void) queueDidStop {
+    @synchronized (self) {
+        if (self.isStopRequested && !self.isStopped) {
+            self.isStopped = YES;
+            [self complete];
+        }
+    }
+}
+
+#pragma mark static methods
+
+static void AudioOutputCallback(void *inUserData, AudioQueueRef inAQ, AudioQueueBufferRef inBuffer)
+{
+    TTSAudioStreamPlayer *player = (__bridge TTSAudioStreamPlayer *)inUserData;
+    [player bufferDidPlay:inBuffer];
+}
+
+static void AudioRunningListener(void *inUserData, AudioQueueRef inAQ, AudioQueuePropertyID inID)
+{
+    UInt32 isRunning = 0;
+    UInt32 size = sizeof(isRunning);
+    if (AudioQueueGetProperty(inAQ, kAudioQueueProperty_IsRunning, &isRunning, &size) == noErr && isRunning == 0) {
+        TTSAudioStreamPlayer *player = (__bridge TTSAudioStreamPlayer *)inUserData;
+        [player queueDidStop];
+    }
+}
+
+@end
@@ -0,0 +1,33 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#import <Foundation/Foundation.h>
+
+typedef void (^TTSStreamDecoderPCMHandler)(NSData *pcm, long sampleRate, int channels);
+
+/**
+ *  Incremental decoder for a synthesize response, feed it the body as it arrives and it hands
+ *  out 16-bit PCM as soon as there is some. Handles the Ogg Opus and WAV codecs
+ */
+@interface TTSStreamDecoder : NSObject
+
+@property (readonly) NSString *audioCodec;
+
+- (instancetype) initWithAudioCodec:(NSString*) audioCodec handler:(TTSStreamDecoderPCMHandler) handler;
+- (BOOL) decodeChunk:(NSData*) chunk;
+
+@end
@@ -0,0 +1,156 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#import "TTSStreamDecoder.h"
+#import "TTSConfiguration.h"
+#import "OpusStreamDecoder.h"
+#import "watson_wav.h"
+
+// the service puts its metadata before the data chunk, anything bigger is not a header we can play
+#define WAV_MAX_HEADER_LENGTH (64 * 1024)
+
+@interface TTSStreamDecoder()
+
+@property (nonatomic, copy) TTSStreamDecoderPCMHandler handler;
+@property OpusStreamDecoder *opusDecoder;
+@property NSMutableData *wavHeader;
+@property (assign) BOOL hasWavHeader;
+@property (assign) BOOL isInvalid;
+@property (assign) long wavSampleRate;
+@property (assign) int wavChannels;
+@property (assign) NSUInteger wavFrameSize;
+@property NSMutableData *wavRemainder;
+
+@end
+
+@implementation TTSStreamDecoder
+
+/**
+ *  Create a decoder for the given codec
+ *
+ *  @param audioCodec WATSONSDK_TTS_AUDIO_CODEC_TYPE_OPUS or WATSONSDK_TTS_AUDIO_CODEC_TYPE_WAV
+ *  @param handler    called with PCM, its sample rate and channels, on the thread calling decodeChunk
+ *
+ *  @return TTSStreamDecoder instance, nil for an unsupported codec
+ */
+- (instancetype) initWithAudioCodec:(NSString*) audioCodec handler:(TTSStreamDecoderPCMHandler) handler {
+    if (self = [super init]) {
+        _audioCodec = audioCodec;
+        _handler = handler;
+
+        if ([audioCodec isEqualToString:WATSONSDK_TTS_AUDIO_CODEC_TYPE_OPUS]) {
+            __weak TTSStreamDecoder *weakSelf = self;
+            _opusDecoder = [[OpusStreamDecoder alloc] initWithSampleRate:WATSONSDK_TTS_AUDIO_CODEC_TYPE_OPUS_SAMPLE_RATE handler:^(NSData *pcm) {
+                TTSStreamDecoder *strongSelf = weakSelf;
+                if (strongSelf && strongSelf.handler) {
+                    strongSelf.handler(pcm, strongSelf.opusDecoder.sampleRate, strongSelf.opusDecoder.channels);
+                }
+            }];
+            if (_opusDecoder == nil) {
+                return nil;
+            }
+        } else if ([audioCodec isEqualToString:WATSONSDK_TTS_AUDIO_CODEC_TYPE_WAV]) {
+            _wavHeader = [[NSMutableData alloc] init];
+            _wavRemainder = [[NSMutableData alloc] init];
+        } else {
+            NSLog(@"Streaming is not supported for %@", audioCodec);
+            return nil;
+        }
+    }
+    return self;
+}
+
+/**
+ *  Decode the next chunk of the response body, chunks do not need to be aligned to pages, headers or samples
+ *
+ *  @param chunk response data
+ *
+ *  @return NO if the stream is invalid
+ */
+- (BOOL) decodeChunk:(NSData*) chunk {
+    if (self.isInvalid) {
+        return NO;
+    }
+    if (self.opusDecoder) {
+        self.isInvalid = ![self.opusDecoder decodeChunk:chunk];
+    } else {
+        self.isInvalid = ![self decodeWavChunk:chunk];
+    }
+    return !self.isInvalid;
+}
+
+#pragma mark private methods
+
+- (BOOL) decodeWavChunk:(NSData*) chunk {
+    if (self.hasWavHeader) {
+        [self emitWavSamples:chunk];
+        return YES;
+    }
+
+    [self.wavHeader appendData:chunk];
+    const unsigned char *bytes = [self.wavHeader bytes];
+    size_t length = [self.wavHeader length];
+
+    if (length >= 12 && (memcmp(bytes, "RIFF", 4) != 0 || memcmp(bytes + 8, "WAVE", 4) != 0)) {
+        NSLog(@"Invalid WAV stream");
+        return NO;
+    }
+
+    watson_wav_info info;
+    if (watson_wav_parse(bytes, length, &info) != 0) {
+        // the header is not complete yet
+        if (length > WAV_MAX_HEADER_LENGTH) {
+            NSLog(@"Invalid WAV stream, no data chunk in the first %d bytes", WAV_MAX_HEADER_LENGTH);
+            return NO;
+        }
+        return YES;
+    }
+    if (info.format != WATSON_WAV_FORMAT_PCM || info.bits_per_sample != 16 || info.channels == 0) {
+        NSLog(@"Unsupported WAV stream, format %d with %d bits per sample", info.format, info.bits_per_sample);
+        return NO;
+    }
+
+    self.hasWavHeader = YES;
+    self.wavSampleRate = info.sample_rate;
+    self.wavChannels = info.channels;
+    self.wavFrameSize = sizeof(int16_t) * info.channels;
+
+    // the service leaves the data size unset, whatever follows the header is audio
+    NSData *samples = [self.wavHeader subdataWithRange:NSMakeRange(info.data_offset, length - info.data_offset)];
+    self.wavHeader = nil;
+    [self emitWavSamples:samples];
+    return YES;
+}
+
+/**
+ *  Hand out whole frames only, a chunk can end in the middle of a sample
+ */
+- (void) emitWavSamples:(NSData*) samples {
+    [self.wavRemainder appendData:samples];
+    NSUInteger length = [self.wavRemainder length] - ([self.wavRemainder length] % self.wavFrameSize);
+    if (length == 0) {
+        return;
+    }
+
+    NSData *pcm = [self.wavRemainder subdataWithRange:NSMakeRange(0, length)];
+    [self.wavRemainder replaceBytesInRange:NSMakeRange(0, length) withBytes:NULL length:0];
+    if (self.handler) {
+        self.handler(pcm, self.wavSampleRate, self.wavChannels);
+    }
+}
+
+@end
@@ -31,6 +31,10 @@
 
 - (void)synthesize:(void (^)(NSData*, NSError*)) synthesizeHandler theText:(NSString*) text;
 - (void)synthesize:(void (^)(NSData*, NSError*)) synthesizeHandler theText:(NSString*) text customizationId:(NSString*) customizationId;
+- (void)synthesizeStream:(void (^)(NSData*, NSError*)) chunkHandler theText:(NSString*) text;
+- (void)synthesizeStream:(void (^)(NSData*, NSError*)) chunkHandler theText:(NSString*) text customizationId:(NSString*) customizationId;
+- (void)synthesizeAndPlay:(void (^)(NSError*)) audioHandler theText:(NSString*) text;
+- (void)synthesizeAndPlay:(void (^)(NSError*)) audioHandler theText:(NSString*) text customizationId:(NSString*) customizationId;
 
 - (void)listVoices:(void (^)(NSDictionary*, NSError*))handler;
 - (void)saveAudio:(NSData*) audio toFile:(NSString*) path;
@@ -16,6 +16,9 @@
 
 #import "TextToSpeech.h"
 #import "AuthConfigurationInternal.h"
+#import "watson_wav.h"
+#import "TTSStreamDecoder.h"
+#import "TTSAudioStreamPlayer.h"
 
 typedef void (^PlayAudioCallbackBlockType)(NSError*);
 
@@ -24,6 +27,9 @@ typedef void (^PlayAudioCallbackBlockType)(NSError*);
 @property (strong, nonatomic) AVAudioPlayer *audioPlayer;
 @property (nonatomic,copy) PlayAudioCallbackBlockType playAudioCallback;
 @property (assign, nonatomic) long sampleRate;
+@property NSURLSessionDataTask *streamTask;
+@property TTSStreamDecoder *streamDecoder;
+@property TTSAudioStreamPlayer *streamPlayer;
 @end
 
 
@@ -59,6 +65,10 @@ typedef void (^PlayAudioCallbackBlockType)(NSError*);
     self.sampleRate = 0;
     // setup opus helper
     self.opus = [[OpusHelper alloc] init];
+    // have a decoder ready before the first utterance arrives
+    [OpusHelper prewarmPoolWithSampleRate:WATSONSDK_TTS_AUDIO_CODEC_TYPE_OPUS_SAMPLE_RATE encoders:0 decoders:1];
+    // and a token before the first synthesize
+    [config prefetchToken];
     
     return self;
 }
@@ -72,6 +82,111 @@ typedef void (^PlayAudioCallbackBlockType)(NSError*);
     [self performDataGet:synthesizeHandler forURL:[self.config getSynthesizeURL:text customizationId:customizationId]];
 }
 
+/**
+ *  synthesizeStream - Synthesize text and receive the audio as it arrives instead of once it is complete
+ *
+ *  @param chunkHandler called on a background queue with every chunk of audio in order, then with (nil, nil) at the end
+ *                      or with (nil, error) if the request fails
+ *  @param text         text to synthesize
+ */
+- (void)synthesizeStream:(void (^)(NSData*, NSError*)) chunkHandler theText:(NSString*) text {
+    [self performStreamingGet:chunkHandler forURL:[self.config getSynthesizeURL:text]];
+}
+
+- (void)synthesizeStream:(void (^)(NSData*, NSError*)) chunkHandler theText:(NSString*) text customizationId:(NSString*) customizationId {
+    [self performStreamingGet:chunkHandler forURL:[self.config getSynthesizeURL:text customizationId:customizationId]];
+}
+
+/**
+ *  synthesizeAndPlay - Synthesize text and play it while it downloads, playback starts with the first decoded audio
+ *
+ *  @param audioHandler called on the main queue once the audio has played, or with the error that stopped it
+ *  @param text         text to synthesize
+ */
+- (void)synthesizeAndPlay:(void (^)(NSError*)) audioHandler theText:(NSString*) text {
+    [self synthesizeAndPlay:audioHandler theText:text customizationId:nil];
+}
+
+- (void)synthesizeAndPlay:(void (^)(NSError*)) audioHandler theText:(NSString*) text customizationId:(NSString*) customizationId {
+    [self stopAudio];
+
+    // the decoder, the player and the task are swapped under the lock, a chunk is decoded with it
+    // held so stopAudio cannot slip between the check and a new player being created
+    __weak TextToSpeech *weakSelf = self;
+    __block BOOL playerFailed = NO;
+    TTSStreamDecoder *decoder = [[TTSStreamDecoder alloc] initWithAudioCodec:self.config.audioCodec handler:^(NSData *pcm, long pcmSampleRate, int channels) {
+        TextToSpeech *strongSelf = weakSelf;
+        if (strongSelf == nil || playerFailed) {
+            return;
+        }
+        if (strongSelf.streamPlayer == nil) {
+            strongSelf.streamPlayer = [[TTSAudioStreamPlayer alloc] initWithSampleRate:pcmSampleRate channels:channels];
+            if (strongSelf.streamPlayer == nil) {
+                playerFailed = YES;
+                return;
+            }
+        }
+        [strongSelf.streamPlayer enqueuePCM:pcm];
+    }];
+    if (decoder == nil) {
+        audioHandler([SpeechUtility raiseErrorWithCode:0 message:[NSString stringWithFormat:@"Streaming is not supported for %@", self.config.audioCodec] reason:@"Unsupported audio codec" suggestion:@"Use audio/opus or audio/wav"]);
+        return;
+    }
+    @synchronized (self) {
+        self.streamDecoder = decoder;
+    }
+
+    void (^streamHandler)(NSData*, NSError*) = ^(NSData *chunk, NSError *error) {
+        TextToSpeech *strongSelf = weakSelf;
+        if (strongSelf == nil) {
+            return;
+        }
+
+        TTSAudioStreamPlayer *player;
+        @synchronized (strongSelf) {
+            // stopAudio or a newer synthesizeAndPlay took over
+            if (strongSelf.streamDecoder != decoder) {
+                return;
+            }
+            if (chunk) {
+                BOOL decoded = [decoder decodeChunk:chunk];
+                if (decoded && !playerFailed) {
+                    return;
+                }
+                if (playerFailed) {
+                    error = [SpeechUtility raiseErrorWithCode:0 message:@"Cannot play audio" reason:@"The audio output queue cannot be created" suggestion:@""];
+                } else {
+                    error = [SpeechUtility raiseErrorWithCode:0 message:@"Invalid audio stream" reason:@"The response cannot be decoded" suggestion:@""];
+                }
+                [strongSelf.streamTask cancel];
+            }
+
+            player = strongSelf.streamPlayer;
+            strongSelf.streamDecoder = nil;
+            strongSelf.streamTask = nil;
+            if (error) {
+                strongSelf.streamPlayer = nil;
+            }
+        }
+
+        if (error) {
+            [player stop];
+            dispatch_async(dispatch_get_main_queue(), ^{
+                audioHandler(error);
+            });
+        } else if (player) {
+            [player finish:audioHandler];
+        } else {
+            dispatch_async(dispatch_get_main_queue(), ^{
+                audioHandler(nil);
+            });
+        }
+    };
+
+    NSURL *url = customizationId ? [self.config getSynthesizeURL:text customizationId:customizationId] : [self.config getSynthesizeURL:text];
+    [self performStreamingGet:streamHandler forURL:url];
+}
+
 /**
  *  listVoices - List voices supported by the service
  *
@@ -186,6 +301,17 @@ typedef void (^PlayAudioCallbackBlockType)(NSError*);
     [self.audioPlayer stop];
     [self.audioPlayer setDelegate:nil];
     self.audioPlayer = nil;
+
+    // streamed playback, a chunk being decoded finishes first and no player is created after this
+    TTSAudioStreamPlayer *player;
+    @synchronized (self) {
+        self.streamDecoder = nil;
+        [self.streamTask cancel];
+        self.streamTask = nil;
+        player = self.streamPlayer;
+        self.streamPlayer = nil;
+    }
+    [player stop];
 }
 
 - (void)audioPlayerDecodeErrorDidOccur:(AVAudioPlayer *)player
@@ -201,62 +327,12 @@ typedef void (^PlayAudioCallbackBlockType)(NSError*);
 
 - (NSMutableData *)addWavHeader:(NSData *)wavNoheader {
     
-    int headerSize = 44;
-    long totalAudioLen = [wavNoheader length];
-    long totalDataLen = [wavNoheader length] + headerSize-8;
     long longSampleRate = (self.sampleRate == 0 ? 48000 : self.sampleRate);
     int channels = 1;
-    long byteRate = 16 * 11025 * channels/8;
-
-    Byte *header = (Byte*)malloc(44);
-    header[0] = 'R';  // RIFF/WAVE header
-    header[1] = 'I';
-    header[2] = 'F';
-    header[3] = 'F';
-    header[4] = (Byte) (totalDataLen & 0xff);
-    header[5] = (Byte) ((totalDataLen >> 8) & 0xff);
-    header[6] = (Byte) ((totalDataLen >> 16) & 0xff);
-    header[7] = (Byte) ((totalDataLen >> 24) & 0xff);
-    header[8] = 'W';
-    header[9] = 'A';
-    header[10] = 'V';
-    header[11] = 'E';
-    header[12] = 'f';  // 'fmt ' chunk
-    header[13] = 'm';
-    header[14] = 't';
-    header[15] = ' ';
-    header[16] = 16;  // 4 bytes: size of 'fmt ' chunk
-    header[17] = 0;
-    header[18] = 0;
-    header[19] = 0;
-    header[20] = 1;  // format = 1
-    header[21] = 0;
-    header[22] = (Byte) channels;
-    header[23] = 0;
-    header[24] = (Byte) (longSampleRate & 0xff);
-    header[25] = (Byte) ((longSampleRate >> 8) & 0xff);
-    header[26] = (Byte) ((longSampleRate >> 16) & 0xff);
-    header[27] = (Byte) ((longSampleRate >> 24) & 0xff);
-    header[28] = (Byte) (byteRate & 0xff);
-    header[29] = (Byte) ((byteRate >> 8) & 0xff);
-    header[30] = (Byte) ((byteRate >> 16) & 0xff);
-    header[31] = (Byte) ((byteRate >> 24) & 0xff);
-    header[32] = (Byte) (2 * 8 / 8);  // block align
-    header[33] = 0;
-    header[34] = 16;  // bits per sample
-    header[35] = 0;
-    header[36] = 'd';
-    header[37] = 'a';
-    header[38] = 't';
-    header[39] = 'a';
-    header[40] = (Byte) (totalAudioLen & 0xff);
-    header[41] = (Byte) ((totalAudioLen >> 8) & 0xff);
-    header[42] = (Byte) ((totalAudioLen >> 16) & 0xff);
-    header[43] = (Byte) ((totalAudioLen >> 24) & 0xff);
-    
-    NSMutableData *newWavData = [NSMutableData dataWithBytes:header length:44];
-    [newWavData appendBytes:[wavNoheader bytes] length:[wavNoheader length]];
-    free(header);
+
+    NSMutableData *newWavData = [NSMutableData dataWithLength:WATSON_WAV_HEADER_SIZE];
+    watson_wav_write_header([newWavData mutableBytes], (uint32_t)[wavNoheader length], (uint32_t)longSampleRate, channels);
+    [newWavData appendData:wavNoheader];
     return newWavData;
 }
 
@@ -270,21 +346,15 @@ typedef void (^PlayAudioCallbackBlockType)(NSError*);
  */
 -(NSData*) stripAndAddWavHeader:(NSData*) wav {
     
-    int headerSize = 44;
-    int metadataSize = 48;
+    const unsigned char *bytes = [wav bytes];
 
-    if(sampleRate == 0 && [wav length] > 28)
-        [wav getBytes:&sampleRate range: NSMakeRange(24, 4)]; // Read wav sample rate from 24
+    if(sampleRate == 0)
+        sampleRate = watson_wav_sample_rate(bytes, [wav length]);
 
-    NSData *wavNoheader= [NSMutableData dataWithData:[wav subdataWithRange:NSMakeRange(headerSize+metadataSize, [wav length])]];
-    
-    NSMutableData *newWavData;
-    newWavData = [self addWavHeader:wavNoheader];
-    
-    return newWavData;
-    
-    
+    size_t offset = watson_wav_tts_data_offset(bytes, [wav length]);
+    NSData *wavNoheader = [wav subdataWithRange:NSMakeRange(offset, [wav length] - offset)];
     
+    return [self addWavHeader:wavNoheader];
 }
 
 -(void) saveAudio:(NSData*) audio toFile:(NSString*) path {
@@ -302,18 +372,11 @@ typedef void (^PlayAudioCallbackBlockType)(NSError*);
     [self performGet:handler forURL:url disableCache:NO];
 }
 - (void) performGet:(void (^)(NSDictionary*, NSError*))handler forURL:(NSURL*)url disableCache:(BOOL) withoutCache {
-    // Create and set authentication headers
-    NSURLSessionConfiguration *defaultConfigObject = [NSURLSessionConfiguration defaultSessionConfiguration];
-
-    if(withoutCache)
-        [defaultConfigObject setURLCache:nil];
-
     [self.config requestToken:^(AuthConfiguration *config) {
-        NSDictionary* headers = [config createRequestHeaders];
-        [defaultConfigObject setHTTPAdditionalHeaders:headers];
-        NSURLSession *defaultSession = [NSURLSession sessionWithConfiguration: defaultConfigObject delegate: self delegateQueue: [NSOperationQueue mainQueue]];
-        
-        NSURLSessionDataTask * dataTask = [defaultSession dataTaskWithURL:url completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+        // Create and set authentication headers
+        NSURLRequest *request = [config requestWithURL:url headers:[config createRequestHeaders] disableCache:withoutCache];
+
+        NSURLSessionDataTask * dataTask = [[config sharedSession] dataTaskWithRequest:request completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
             [SpeechUtility processJSON:handler config:config response:response data:data error:error];
         }];
 
@@ -334,17 +397,11 @@ typedef void (^PlayAudioCallbackBlockType)(NSError*);
 
 - (void) performDataGet:(void (^)(NSData*, NSError*))handler forURL:(NSURL*)url disableCache:(BOOL) withoutCache {
     
-    // Create and set authentication headers
-    NSURLSessionConfiguration *defaultConfigObject = [NSURLSessionConfiguration defaultSessionConfiguration];
-    
-    if(withoutCache)
-        [defaultConfigObject setURLCache:nil];
-    
     [self.config requestToken:^(AuthConfiguration *config) {
-        NSDictionary* headers = [config createRequestHeadersWithXWatsonLearningOptOut];
-        [defaultConfigObject setHTTPAdditionalHeaders:headers];
-        NSURLSession *defaultSession = [NSURLSession sessionWithConfiguration: defaultConfigObject delegate: self delegateQueue: [NSOperationQueue mainQueue]];
-        NSURLSessionDataTask * dataTask = [defaultSession dataTaskWithURL:url completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+        // Create and set authentication headers
+        NSURLRequest *request = [config requestWithURL:url headers:[config createRequestHeadersWithXWatsonLearningOptOut] disableCache:withoutCache];
+
+        NSURLSessionDataTask * dataTask = [[config sharedSession] dataTaskWithRequest:request completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
             [SpeechUtility processData:handler config:config response:response data:data error:error];
         }];
 
@@ -352,6 +409,40 @@ typedef void (^PlayAudioCallbackBlockType)(NSError*);
     }];
 }
 
+/**
+ *  performStreamingGet - shared method for performing GET requests whose body is handed over as it arrives
+ *
+ *  @param chunkHandler (^)(NSData*, NSError*)) called with every chunk, then with (nil, nil) or (nil, error)
+ *  @param url          url to perform GET request on
+ */
+- (void) performStreamingGet:(void (^)(NSData*, NSError*))chunkHandler forURL:(NSURL*)url {
+    [self.config requestToken:^(AuthConfiguration *config) {
+        // Create and set authentication headers
+        NSURLRequest *request = [config requestWithURL:url headers:[config createRequestHeadersWithXWatsonLearningOptOut] disableCache:NO];
+
+        // an error body is JSON and is only parsed once complete
+        NSMutableData *errorData = [[NSMutableData alloc] init];
+
+        NSURLSessionDataTask * dataTask = [config streamingDataTaskWithRequest:request dataHandler:^(NSURLResponse *response, NSData *chunk) {
+            if ([response isKindOfClass:[NSHTTPURLResponse class]] && [(NSHTTPURLResponse*) response statusCode] != 200) {
+                [errorData appendData:chunk];
+                return;
+            }
+            chunkHandler(chunk, nil);
+        } completionHandler:^(NSURLResponse *response, NSError *error) {
+            BOOL failed = [response isKindOfClass:[NSHTTPURLResponse class]] && [(NSHTTPURLResponse*) response statusCode] != 200;
+            [SpeechUtility processData:^(id data, NSError *requestError) {
+                chunkHandler(nil, requestError);
+            } config:config response:response data:(failed ? errorData : nil) error:error];
+        }];
+
+        @synchronized (self) {
+            self.streamTask = dataTask;
+        }
+        [dataTask resume];
+    }];
+}
+
 /**
  *  performPost - shared method for performing POST requests to a given url calling a handler parameter with the result
  *
@@ -359,20 +450,15 @@ typedef void (^PlayAudioCallbackBlockType)(NSError*);
  *  @param url     url to perform GET request on
  */
 - (void) performRequest: (NSString*) method handler: (void (^)(NSDictionary*, NSError*))customizationHandler forURL:(NSURL*)url data: (NSData*) postData {
-    // Create and set authentication headers
-    NSURLSessionConfiguration *defaultConfigObject = [NSURLSessionConfiguration defaultSessionConfiguration];
-
     [self.config requestToken:^(AuthConfiguration *config) {
-        NSDictionary* headers = [config createRequestHeaders];
-        [defaultConfigObject setHTTPAdditionalHeaders:headers];
-        NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:url];
+        // Create and set authentication headers
+        NSMutableURLRequest *request = [config requestWithURL:url headers:[config createRequestHeaders] disableCache:NO];
         [request setHTTPMethod: method];
 
         [request setValue:@"application/json" forHTTPHeaderField:@"Content-Type"];
         [request setHTTPBody:postData];
 
-        NSURLSession *defaultSession = [NSURLSession sessionWithConfiguration: defaultConfigObject delegate: self delegateQueue: [NSOperationQueue mainQueue]];
-        NSURLSessionDataTask * dataTask = [defaultSession dataTaskWithRequest:request completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+        NSURLSessionDataTask * dataTask = [[config sharedSession] dataTaskWithRequest:request completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
             [SpeechUtility processJSON:customizationHandler config:config response:response data:data error:error];
         }];
 
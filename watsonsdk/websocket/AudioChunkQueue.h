@@ -0,0 +1,70 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#import <Foundation/Foundation.h>
+#import "STTConfiguration.h"
+
+/**
+ *  Bounded FIFO of audio chunks waiting for the socket. Memory use is capped by bytes and by how
+ *  long a chunk may wait; the overflow policy decides whether the oldest audio is dropped, the
+ *  writer waits or the excess is moved to a temporary file. Thread safe
+ */
+@interface AudioChunkQueue : NSObject
+
+@property (atomic) NSUInteger maxBytes;
+@property (atomic) NSTimeInterval maxDuration;
+@property (atomic) STTAudioBufferOverflowPolicy policy;
+@property (atomic) NSTimeInterval blockTimeout;
+
+- (id) initWithMaxBytes:(NSUInteger) maxBytes maxDuration:(NSTimeInterval) maxDuration policy:(STTAudioBufferOverflowPolicy) policy;
+
+/**
+ *  Append a chunk, evicting the oldest audio as the policy says
+ *
+ *  @return NO when the Block policy needs the caller to waitForSpace: first
+ */
+- (BOOL) enqueue:(NSData*) data;
+
+/**
+ *  Append a chunk whatever the policy, dropping the oldest audio to make room
+ */
+- (void) forceEnqueue:(NSData*) data;
+
+/**
+ *  Wait up to blockTimeout for a chunk of length bytes to fit
+ *
+ *  @return YES if it fits now
+ */
+- (BOOL) waitForSpace:(NSUInteger) length;
+
+/**
+ *  Take the oldest audio, coalescing or splitting chunks into one frame
+ *
+ *  @param maxLength largest frame to return
+ *
+ *  @return up to maxLength bytes, nil when the queue is empty
+ */
+- (NSData*) dequeueUpToLength:(NSUInteger) maxLength;
+
+- (void) clear;
+
+- (NSUInteger) queuedBytes;     // in memory and on disk
+- (NSUInteger) queuedChunks;    // in memory
+- (NSUInteger) spilledBytes;
+- (NSUInteger) droppedBytes;
+
+@end
@@ -0,0 +1,308 @@
+/**
+ * Copyright IBM Corporation 2016
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ **/
+
+
+#import "AudioChunkQueue.h"
+
+@interface AudioChunk : NSObject
+
+@property NSData *data;
+@property CFAbsoluteTime queuedAt;
+
+@end
+
+@implementation AudioChunk
+@end
+
+@interface AudioChunkQueue ()
+
+@property NSCondition *condition;
+@property NSMutableArray *chunks;
+@property NSUInteger memoryBytes;
+@property NSUInteger dropped;
+// the first chunk carries the Ogg stream header, so it is never dropped
+@property BOOL isHeadPinned;
+
+@property NSString *spillPath;
+@property NSFileHandle *spillHandle;
+@property unsigned long long spillReadOffset;
+@property unsigned long long spillWriteOffset;
+
+@end
+
+@implementation AudioChunkQueue
+
+- (id) initWithMaxBytes:(NSUInteger) maxBytes maxDuration:(NSTimeInterval) maxDuration policy:(STTAudioBufferOverflowPolicy) policy {
+    self = [super init];
+    if (self) {
+        self.maxBytes = maxBytes;
+        self.maxDuration = maxDuration;
+        self.policy = policy;
+        self.blockTimeout = WATSONSDK_AUDIO_BUFFER_BLOCK_TIMEOUT;
+        self.condition = [[NSCondition alloc] init];
+        self.chunks = [[NSMutableArray alloc] init];
+        self.isHeadPinned = YES;
+    }
+    return self;
+}
+
+- (void) dealloc {
+    [self removeSpillFile];
+}
+
+- (BOOL) enqueue:(NSData*) data {
+    if ([data length] == 0) {
+        return YES;
+    }
+    [self.condition lock];
+    if (self.policy == STTAudioBufferOverflowBlock && [self.chunks count] > 0 && self.memoryBytes + [data length] > self.maxBytes) {
+        [self.condition unlock];
+        return NO;
+    }
+    [self appendChunk:data];
+    [self evictOverflowSpilling:self.policy == STTAudioBufferOverflowSpillToDisk];
+    [self.condition unlock];
+    return YES;
+}
+
+- (void) forceEnqueue:(NSData*) data {
+    if ([data length] == 0) {
+        return;
+    }
+    [self.condition lock];
+    [self appendChunk:data];
+    [self evictOverflowSpilling:self.policy == STTAudioBufferOverflowSpillToDisk];
+    [self.condition unlock];
+}
+
+- (BOOL) waitForSpace:(NSUInteger) length {
+    NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:self.blockTimeout];
+    BOOL fits = YES;
+
+    [self.condition lock];
+    while ([self.chunks count] > 0 && self.memoryBytes + length > self.maxBytes) {
+        if (![self.condition waitUntilDate:deadline]) {
+            fits = [self.chunks count] == 0 || self.memoryBytes + length <= self.maxBytes;
+            break;
+        }
+    }
+    [self.condition unlock];
+    return fits;
+}
+
+- (NSData*) dequeueUpToLength:(NSUInteger) maxLength {
+    NSData *frame = nil;
+    if (maxLength == 0) {
+        return nil;
+    }
+
+    [self.condition lock];
+    if (self.isHeadPinned && [self.chunks count] > 0) {
+        // the header stays in memory and goes out alone, ahead of anything spilled after it
+        AudioChunk *chunk = [self.chunks objectAtIndex:0];
+        frame = chunk.data;
+        if ([frame length] <= maxLength) {
+            [self.chunks removeObjectAtIndex:0];
+            self.isHeadPinned = NO;
+        } else {
+            frame = [chunk.data subdataWithRange:NSMakeRange(0, maxLength)];
+            chunk.data = [chunk.data subdataWithRange:NSMakeRange(maxLength, [chunk.data length] - maxLength)];
+        }
+        self.memoryBytes -= [frame length];
+    } else if (self.spillWriteOffset > self.spillReadOffset) {
+        // anything on disk is older than what is in memory
+        frame = [self readSpilled:maxLength];
+    }
+
+    if (frame == nil && [self.chunks count] > 0) {
+        NSMutableData *coalesced = nil;
+        NSUInteger length = 0;
+
+        while ([self.chunks count] > 0 && length < maxLength) {
+            AudioChunk *chunk = [self.chunks objectAtIndex:0];
+            NSUInteger room = maxLength - length;
+            NSData *piece = chunk.data;
+
+            if ([piece length] <= room) {
+                [self.chunks removeObjectAtIndex:0];
+                self.isHeadPinned = NO;
+            } else {
+                piece = [chunk.data subdataWithRange:NSMakeRange(0, room)];
+                chunk.data = [chunk.data subdataWithRange:NSMakeRange(room, [chunk.data length] - room)];
+            }
+            self.memoryBytes -= [piece length];
+            length += [piece length];
+
+            if (frame == nil) {
+                frame = piece;
+            } else {
+                if (coalesced == nil) {
+                    coalesced = [NSMutableData dataWithCapacity:maxLength];
+                    [coalesced appendData:frame];
+                    frame = coalesced;
+                }
+                [coalesced appendData:piece];
+            }
+        }
+    }
+    [self.condition broadcast];
+    [self.condition unlock];
+    return frame;
+}
+
+- (void) clear {
+    [self.condition lock];
+    [self.chunks removeAllObjects];
+    self.memoryBytes = 0;
+    self.isHeadPinned = YES;
+    [self removeSpillFile];
+    [self.condition broadcast];
+    [self.condition unlock];
+}
+
+- (NSUInteger) queuedBytes {
+    [self.condition lock];
+    NSUInteger bytes = self.memoryBytes + (NSUInteger)(self.spillWriteOffset - self.spillReadOffset);
+    [self.condition unlock];
+    return bytes;
+}
+
+- (NSUInteger) queuedChunks {
+    [self.condition lock];
+    NSUInteger count = [self.chunks count];
+    [self.condition unlock];
+    return count;
+}
+
+- (NSUInteger) spilledBytes {
+    [self.condition lock];
+    NSUInteger bytes = (NSUInteger)(self.spillWriteOffset - self.spillReadOffset);
+    [self.condition unlock];
+    return bytes;
+}
+
+- (NSUInteger) droppedBytes {
+    [self.condition lock];
+    NSUInteger bytes = self.dropped;
+    [self.condition unlock];
+    return bytes;
+}
+
+#pragma mark private methods, called with the condition locked
+
+- (void) appendChunk:(NSData*) data {
+    AudioChunk *chunk = [[AudioChunk alloc] init];
+    chunk.data = data;
+    chunk.queuedAt = CFAbsoluteTimeGetCurrent();
+    [self.chunks addObject:chunk];
+    self.memoryBytes += [data length];
+}
+
+/**
+ *  Remove the oldest chunks while the queue is over its byte cap or they have waited longer
+ *  than maxDuration. The newest chunk always stays
+ *
+ *  @param spill move them to disk instead of dropping them
+ */
+- (void) evictOverflowSpilling:(BOOL) spill {
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    // the header is never evicted, not even to disk, where a failed spill would lose it
+    NSUInteger index = self.isHeadPinned ? 1 : 0;
+
+    while (index + 1 < [self.chunks count]) {
+        AudioChunk *chunk = [self.chunks objectAtIndex:index];
+        BOOL overBytes = self.memoryBytes > self.maxBytes;
+        BOOL expired = self.maxDuration > 0 && now - chunk.queuedAt > self.maxDuration;
+        if (!overBytes && !expired) {
+            break;
+        }
+
+        [self.chunks removeObjectAtIndex:index];
+        self.memoryBytes -= [chunk.data length];
+        if (!spill || ![self spill:chunk.data]) {
+            self.dropped += [chunk.data length];
+        }
+    }
+}
+
+- (BOOL) spill:(NSData*) data {
+    if (self.spillHandle == nil) {
+        NSString *name = [NSString stringWithFormat:@"watson-audio-%@.spill", [[NSUUID UUID] UUIDString]];
+        NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:name];
+        if (![[NSFileManager defaultManager] createFileAtPath:path contents:nil attributes:nil]) {
+            return NO;
+        }
+        self.spillPath = path;
+        self.spillHandle = [NSFileHandle fileHandleForUpdatingAtPath:path];
+        if (self.spillHandle == nil) {
+            [self removeSpillFile];
+            return NO;
+        }
+    }
+
+    @try {
+        [self.spillHandle seekToFileOffset:self.spillWriteOffset];
+        [self.spillHandle writeData:data];
+    }
+    @catch (NSException *exception) {
+        NSLog(@"Unable to spill audio to disk: %@", [exception reason]);
+        return NO;
+    }
+    self.spillWriteOffset += [data length];
+    return YES;
+}
+
+- (NSData*) readSpilled:(NSUInteger) maxLength {
+    unsigned long long pending = self.spillWriteOffset - self.spillReadOffset;
+    NSUInteger length = (NSUInteger)MIN((unsigned long long)maxLength, pending);
+    NSData *data = nil;
+
+    @try {
+        [self.spillHandle seekToFileOffset:self.spillReadOffset];
+        data = [self.spillHandle readDataOfLength:length];
+    }
+    @catch (NSException *exception) {
+        NSLog(@"Unable to read spilled audio: %@", [exception reason]);
+    }
+
+    if ([data length] == 0) {
+        // the file is unreadable, account for what it held as dropped
+        self.dropped += (NSUInteger)pending;
+        [self removeSpillFile];
+        return nil;
+    }
+
+    self.spillReadOffset += [data length];
+    if (self.spillReadOffset == self.spillWriteOffset) {
+        // caught up with the writer, reuse the file from the start
+        self.spillReadOffset = self.spillWriteOffset = 0;
+        [self.spillHandle truncateFileAtOffset:0];
+    }
+    return data;
+}
+
+- (void) removeSpillFile {
+    if (self.spillPath == nil) {
+        return;
+    }
+    [self.spillHandle closeFile];
+    [[NSFileManager defaultManager] removeItemAtPath:self.spillPath error:nil];
+    self.spillHandle = nil;
+    self.spillPath = nil;
+    self.spillReadOffset = self.spillWriteOffset = 0;
+}
+
+@end
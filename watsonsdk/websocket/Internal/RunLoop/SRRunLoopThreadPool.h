@@ -0,0 +1,38 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "SRWebSocket.h"
+#import "SRRunLoopThread.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Shards sockets over a set of network threads. Thread 0 is +[SRRunLoopThread sharedThread],
+// the others are started the first time a socket is assigned to them. Thread-safe.
+@interface SRRunLoopThreadPool : NSObject
+
++ (instancetype)sharedPool;
+
+// Threads new sockets are spread over. Lowering it stops assigning to the extra threads, it doesn't stop them.
+@property (nonatomic, assign) NSUInteger threadCount;
+@property (nonatomic, assign) SRNetworkThreadAssignment assignment;
+
+// Picks a thread for `object` according to `assignment` and counts it against that thread's load.
+- (SRRunLoopThread *)acquireThreadForObject:(id)object;
+
+// Pins to thread `index`, modulo the thread count, and counts it against that thread's load.
+- (SRRunLoopThread *)acquireThreadAtIndex:(NSUInteger)index;
+
+// Balances an acquire once the socket no longer uses the thread.
+- (void)relinquishThread:(SRRunLoopThread *)thread;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,134 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import "SRRunLoopThreadPool.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@implementation SRRunLoopThreadPool {
+    NSMutableArray<SRRunLoopThread *> *_threads;
+    NSCountedSet<SRRunLoopThread *> *_loads;
+    NSUInteger _threadCount;
+    SRNetworkThreadAssignment _assignment;
+}
+
++ (instancetype)sharedPool
+{
+    static SRRunLoopThreadPool *pool;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        pool = [[SRRunLoopThreadPool alloc] init];
+    });
+    return pool;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _threads = [NSMutableArray arrayWithObject:[SRRunLoopThread sharedThread]];
+        _loads = [[NSCountedSet alloc] init];
+        _threadCount = 1;
+        _assignment = SRNetworkThreadAssignmentHash;
+    }
+    return self;
+}
+
+- (NSUInteger)threadCount
+{
+    @synchronized(self) {
+        return _threadCount;
+    }
+}
+
+- (void)setThreadCount:(NSUInteger)threadCount
+{
+    @synchronized(self) {
+        _threadCount = MAX(threadCount, 1);
+    }
+}
+
+- (SRNetworkThreadAssignment)assignment
+{
+    @synchronized(self) {
+        return _assignment;
+    }
+}
+
+- (void)setAssignment:(SRNetworkThreadAssignment)assignment
+{
+    @synchronized(self) {
+        _assignment = assignment;
+    }
+}
+
+// Must be called while synchronized on self.
+- (SRRunLoopThread *)_threadAtIndex:(NSUInteger)index
+{
+    while (_threads.count <= index) {
+        SRRunLoopThread *thread = [[SRRunLoopThread alloc] init];
+        thread.name = [NSString stringWithFormat:@"com.facebook.SocketRocket.NetworkThread.%lu", (unsigned long)_threads.count];
+        [thread start];
+        [_threads addObject:thread];
+    }
+    return _threads[index];
+}
+
+static NSUInteger SRRunLoopThreadIndexForHash(NSUInteger hash, NSUInteger count)
+{
+    // Object hashes are usually aligned pointers, mix the high bits down before taking the modulo.
+    uint64_t mixed = hash;
+    mixed ^= mixed >> 33;
+    mixed *= 0xff51afd7ed558ccdULL;
+    mixed ^= mixed >> 33;
+    return (NSUInteger)(mixed % count);
+}
+
+- (SRRunLoopThread *)acquireThreadForObject:(id)object
+{
+    @synchronized(self) {
+        NSUInteger index = 0;
+        if (_assignment == SRNetworkThreadAssignmentLeastLoaded) {
+            NSUInteger lowestLoad = NSUIntegerMax;
+            for (NSUInteger i = 0; i < _threadCount; i++) {
+                NSUInteger load = i < _threads.count ? [_loads countForObject:_threads[i]] : 0;
+                if (load < lowestLoad) {
+                    lowestLoad = load;
+                    index = i;
+                }
+            }
+        } else {
+            index = SRRunLoopThreadIndexForHash([object hash], _threadCount);
+        }
+
+        SRRunLoopThread *thread = [self _threadAtIndex:index];
+        [_loads addObject:thread];
+        return thread;
+    }
+}
+
+- (SRRunLoopThread *)acquireThreadAtIndex:(NSUInteger)index
+{
+    @synchronized(self) {
+        SRRunLoopThread *thread = [self _threadAtIndex:index % _threadCount];
+        [_loads addObject:thread];
+        return thread;
+    }
+}
+
+- (void)relinquishThread:(SRRunLoopThread *)thread
+{
+    @synchronized(self) {
+        [_loads removeObject:thread];
+    }
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,28 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Reusable storage for outgoing frames. Buffers are handed out as `dispatch_data_t` whose destructor
+// returns the storage to the pool, so it is safe to use from any queue.
+@interface SRFrameBufferPool : NSObject
+
+- (instancetype)initWithBufferCapacity:(NSUInteger)poolSize maximumRetainedLength:(NSUInteger)maximumRetainedLength;
+
+/**
+ Calls `fill` with at least `length` writable bytes and returns them wrapped as dispatch data of exactly `length` bytes.
+ The storage goes back to the pool once the returned data is released. Returns `nil` if the buffer can't be allocated.
+ */
+- (nullable dispatch_data_t)dataWithLength:(size_t)length fill:(void (^)(uint8_t *bytes))fill;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,87 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import "SRFrameBufferPool.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@implementation SRFrameBufferPool {
+    NSUInteger _poolSize;
+    NSUInteger _maximumRetainedLength;
+    NSMutableArray<NSMutableData *> *_buffers;
+}
+
+- (instancetype)initWithBufferCapacity:(NSUInteger)poolSize maximumRetainedLength:(NSUInteger)maximumRetainedLength
+{
+    self = [super init];
+    if (self) {
+        _poolSize = poolSize;
+        _maximumRetainedLength = maximumRetainedLength;
+        _buffers = [NSMutableArray arrayWithCapacity:poolSize];
+    }
+    return self;
+}
+
+- (instancetype)init
+{
+    return [self initWithBufferCapacity:4 maximumRetainedLength:1024 * 1024];
+}
+
+- (nullable NSMutableData *)_bufferWithLength:(size_t)length
+{
+    @synchronized(self) {
+        // Smallest pooled buffer that fits, so big buffers stay available for big frames.
+        NSUInteger bestIndex = NSNotFound;
+        for (NSUInteger i = 0; i < _buffers.count; i++) {
+            NSUInteger bufferLength = _buffers[i].length;
+            if (bufferLength >= length && (bestIndex == NSNotFound || bufferLength < _buffers[bestIndex].length)) {
+                bestIndex = i;
+            }
+        }
+        if (bestIndex != NSNotFound) {
+            NSMutableData *buffer = _buffers[bestIndex];
+            [_buffers removeObjectAtIndex:bestIndex];
+            return buffer;
+        }
+    }
+    return [[NSMutableData alloc] initWithLength:length];
+}
+
+- (void)_returnBuffer:(NSMutableData *)buffer
+{
+    if (buffer.length > _maximumRetainedLength) {
+        return;
+    }
+    @synchronized(self) {
+        if (_buffers.count < _poolSize) {
+            [_buffers addObject:buffer];
+        }
+    }
+}
+
+- (nullable dispatch_data_t)dataWithLength:(size_t)length fill:(void (^)(uint8_t *bytes))fill
+{
+    if (length == 0) {
+        return dispatch_data_empty;
+    }
+
+    NSMutableData *buffer = [self _bufferWithLength:length];
+    if (!buffer) {
+        return nil;
+    }
+    fill(buffer.mutableBytes);
+
+    return dispatch_data_create(buffer.bytes, length, nil, ^{
+        [self _returnBuffer:buffer];
+    });
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
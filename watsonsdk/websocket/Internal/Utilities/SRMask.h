@@ -0,0 +1,22 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ XORs `length` bytes of `source` into `destination` with the 4 byte frame mask key, starting at
+ `keyOffset` into the key. Masking and unmasking are the same operation. `destination` may be `source`.
+
+ @return The key offset following the last byte, to continue a payload split across reads.
+ */
+extern size_t SRMaskBytes(uint8_t *destination, const uint8_t *source, size_t length, const uint8_t maskKey[_Nonnull 4], size_t keyOffset);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,95 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import "SRMask.h"
+
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SR_MASK_AVX2 1
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SR_MASK_SSE2 1
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SR_MASK_NEON 1
+#endif
+
+NS_ASSUME_NONNULL_BEGIN
+
+size_t SRMaskBytes(uint8_t *destination, const uint8_t *source, size_t length, const uint8_t maskKey[_Nonnull 4], size_t keyOffset)
+{
+    // Too short for a single word, building the pattern would cost more than the bytes.
+    if (length < sizeof(uint64_t)) {
+        for (size_t i = 0; i < length; i++) {
+            destination[i] = source[i] ^ maskKey[(keyOffset + i) % 4];
+        }
+        return keyOffset + length;
+    }
+
+    // Rotate the key so byte 0 of the pattern lines up with the first byte we process,
+    // from then on every block is a multiple of 4 bytes and uses the same pattern.
+    uint8_t pattern[32];
+    for (size_t i = 0; i < 4; i++) {
+        pattern[i] = maskKey[(keyOffset + i) % 4];
+    }
+    memcpy(pattern + 4, pattern, 4);
+    memcpy(pattern + 8, pattern, 8);
+    memcpy(pattern + 16, pattern, 16);
+
+    size_t i = 0;
+
+#if defined(SR_MASK_AVX2)
+    const __m256i wideMask = _mm256_loadu_si256((const __m256i *)pattern);
+    for (; i + 32 <= length; i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(source + i));
+        _mm256_storeu_si256((__m256i *)(destination + i), _mm256_xor_si256(block, wideMask));
+    }
+#endif
+
+#if defined(SR_MASK_SSE2)
+    const __m128i mask = _mm_loadu_si128((const __m128i *)pattern);
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(source + i));
+        _mm_storeu_si128((__m128i *)(destination + i), _mm_xor_si128(block, mask));
+    }
+#elif defined(SR_MASK_NEON)
+    const uint8x16_t mask = vld1q_u8(pattern);
+    for (; i + 32 <= length; i += 32) {
+        uint8x16_t first = vld1q_u8(source + i);
+        uint8x16_t second = vld1q_u8(source + i + 16);
+        vst1q_u8(destination + i, veorq_u8(first, mask));
+        vst1q_u8(destination + i + 16, veorq_u8(second, mask));
+    }
+    for (; i + 16 <= length; i += 16) {
+        vst1q_u8(destination + i, veorq_u8(vld1q_u8(source + i), mask));
+    }
+#endif
+
+    // Word-wide for whatever the vector loops left, or everything without SIMD.
+    uint64_t word;
+    memcpy(&word, pattern, sizeof(word));
+    for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+        uint64_t block;
+        memcpy(&block, source + i, sizeof(block));
+        block ^= word;
+        memcpy(destination + i, &block, sizeof(block));
+    }
+
+    for (; i < length; i++) {
+        destination[i] = source[i] ^ pattern[i % 4];
+    }
+
+    return keyOffset + length;
+}
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,58 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+extern NSString *const SRPerMessageDeflateExtensionName;
+
+// permessage-deflate (RFC 7692) negotiation and message codec.
+// Not thread-safe: compression and decompression contexts carry state across messages,
+// so messages have to go through in the order they are sent or received.
+@interface SRPerMessageDeflate : NSObject
+
+/**
+ @param clientMaxWindowBits LZ77 window used to compress outgoing messages, 9...15.
+ @param serverMaxWindowBits Largest window the server may compress with, 8...15. 15 doesn't restrict the server.
+ */
+- (instancetype)initWithClientMaxWindowBits:(NSInteger)clientMaxWindowBits
+                        serverMaxWindowBits:(NSInteger)serverMaxWindowBits
+                    clientNoContextTakeover:(BOOL)clientNoContextTakeover
+                    serverNoContextTakeover:(BOOL)serverNoContextTakeover NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/**
+ @return The extension offer for the `Sec-WebSocket-Extensions` request header.
+ */
+- (NSString *)offer;
+
+/**
+ Applies the parameters the server accepted.
+
+ @param response Value of the `Sec-WebSocket-Extensions` response header.
+
+ @return `NO` if the response isn't a valid answer to `offer`, in which case the connection must fail.
+ */
+- (BOOL)acceptResponse:(NSString *)response;
+
+/**
+ @return The compressed payload to send with RSV1 set, or `nil` if zlib failed.
+ */
+- (nullable NSData *)compressMessage:(NSData *)message;
+
+/**
+ @return The decompressed payload of a message received with RSV1 set, or `nil` if it isn't valid deflate data.
+ */
+- (nullable NSData *)decompressMessage:(NSData *)message;
+
+@end
+
+NS_ASSUME_NONNULL_END
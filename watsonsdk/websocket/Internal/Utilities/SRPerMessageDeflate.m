@@ -0,0 +1,245 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import "SRPerMessageDeflate.h"
+
+#import <zlib.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+NSString *const SRPerMessageDeflateExtensionName = @"permessage-deflate";
+
+// Every message ends in an empty stored block after a sync flush. It's dropped on the wire (RFC 7692 7.2.1).
+static const uint8_t SRDeflateMessageTail[4] = {0x00, 0x00, 0xff, 0xff};
+
+static const NSUInteger SRInflateChunkSize = 16 * 1024;
+
+@implementation SRPerMessageDeflate {
+    NSInteger _clientMaxWindowBits;
+    NSInteger _serverMaxWindowBits;
+    BOOL _clientNoContextTakeover;
+    BOOL _serverNoContextTakeover;
+
+    z_stream _deflater;
+    z_stream _inflater;
+    BOOL _deflaterInitialized;
+    BOOL _inflaterInitialized;
+}
+
+- (instancetype)initWithClientMaxWindowBits:(NSInteger)clientMaxWindowBits
+                        serverMaxWindowBits:(NSInteger)serverMaxWindowBits
+                    clientNoContextTakeover:(BOOL)clientNoContextTakeover
+                    serverNoContextTakeover:(BOOL)serverNoContextTakeover
+{
+    self = [super init];
+    if (self) {
+        // zlib can't produce raw deflate with an 8 bit window.
+        _clientMaxWindowBits = MIN(MAX(clientMaxWindowBits, 9), 15);
+        _serverMaxWindowBits = MIN(MAX(serverMaxWindowBits, 8), 15);
+        _clientNoContextTakeover = clientNoContextTakeover;
+        _serverNoContextTakeover = serverNoContextTakeover;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_deflaterInitialized) {
+        deflateEnd(&_deflater);
+    }
+    if (_inflaterInitialized) {
+        inflateEnd(&_inflater);
+    }
+}
+
+#pragma mark - Negotiation
+
+- (NSString *)offer
+{
+    NSMutableString *offer = [SRPerMessageDeflateExtensionName mutableCopy];
+    if (_clientNoContextTakeover) {
+        [offer appendString:@"; client_no_context_takeover"];
+    }
+    if (_serverNoContextTakeover) {
+        [offer appendString:@"; server_no_context_takeover"];
+    }
+    if (_serverMaxWindowBits < 15) {
+        [offer appendFormat:@"; server_max_window_bits=%ld", (long)_serverMaxWindowBits];
+    }
+    // Without a value this only tells the server it may limit our window.
+    if (_clientMaxWindowBits < 15) {
+        [offer appendFormat:@"; client_max_window_bits=%ld", (long)_clientMaxWindowBits];
+    } else {
+        [offer appendString:@"; client_max_window_bits"];
+    }
+    return offer;
+}
+
+static BOOL SRParseWindowBits(NSString *value, NSInteger minimum, NSInteger *bits)
+{
+    NSScanner *scanner = [NSScanner scannerWithString:value];
+    NSInteger parsed = 0;
+    if (![scanner scanInteger:&parsed] || !scanner.isAtEnd || parsed < minimum || parsed > 15) {
+        return NO;
+    }
+    *bits = parsed;
+    return YES;
+}
+
+- (BOOL)acceptResponse:(NSString *)response
+{
+    NSCharacterSet *whitespace = [NSCharacterSet whitespaceCharacterSet];
+
+    // We only offer one extension, so the server can only have accepted this one.
+    NSArray<NSString *> *extensions = [response componentsSeparatedByString:@","];
+    if (extensions.count != 1) {
+        return NO;
+    }
+
+    NSArray<NSString *> *parameters = [extensions.firstObject componentsSeparatedByString:@";"];
+    if (![[parameters.firstObject stringByTrimmingCharactersInSet:whitespace] isEqualToString:SRPerMessageDeflateExtensionName]) {
+        return NO;
+    }
+
+    NSMutableSet<NSString *> *seen = [NSMutableSet set];
+    for (NSUInteger i = 1; i < parameters.count; i++) {
+        NSArray<NSString *> *pair = [parameters[i] componentsSeparatedByString:@"="];
+        NSString *name = [pair.firstObject stringByTrimmingCharactersInSet:whitespace];
+        NSString *value = pair.count > 1 ? [[pair[1] stringByTrimmingCharactersInSet:whitespace] stringByTrimmingCharactersInSet:[NSCharacterSet characterSetWithCharactersInString:@"\""]] : nil;
+
+        if (pair.count > 2 || [seen containsObject:name]) {
+            return NO;
+        }
+        [seen addObject:name];
+
+        if ([name isEqualToString:@"server_no_context_takeover"] && !value) {
+            _serverNoContextTakeover = YES;
+        } else if ([name isEqualToString:@"client_no_context_takeover"] && !value) {
+            _clientNoContextTakeover = YES;
+        } else if ([name isEqualToString:@"server_max_window_bits"] && value) {
+            NSInteger bits = 0;
+            if (!SRParseWindowBits(value, 8, &bits) || bits > _serverMaxWindowBits) {
+                return NO;
+            }
+            _serverMaxWindowBits = bits;
+        } else if ([name isEqualToString:@"client_max_window_bits"] && value) {
+            // zlib can't deflate within an 8 bit window and using 9 would exceed the server's limit,
+            // so that answer fails the negotiation (RFC 7692 7.1.2.2).
+            NSInteger bits = 0;
+            if (!SRParseWindowBits(value, 9, &bits) || bits > _clientMaxWindowBits) {
+                return NO;
+            }
+            _clientMaxWindowBits = bits;
+        } else {
+            return NO;
+        }
+    }
+
+    _deflaterInitialized = (deflateInit2(&_deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -(int)_clientMaxWindowBits, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+    _inflaterInitialized = (inflateInit2(&_inflater, -(int)_serverMaxWindowBits) == Z_OK);
+    return _deflaterInitialized && _inflaterInitialized;
+}
+
+#pragma mark - Codec
+
+- (nullable NSData *)compressMessage:(NSData *)message
+{
+    if (!_deflaterInitialized || message.length > UINT_MAX) {
+        return nil;
+    }
+
+    NSMutableData *output = [[NSMutableData alloc] initWithLength:deflateBound(&_deflater, (uLong)message.length) + sizeof(SRDeflateMessageTail)];
+    size_t written = 0;
+
+    _deflater.next_in = (Bytef *)message.bytes;
+    _deflater.avail_in = (uInt)message.length;
+    do {
+        if (written == output.length) {
+            output.length *= 2;
+        }
+        _deflater.next_out = (Bytef *)output.mutableBytes + written;
+        _deflater.avail_out = (uInt)(output.length - written);
+
+        int status = deflate(&_deflater, Z_SYNC_FLUSH);
+        if (status != Z_OK && status != Z_BUF_ERROR) {
+            return nil;
+        }
+        written = output.length - _deflater.avail_out;
+    } while (_deflater.avail_out == 0);
+
+    if (written >= sizeof(SRDeflateMessageTail) &&
+        memcmp((uint8_t *)output.bytes + written - sizeof(SRDeflateMessageTail), SRDeflateMessageTail, sizeof(SRDeflateMessageTail)) == 0) {
+        written -= sizeof(SRDeflateMessageTail);
+    }
+    if (written == 0) {
+        // An empty message is sent as a single empty final block header (RFC 7692 7.2.3.6).
+        ((uint8_t *)output.mutableBytes)[0] = 0x00;
+        written = 1;
+    }
+    output.length = written;
+
+    if (_clientNoContextTakeover) {
+        deflateReset(&_deflater);
+    }
+    return output;
+}
+
+- (BOOL)_inflateBytes:(const uint8_t *)bytes length:(size_t)length into:(NSMutableData *)output written:(size_t *)written
+{
+    _inflater.next_in = (Bytef *)bytes;
+    _inflater.avail_in = (uInt)length;
+
+    // A full output buffer may leave more pending inside zlib, so keep going until it isn't full.
+    do {
+        if (*written == output.length) {
+            output.length += MAX(output.length, SRInflateChunkSize);
+        }
+        _inflater.next_out = (Bytef *)output.mutableBytes + *written;
+        _inflater.avail_out = (uInt)(output.length - *written);
+
+        int status = inflate(&_inflater, Z_SYNC_FLUSH);
+        *written = output.length - _inflater.avail_out;
+
+        if (status == Z_STREAM_END) {
+            // The server closed the deflate stream with a final block; the next message starts a new one.
+            inflateReset(&_inflater);
+            return _inflater.avail_in == 0 || [self _inflateBytes:_inflater.next_in length:_inflater.avail_in into:output written:written];
+        }
+        if (status != Z_OK && status != Z_BUF_ERROR) {
+            return NO;
+        }
+    } while (_inflater.avail_in > 0 || _inflater.avail_out == 0);
+    return YES;
+}
+
+- (nullable NSData *)decompressMessage:(NSData *)message
+{
+    if (!_inflaterInitialized || message.length > UINT_MAX) {
+        return nil;
+    }
+
+    NSMutableData *output = [[NSMutableData alloc] initWithLength:MAX(message.length * 4, SRInflateChunkSize)];
+    size_t written = 0;
+
+    if (![self _inflateBytes:message.bytes length:message.length into:output written:&written] ||
+        ![self _inflateBytes:SRDeflateMessageTail length:sizeof(SRDeflateMessageTail) into:output written:&written]) {
+        inflateReset(&_inflater);
+        return nil;
+    }
+    output.length = written;
+
+    if (_serverNoContextTakeover) {
+        inflateReset(&_inflater);
+    }
+    return output;
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
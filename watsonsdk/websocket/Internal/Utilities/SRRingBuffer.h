@@ -0,0 +1,64 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import <Foundation/Foundation.h>
+
+#include <sys/uio.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Contiguous byte ring with a power-of-two capacity. Readable and writable regions are exposed as at most
+ two `iovec` spans (readv/writev style), so bytes are moved in and out without intermediate buffers.
+ Not thread-safe.
+ */
+typedef struct {
+    uint8_t *_Nullable bytes;
+    size_t capacity;
+    size_t head; // Read position, masked by capacity - 1 on access.
+    size_t tail; // Write position, masked by capacity - 1 on access.
+} SRRingBuffer;
+
+extern BOOL SRRingBufferInit(SRRingBuffer *ring, size_t capacity);
+extern void SRRingBufferDestroy(SRRingBuffer *ring);
+extern void SRRingBufferClear(SRRingBuffer *ring);
+
+static inline size_t SRRingBufferReadableLength(const SRRingBuffer *ring)
+{
+    return ring->tail - ring->head;
+}
+
+/**
+ Grows the ring, keeping its contents, until at least `length` bytes are writable.
+
+ @return `NO` if the memory couldn't be allocated.
+ */
+extern BOOL SRRingBufferReserve(SRRingBuffer *ring, size_t length);
+
+/**
+ @return The number of spans (0-2) filled in with the readable bytes, oldest first.
+ */
+extern NSUInteger SRRingBufferReadableSpans(const SRRingBuffer *ring, struct iovec spans[_Nonnull 2]);
+
+/**
+ @return The number of spans (0-2) filled in with the free space, in write order.
+ */
+extern NSUInteger SRRingBufferWritableSpans(const SRRingBuffer *ring, struct iovec spans[_Nonnull 2]);
+
+extern void SRRingBufferDidWrite(SRRingBuffer *ring, size_t length);
+extern void SRRingBufferDidRead(SRRingBuffer *ring, size_t length);
+
+/**
+ Makes the first `length` readable bytes contiguous, moving them only if they wrap around the end.
+
+ @return Pointer to the first readable byte, or `NULL` if the memory couldn't be allocated.
+ */
+extern const uint8_t *_Nullable SRRingBufferLinearize(SRRingBuffer *ring, size_t length);
+
+NS_ASSUME_NONNULL_END
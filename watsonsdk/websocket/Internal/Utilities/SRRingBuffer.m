@@ -0,0 +1,150 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import "SRRingBuffer.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+static size_t SRRingBufferRoundUpCapacity(size_t length)
+{
+    size_t capacity = 1;
+    while (capacity < length) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+BOOL SRRingBufferInit(SRRingBuffer *ring, size_t capacity)
+{
+    ring->capacity = SRRingBufferRoundUpCapacity(MAX(capacity, 1));
+    ring->bytes = malloc(ring->capacity);
+    ring->head = 0;
+    ring->tail = 0;
+    return ring->bytes != NULL;
+}
+
+void SRRingBufferDestroy(SRRingBuffer *ring)
+{
+    free(ring->bytes);
+    ring->bytes = NULL;
+    ring->capacity = 0;
+    ring->head = 0;
+    ring->tail = 0;
+}
+
+void SRRingBufferClear(SRRingBuffer *ring)
+{
+    ring->head = 0;
+    ring->tail = 0;
+}
+
+// Copies the readable bytes to the start of a new allocation of `capacity` bytes.
+static BOOL SRRingBufferReallocate(SRRingBuffer *ring, size_t capacity)
+{
+    uint8_t *bytes = malloc(capacity);
+    if (!bytes) {
+        return NO;
+    }
+
+    struct iovec spans[2];
+    NSUInteger count = SRRingBufferReadableSpans(ring, spans);
+    size_t length = 0;
+    for (NSUInteger i = 0; i < count; i++) {
+        memcpy(bytes + length, spans[i].iov_base, spans[i].iov_len);
+        length += spans[i].iov_len;
+    }
+
+    free(ring->bytes);
+    ring->bytes = bytes;
+    ring->capacity = capacity;
+    ring->head = 0;
+    ring->tail = length;
+    return YES;
+}
+
+BOOL SRRingBufferReserve(SRRingBuffer *ring, size_t length)
+{
+    size_t readable = SRRingBufferReadableLength(ring);
+    if (ring->capacity - readable >= length) {
+        return YES;
+    }
+    return SRRingBufferReallocate(ring, SRRingBufferRoundUpCapacity(readable + length));
+}
+
+NSUInteger SRRingBufferReadableSpans(const SRRingBuffer *ring, struct iovec spans[_Nonnull 2])
+{
+    size_t readable = SRRingBufferReadableLength(ring);
+    if (readable == 0) {
+        return 0;
+    }
+
+    size_t start = ring->head & (ring->capacity - 1);
+    size_t first = MIN(readable, ring->capacity - start);
+    spans[0].iov_base = ring->bytes + start;
+    spans[0].iov_len = first;
+    if (first == readable) {
+        return 1;
+    }
+    spans[1].iov_base = ring->bytes;
+    spans[1].iov_len = readable - first;
+    return 2;
+}
+
+NSUInteger SRRingBufferWritableSpans(const SRRingBuffer *ring, struct iovec spans[_Nonnull 2])
+{
+    size_t writable = ring->capacity - SRRingBufferReadableLength(ring);
+    if (writable == 0) {
+        return 0;
+    }
+
+    size_t start = ring->tail & (ring->capacity - 1);
+    size_t first = MIN(writable, ring->capacity - start);
+    spans[0].iov_base = ring->bytes + start;
+    spans[0].iov_len = first;
+    if (first == writable) {
+        return 1;
+    }
+    spans[1].iov_base = ring->bytes;
+    spans[1].iov_len = writable - first;
+    return 2;
+}
+
+void SRRingBufferDidWrite(SRRingBuffer *ring, size_t length)
+{
+    assert(length <= ring->capacity - SRRingBufferReadableLength(ring));
+    ring->tail += length;
+}
+
+void SRRingBufferDidRead(SRRingBuffer *ring, size_t length)
+{
+    assert(length <= SRRingBufferReadableLength(ring));
+    ring->head += length;
+    if (ring->head == ring->tail) {
+        // Start over at the front while empty, so the next bytes don't wrap.
+        ring->head = 0;
+        ring->tail = 0;
+    }
+}
+
+const uint8_t *_Nullable SRRingBufferLinearize(SRRingBuffer *ring, size_t length)
+{
+    assert(length <= SRRingBufferReadableLength(ring));
+
+    size_t start = ring->head & (ring->capacity - 1);
+    if (start + length > ring->capacity && !SRRingBufferReallocate(ring, ring->capacity)) {
+        return NULL;
+    }
+    return ring->bytes + (ring->head & (ring->capacity - 1));
+}
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,36 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Incremental UTF-8 validation state. A code point may be split across calls to `SRUTF8ValidatorConsume`.
+ Zero-initialised state (or `SRUTF8ValidatorReset`) is the start of a message.
+ */
+typedef struct {
+    uint8_t state;
+} SRUTF8Validator;
+
+extern void SRUTF8ValidatorReset(SRUTF8Validator *validator);
+
+/**
+ Validates `length` more bytes of the message.
+
+ @return `NO` as soon as the bytes seen so far can't be the prefix of valid UTF-8. The validator stays failed until reset.
+ */
+extern BOOL SRUTF8ValidatorConsume(SRUTF8Validator *validator, const uint8_t *bytes, size_t length);
+
+/**
+ @return `YES` if everything consumed so far is valid UTF-8 that doesn't end inside a code point.
+ */
+extern BOOL SRUTF8ValidatorIsComplete(const SRUTF8Validator *validator);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,142 @@
+//
+// Copyright (c) 2016-present, Facebook, Inc.
+// All rights reserved.
+//
+// This source code is licensed under the BSD-style license found in the
+// LICENSE file in the root directory of this source tree. An additional grant
+// of patent rights can be found in the PATENTS file in the same directory.
+//
+
+#import "SRUTF8Validator.h"
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SR_UTF8_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define SR_UTF8_NEON 1
+#endif
+
+NS_ASSUME_NONNULL_BEGIN
+
+// States follow the well-formed byte sequences table (Unicode 3.9, table 3-7).
+// The restricted second bytes after E0, ED, F0 and F4 get their own states so
+// overlong forms, surrogates and code points above U+10FFFF are rejected.
+enum {
+    SRUTF8StateAccept = 0,
+    SRUTF8StateTrail1,      // 1 more 80..BF
+    SRUTF8StateTrail2,      // 2 more 80..BF
+    SRUTF8StateTrail3,      // 3 more 80..BF
+    SRUTF8StateAfterE0,     // A0..BF, then 1 more
+    SRUTF8StateAfterED,     // 80..9F, then 1 more
+    SRUTF8StateAfterF0,     // 90..BF, then 2 more
+    SRUTF8StateAfterF4,     // 80..8F, then 2 more
+    SRUTF8StateReject,
+};
+
+static inline uint8_t SRUTF8Step(uint8_t state, uint8_t byte)
+{
+    switch (state) {
+        case SRUTF8StateAccept:
+            if (byte < 0x80) {
+                return SRUTF8StateAccept;
+            } else if (byte >= 0xC2 && byte <= 0xDF) {
+                return SRUTF8StateTrail1;
+            } else if (byte == 0xE0) {
+                return SRUTF8StateAfterE0;
+            } else if (byte == 0xED) {
+                return SRUTF8StateAfterED;
+            } else if (byte >= 0xE1 && byte <= 0xEF) {
+                return SRUTF8StateTrail2;
+            } else if (byte == 0xF0) {
+                return SRUTF8StateAfterF0;
+            } else if (byte >= 0xF1 && byte <= 0xF3) {
+                return SRUTF8StateTrail3;
+            } else if (byte == 0xF4) {
+                return SRUTF8StateAfterF4;
+            }
+            return SRUTF8StateReject;
+        case SRUTF8StateTrail1:
+        case SRUTF8StateTrail2:
+        case SRUTF8StateTrail3:
+            return (byte >= 0x80 && byte <= 0xBF) ? state - 1 : SRUTF8StateReject;
+        case SRUTF8StateAfterE0:
+            return (byte >= 0xA0 && byte <= 0xBF) ? SRUTF8StateTrail1 : SRUTF8StateReject;
+        case SRUTF8StateAfterED:
+            return (byte >= 0x80 && byte <= 0x9F) ? SRUTF8StateTrail1 : SRUTF8StateReject;
+        case SRUTF8StateAfterF0:
+            return (byte >= 0x90 && byte <= 0xBF) ? SRUTF8StateTrail2 : SRUTF8StateReject;
+        case SRUTF8StateAfterF4:
+            return (byte >= 0x80 && byte <= 0x8F) ? SRUTF8StateTrail2 : SRUTF8StateReject;
+        default:
+            return SRUTF8StateReject;
+    }
+}
+
+// Length of the leading run of ASCII bytes, checked a block at a time.
+static inline size_t SRUTF8ASCIIPrefixLength(const uint8_t *bytes, size_t length)
+{
+    size_t i = 0;
+
+#if defined(SR_UTF8_SSE2)
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(bytes + i));
+        if (_mm_movemask_epi8(block) != 0) {
+            break;
+        }
+    }
+#elif defined(SR_UTF8_NEON)
+    for (; i + 16 <= length; i += 16) {
+        if (vmaxvq_u8(vld1q_u8(bytes + i)) >= 0x80) {
+            break;
+        }
+    }
+#endif
+
+    for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        if (word & 0x8080808080808080ULL) {
+            break;
+        }
+    }
+
+    while (i < length && bytes[i] < 0x80) {
+        i++;
+    }
+    return i;
+}
+
+void SRUTF8ValidatorReset(SRUTF8Validator *validator)
+{
+    validator->state = SRUTF8StateAccept;
+}
+
+BOOL SRUTF8ValidatorConsume(SRUTF8Validator *validator, const uint8_t *bytes, size_t length)
+{
+    uint8_t state = validator->state;
+    size_t i = 0;
+
+    while (i < length && state != SRUTF8StateReject) {
+        if (state == SRUTF8StateAccept) {
+            i += SRUTF8ASCIIPrefixLength(bytes + i, length - i);
+            if (i == length) {
+                break;
+            }
+        }
+        state = SRUTF8Step(state, bytes[i]);
+        i++;
+    }
+
+    validator->state = state;
+    return state != SRUTF8StateReject;
+}
+
+BOOL SRUTF8ValidatorIsComplete(const SRUTF8Validator *validator)
+{
+    return validator->state == SRUTF8StateAccept;
+}
+
+NS_ASSUME_NONNULL_END
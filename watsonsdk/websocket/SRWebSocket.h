@@ -43,6 +43,16 @@ typedef enum SRStatusCode : NSInteger {
     // 4000–4999: Available for use by applications.
 } SRStatusCode;
 
+typedef NS_ENUM(NSInteger, SRNetworkThreadAssignment) {
+    // Spread sockets by a hash of the socket, no coordination between them.
+    SRNetworkThreadAssignmentHash = 0,
+    // Put each new socket on the network thread with the fewest open sockets.
+    SRNetworkThreadAssignmentLeastLoaded = 1,
+};
+
+// Value of `networkThreadIndex` that lets the thread pool pick.
+static const NSInteger SRNetworkThreadIndexAutomatic = -1;
+
 @class SRWebSocket;
 
 extern NSString *const SRWebSocketErrorDomain;
@@ -89,6 +99,21 @@ extern NSString *const SRHTTPResponseErrorKey;
 // It will be nil until after the handshake completes.
 @property (nonatomic, readonly, copy) NSString *protocol;
 
+// Offer permessage-deflate (RFC 7692) in the opening handshake. Set before calling `open`, defaults to NO.
+// When negotiated, text messages are sent compressed and compressed messages from the server are inflated.
+@property (nonatomic, assign) BOOL perMessageDeflateEnabled;
+
+// LZ77 window sizes (log2) for outgoing (9-15) and incoming (8-15) messages. Both default to 15.
+@property (nonatomic, assign) NSInteger perMessageDeflateClientMaxWindowBits;
+@property (nonatomic, assign) NSInteger perMessageDeflateServerMaxWindowBits;
+
+// Ask for the compression context to be reset after every message, trading ratio for memory.
+@property (nonatomic, assign) BOOL perMessageDeflateClientNoContextTakeover;
+@property (nonatomic, assign) BOOL perMessageDeflateServerNoContextTakeover;
+
+// YES once the server has accepted permessage-deflate.
+@property (nonatomic, readonly) BOOL perMessageDeflateNegotiated;
+
 // Protocols should be an array of strings that turn into Sec-WebSocket-Protocol.
 - (instancetype)initWithURLRequest:(NSURLRequest *)request;
 - (instancetype)initWithURLRequest:(NSURLRequest *)request protocols:(NSArray<NSString *> *)protocols;
@@ -99,7 +124,11 @@ extern NSString *const SRHTTPResponseErrorKey;
 - (instancetype)initWithURL:(NSURL *)url protocols:(NSArray<NSString *> *)protocols;
 - (instancetype)initWithURL:(NSURL *)url protocols:(NSArray<NSString *> *)protocols allowsUntrustedSSLCertificates:(BOOL)allowsUntrustedSSLCertificates;
 
-// By default, it will schedule itself on +[NSRunLoop SR_networkRunLoop] using defaultModes.
+// Network thread to schedule on when no run loop has been set with scheduleInRunLoop:forMode:,
+// modulo +[NSRunLoop SR_networkThreadCount]. Set before calling `open`. Defaults to SRNetworkThreadIndexAutomatic.
+@property (nonatomic, assign) NSInteger networkThreadIndex;
+
+// By default, it will schedule itself on one of the network threads (see +[NSRunLoop SR_setNetworkThreadCount:]) using defaultModes.
 - (void)scheduleInRunLoop:(NSRunLoop *)aRunLoop forMode:(NSString *)mode;
 - (void)unscheduleFromRunLoop:(NSRunLoop *)aRunLoop forMode:(NSString *)mode;
 
@@ -136,6 +165,15 @@ extern NSString *const SRHTTPResponseErrorKey;
  */
 - (void)sendData:(NSData *)data;
 
+/**
+ Send binary data to the server, and find out when it has been written to the network.
+
+ @param data Data to send.
+ @param completion Called on the socket's work queue once the frame has been written to the output stream,
+ or once the connection is over and it never will be. It must not block.
+ */
+- (void)sendData:(NSData *)data completion:(dispatch_block_t)completion;
+
 /**
  Send Ping message to the server with optional data.
 
@@ -189,4 +227,12 @@ extern NSString *const SRHTTPResponseErrorKey;
 
 + (NSRunLoop *)SR_networkRunLoop;
 
+// Number of network threads sockets are sharded over, defaults to 1. Affects sockets opened afterwards.
++ (NSUInteger)SR_networkThreadCount;
++ (void)SR_setNetworkThreadCount:(NSUInteger)count;
+
+// How sockets without a `networkThreadIndex` are assigned to network threads, defaults to SRNetworkThreadAssignmentHash.
++ (SRNetworkThreadAssignment)SR_networkThreadAssignment;
++ (void)SR_setNetworkThreadAssignment:(SRNetworkThreadAssignment)assignment;
+
 @end
@@ -11,14 +11,6 @@
 
 #import "SRWebSocket.h"
 
-#if TARGET_OS_IPHONE
-#define HAS_ICU
-#endif
-
-#ifdef HAS_ICU
-#import <unicode/utf8.h>
-#endif
-
 #if TARGET_OS_IPHONE
 #import <Endian.h>
 #else
@@ -31,7 +23,13 @@
 #import "SRIOConsumer.h"
 #import "SRIOConsumerPool.h"
 #import "SRHash.h"
+#import "SRMask.h"
+#import "SRFrameBufferPool.h"
+#import "SRUTF8Validator.h"
+#import "SRPerMessageDeflate.h"
+#import "SRRingBuffer.h"
 #import "SRRunLoopThread.h"
+#import "SRRunLoopThreadPool.h"
 #import "SRURLUtilities.h"
 #import "SRError.h"
 
@@ -51,7 +49,7 @@ typedef enum  {
 
 typedef struct {
     BOOL fin;
-//  BOOL rsv1;
+    BOOL rsv1;
 //  BOOL rsv2;
 //  BOOL rsv3;
     uint8_t opcode;
@@ -61,9 +59,11 @@ typedef struct {
 
 static NSString *const SRWebSocketAppendToSecKeyString = @"258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
 
-static inline int32_t validate_dispatch_data_partial_string(NSData *data);
 static inline void SRFastLog(NSString *format, ...);
 
+static const size_t SRReadBufferInitialCapacity = 4096;
+static const size_t SRReadChunkSize = 2048;
+
 NSString *const SRWebSocketErrorDomain = @"SRWebSocketErrorDomain";
 NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
 
@@ -91,16 +91,20 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
     NSInputStream *_inputStream;
     NSOutputStream *_outputStream;
    
-    dispatch_data_t _readBuffer;
-    NSUInteger _readBufferOffset;
- 
-    dispatch_data_t _outputBuffer;
-    NSUInteger _outputBufferOffset;
+    SRRingBuffer _readBuffer;
+
+    // Frames waiting to be written, oldest first. The offset is into the first one.
+    NSMutableArray<dispatch_data_t> *_outputBuffer;
+    size_t _outputBufferOffset;
+    // Bytes ever queued and written, and the sendData:completion: blocks waiting for a byte count to be written.
+    uint64_t _outputBytesQueued;
+    uint64_t _outputBytesWritten;
+    NSMutableArray<NSArray *> *_writeCompletions;
 
     uint8_t _currentFrameOpcode;
     size_t _currentFrameCount;
     size_t _readOpCount;
-    uint32_t _currentStringScanPosition;
+    SRUTF8Validator _currentFrameUTF8Validator;
     NSMutableData *_currentFrameData;
     
     NSString *_closeReason;
@@ -135,6 +139,14 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
     
     NSArray<NSString *> *_requestedProtocols;
     SRIOConsumerPool *_consumerPool;
+    SRFrameBufferPool *_frameBufferPool;
+
+    SRPerMessageDeflate *_perMessageDeflate;
+    BOOL _currentFrameCompressed;
+    NSUInteger _fastPathDepth;
+
+    // Thread from the pool the streams were scheduled on, if no run loop was given.
+    SRRunLoopThread *_networkThread;
 }
 
 @synthesize delegate = _delegate;
@@ -172,14 +184,21 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
 
     _delegateController = [[SRDelegateController alloc] init];
 
-    _readBuffer = dispatch_data_empty;
-    _outputBuffer = dispatch_data_empty;
+    SRRingBufferInit(&_readBuffer, SRReadBufferInitialCapacity);
+    _outputBuffer = [[NSMutableArray alloc] init];
+    _writeCompletions = [[NSMutableArray alloc] init];
 
     _currentFrameData = [[NSMutableData alloc] init];
 
     _consumers = [[NSMutableArray alloc] init];
 
     _consumerPool = [[SRIOConsumerPool alloc] init];
+    _frameBufferPool = [[SRFrameBufferPool alloc] init];
+
+    _perMessageDeflateClientMaxWindowBits = 15;
+    _perMessageDeflateServerMaxWindowBits = 15;
+
+    _networkThreadIndex = SRNetworkThreadIndexAutomatic;
 
     _scheduledRunloops = [[NSMutableSet alloc] init];
 
@@ -231,6 +250,13 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
         CFRelease(_receivedHTTPHeaders);
         _receivedHTTPHeaders = NULL;
     }
+
+    SRRingBufferDestroy(&_readBuffer);
+
+    // Nothing more will be written, don't leave a sender waiting.
+    for (NSArray *entry in _writeCompletions) {
+        ((dispatch_block_t)entry[1])();
+    }
 }
 
 #ifndef NDEBUG
@@ -243,6 +269,12 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
 
 #endif
 
+- (BOOL)perMessageDeflateNegotiated;
+{
+    // The offer is created in didConnect, it only counts once the handshake has accepted it.
+    return self.readyState != SR_CONNECTING && _perMessageDeflate != nil;
+}
+
 - (void)open;
 {
     assert(_url);
@@ -307,6 +339,17 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
         
         _protocol = negotiatedProtocol;
     }
+
+    NSString *negotiatedExtensions = CFBridgingRelease(CFHTTPMessageCopyHeaderFieldValue(_receivedHTTPHeaders, CFSTR("Sec-WebSocket-Extensions")));
+    if (negotiatedExtensions) {
+        if (!_perMessageDeflate || ![_perMessageDeflate acceptResponse:negotiatedExtensions]) {
+            NSError *error = SRErrorWithCodeDescription(2133, @"Server specified Sec-WebSocket-Extensions that weren't requested.");
+            [self _failWithError:error];
+            return;
+        }
+    } else {
+        _perMessageDeflate = nil;
+    }
     
     self.readyState = SR_OPEN;
     
@@ -397,6 +440,14 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
         CFHTTPMessageSetHeaderFieldValue(request, CFSTR("Sec-WebSocket-Protocol"), (__bridge CFStringRef)[_requestedProtocols componentsJoinedByString:@", "]);
     }
 
+    if (self.perMessageDeflateEnabled) {
+        _perMessageDeflate = [[SRPerMessageDeflate alloc] initWithClientMaxWindowBits:self.perMessageDeflateClientMaxWindowBits
+                                                                  serverMaxWindowBits:self.perMessageDeflateServerMaxWindowBits
+                                                              clientNoContextTakeover:self.perMessageDeflateClientNoContextTakeover
+                                                              serverNoContextTakeover:self.perMessageDeflateServerNoContextTakeover];
+        CFHTTPMessageSetHeaderFieldValue(request, CFSTR("Sec-WebSocket-Extensions"), (__bridge CFStringRef)[_perMessageDeflate offer]);
+    }
+
     [_urlRequest.allHTTPHeaderFields enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL *stop) {
         CFHTTPMessageSetHeaderFieldValue(request, (__bridge CFStringRef)key, (__bridge CFStringRef)obj);
     }];
@@ -505,7 +556,13 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
     [self _updateSecureStreamOptions];
     
     if (!_scheduledRunloops.count) {
-        [self scheduleInRunLoop:[NSRunLoop SR_networkRunLoop] forMode:NSDefaultRunLoopMode];
+        SRRunLoopThreadPool *pool = [SRRunLoopThreadPool sharedPool];
+        @synchronized(self) {
+            _networkThread = (_networkThreadIndex >= 0 ?
+                              [pool acquireThreadAtIndex:(NSUInteger)_networkThreadIndex] :
+                              [pool acquireThreadForObject:self]);
+        }
+        [self scheduleInRunLoop:_networkThread.runLoop forMode:NSDefaultRunLoopMode];
     }
     
     
@@ -613,6 +670,15 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
 }
 
 - (void)_writeData:(NSData *)data;
+{
+    __block NSData *strongData = data;
+    dispatch_data_t newData = dispatch_data_create(data.bytes, data.length, nil, ^{
+        strongData = nil;
+    });
+    [self _writeDispatchData:newData];
+}
+
+- (void)_writeDispatchData:(dispatch_data_t)data;
 {
     [self assertOnWorkQueue];
 
@@ -620,14 +686,40 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
         return;
     }
 
-    __block NSData *strongData = data;
-    dispatch_data_t newData = dispatch_data_create(data.bytes, data.length, nil, ^{
-        strongData = nil;
-    });
-    _outputBuffer = dispatch_data_create_concat(_outputBuffer, newData);
+    if (dispatch_data_get_size(data) == 0) {
+        return;
+    }
+    [_outputBuffer addObject:data];
+    _outputBytesQueued += dispatch_data_get_size(data);
     [self _pumpWriting];
 }
 
+- (void)_addWriteCompletion:(dispatch_block_t)completion;
+{
+    [self assertOnWorkQueue];
+
+    if (_outputBytesWritten == _outputBytesQueued || _cleanupScheduled) {
+        completion();
+        return;
+    }
+    [_writeCompletions addObject:@[@(_outputBytesQueued), [completion copy]]];
+}
+
+// Calls the completions whose bytes have all been written, or every one once nothing more will be.
+- (void)_callWriteCompletions:(BOOL)all;
+{
+    [self assertOnWorkQueue];
+
+    while (_writeCompletions.count > 0) {
+        NSArray *entry = _writeCompletions.firstObject;
+        if (!all && [entry[0] unsignedLongLongValue] > _outputBytesWritten) {
+            break;
+        }
+        [_writeCompletions removeObjectAtIndex:0];
+        ((dispatch_block_t)entry[1])();
+    }
+}
+
 - (void)send:(id)data;
 {
     if (!data) {
@@ -644,21 +736,37 @@ NSString *const SRHTTPResponseErrorKey = @"HTTPResponseStatusCode";
 - (void)sendString:(NSString *)string
 {
     NSAssert(self.readyState != SR_CONNECTING, @"Invalid State: Cannot call send: until connection is open");
-    string = [string copy];
+    if (!string) {
+        return;
+    }
+    // The encoded string is already a private copy. It's framed on the work queue because
+    // permessage-deflate has to compress messages in order.
+    NSData *payload = [string dataUsingEncoding:NSUTF8StringEncoding];
     dispatch_async(_workQueue, ^{
-        [self _sendFrameWithOpcode:SROpCodeTextFrame data:[string dataUsingEncoding:NSUTF8StringEncoding]];
+        [self _sendFrameWithOpcode:SROpCodeTextFrame data:payload];
     });
 }
 
 - (void)sendData:(NSData *)data
+{
+    [self sendData:data completion:nil];
+}
+
+- (void)sendData:(NSData *)data completion:(dispatch_block_t)completion
 {
     NSAssert(self.readyState != SR_CONNECTING, @"Invalid State: Cannot call send: until connection is open");
-    data = [data copy];
+    if (!data) {
+        if (completion) {
+            completion();
+        }
+        return;
+    }
+    // Masking into a pooled buffer takes the place of copying `data`, which may be mutable.
+    dispatch_data_t frame = [self _frameWithOpcode:SROpCodeBinaryFrame data:data compressed:NO];
     dispatch_async(_workQueue, ^{
-        if (data) {
-            [self _sendFrameWithOpcode:SROpCodeBinaryFrame data:data];
-        } else {
-            [self _sendFrameWithOpcode:SROpCodeTextFrame data:nil];
+        [self _sendFrame:frame];
+        if (completion) {
+            [self _addWriteCompletion:completion];
         }
     });
 }
@@ -784,10 +892,32 @@ static inline BOOL closeCodeIsValid(int closeCode) {
 
 - (void)_handleFrameWithData:(NSData *)frameData opCode:(NSInteger)opcode;
 {
-    frameData = [frameData copy];
-    // Check that the current data is valid UTF8
-    
     BOOL isControlFrame = (opcode == SROpCodePing || opcode == SROpCodePong || opcode == SROpCodeConnectionClose);
+
+    if (!isControlFrame && _currentFrameCompressed) {
+        // Inflating produces a fresh buffer, which stands in for the copy below.
+        frameData = [_perMessageDeflate decompressMessage:frameData];
+        if (!frameData) {
+            [self _closeWithProtocolError:@"Invalid permessage-deflate data"];
+            return;
+        }
+        if (opcode == SROpCodeTextFrame) {
+            // Compressed payloads can only be validated once inflated.
+            SRUTF8ValidatorConsume(&_currentFrameUTF8Validator, frameData.bytes, frameData.length);
+        }
+    } else {
+        frameData = [frameData copy];
+    }
+
+    // The fragments were validated as they arrived, the message must not end inside a code point.
+    if (opcode == SROpCodeTextFrame && !SRUTF8ValidatorIsComplete(&_currentFrameUTF8Validator)) {
+        [self closeWithCode:SRStatusCodeInvalidUTF8 reason:@"Text frames must be valid UTF-8."];
+        dispatch_async(_workQueue, ^{
+            [self closeConnection];
+        });
+        return;
+    }
+
     if (!isControlFrame) {
         [self _readFrameNew];
     } else {
@@ -800,20 +930,13 @@ static inline BOOL closeCodeIsValid(int closeCode) {
     //otherwise there can be misbehaviours when value at the pointer is changed
     switch (opcode) {
         case SROpCodeTextFrame: {
-            NSString *string = [[NSString alloc] initWithData:frameData encoding:NSUTF8StringEncoding];
-            if (!string && frameData) {
-                [self closeWithCode:SRStatusCodeInvalidUTF8 reason:@"Text frames must be valid UTF-8."];
-                dispatch_async(_workQueue, ^{
-                    [self closeConnection];
-                });
-                return;
-            }
             [self.delegateController performDelegateBlock:^(id<SRWebSocketDelegate>  _Nullable delegate, SRDelegateAvailableMethods availableMethods) {
                 // Don't convert into string - iff `delegate` tells us not to. Otherwise - create UTF8 string and handle that.
                 if (availableMethods.shouldConvertTextFrameToString && ![delegate webSocketShouldConvertTextFrameToString:self]) {
                     [delegate webSocket:self didReceiveMessage:frameData];
                 } else {
-                    [delegate webSocket:self didReceiveMessage:string];
+                    // Already validated, the string can't fail to decode.
+                    [delegate webSocket:self didReceiveMessage:[[NSString alloc] initWithData:frameData encoding:NSUTF8StringEncoding]];
                 }
             }];
             break;
@@ -859,6 +982,9 @@ static inline BOOL closeCodeIsValid(int closeCode) {
     }
     
     if (!isControlFrame) {
+        if (_currentFrameCount == 0) {
+            _currentFrameCompressed = frame_header.rsv1;
+        }
         _currentFrameOpcode = frame_header.opcode;
         _currentFrameCount += 1;
     }
@@ -876,22 +1002,94 @@ static inline BOOL closeCodeIsValid(int closeCode) {
         }
     } else {
         assert(frame_header.payload_length <= SIZE_T_MAX);
+        if ([self _readFramePayloadFromBuffer:frame_header]) {
+            return;
+        }
         [self _addConsumerWithDataLength:(size_t)frame_header.payload_length callback:^(SRWebSocket *self, NSData *newData) {
-            if (isControlFrame) {
-                [self _handleFrameWithData:newData opCode:frame_header.opcode];
-            } else {
-                if (frame_header.fin) {
-                    [self _handleFrameWithData:self->_currentFrameData opCode:frame_header.opcode];
-                } else {
-                    // TODO add assert that opcode is not a control;
-                    [self _readFrameContinue];
-                }
-                
-            }
+            [self _handleFramePayload:newData header:frame_header];
         } readToCurrentFrame:!isControlFrame unmaskBytes:frame_header.masked];
     }
 }
 
+- (void)_handleFramePayload:(NSData *)payload header:(frame_header)frame_header;
+{
+    BOOL isControlFrame = (frame_header.opcode == SROpCodePing || frame_header.opcode == SROpCodePong || frame_header.opcode == SROpCodeConnectionClose);
+    if (isControlFrame) {
+        [self _handleFrameWithData:payload opCode:frame_header.opcode];
+    } else {
+        if (frame_header.fin) {
+            [self _handleFrameWithData:_currentFrameData opCode:frame_header.opcode];
+        } else {
+            // TODO add assert that opcode is not a control;
+            [self _readFrameContinue];
+        }
+    }
+}
+
+// Fast path for a payload that has already been read in full: consume it without queuing a consumer.
+- (BOOL)_readFramePayloadFromBuffer:(frame_header)frame_header;
+{
+    size_t payloadLength = (size_t)frame_header.payload_length;
+    if (_consumers.count || SRRingBufferReadableLength(&_readBuffer) < payloadLength) {
+        return NO;
+    }
+
+    const uint8_t *bytes = SRRingBufferLinearize(&_readBuffer, payloadLength);
+    if (!bytes) {
+        return NO;
+    }
+
+    BOOL isControlFrame = (frame_header.opcode == SROpCodePing || frame_header.opcode == SROpCodePong || frame_header.opcode == SROpCodeConnectionClose);
+    NSData *payload = nil;
+    if (isControlFrame) {
+        payload = [self _copyPayloadBytes:bytes length:payloadLength unmask:frame_header.masked];
+    } else if (![self _appendFramePayloadBytes:bytes length:payloadLength unmask:frame_header.masked]) {
+        SRRingBufferDidRead(&_readBuffer, payloadLength);
+        return YES;
+    }
+    SRRingBufferDidRead(&_readBuffer, payloadLength);
+
+    [self _handleFramePayload:payload header:frame_header];
+    return YES;
+}
+
+// Appends payload bytes to the current message, unmasking and validating them in place.
+// Returns NO if the connection is being closed because the text isn't valid UTF-8.
+- (BOOL)_appendFramePayloadBytes:(const uint8_t *)bytes length:(size_t)length unmask:(BOOL)unmask;
+{
+    NSUInteger offset = _currentFrameData.length;
+    [_currentFrameData appendBytes:bytes length:length];
+    uint8_t *appendedBytes = (uint8_t *)_currentFrameData.mutableBytes + offset;
+    if (unmask) {
+        _currentReadMaskOffset = SRMaskBytes(appendedBytes, appendedBytes, length, _currentReadMaskKey, _currentReadMaskOffset);
+    }
+
+    _readOpCount += 1;
+
+    if (_currentFrameOpcode == SROpCodeTextFrame && !_currentFrameCompressed) {
+        // Validate each slice as it arrives, a code point split across reads is carried in the validator state.
+        if (!SRUTF8ValidatorConsume(&_currentFrameUTF8Validator, appendedBytes, length)) {
+            [self closeWithCode:SRStatusCodeInvalidUTF8 reason:@"Text frames must be valid UTF-8"];
+            dispatch_async(_workQueue, ^{
+                [self closeConnection];
+            });
+            return NO;
+        }
+    }
+    return YES;
+}
+
+// Headers and control frames are small; handlers get their own copy.
+- (NSData *)_copyPayloadBytes:(const uint8_t *)bytes length:(size_t)length unmask:(BOOL)unmask;
+{
+    NSMutableData *payload = [[NSMutableData alloc] initWithBytes:bytes length:length];
+    if (unmask) {
+        uint8_t *mutableBytes = payload.mutableBytes;
+        _currentReadMaskOffset = SRMaskBytes(mutableBytes, mutableBytes, length, _currentReadMaskKey, _currentReadMaskOffset);
+    }
+    return payload;
+}
+
 /* From RFC:
 
  0                   1                   2                   3
@@ -917,88 +1115,164 @@ static inline BOOL closeCodeIsValid(int closeCode) {
 static const uint8_t SRFinMask          = 0x80;
 static const uint8_t SROpCodeMask       = 0x0F;
 static const uint8_t SRRsvMask          = 0x70;
+static const uint8_t SRRsv1Mask         = 0x40;
 static const uint8_t SRMaskMask         = 0x80;
 static const uint8_t SRPayloadLenMask   = 0x7F;
 
+// 2 byte base header, up to 8 bytes of extended length and the 4 byte mask key.
+static const size_t SRFrameHeaderMaxLength = 2 + sizeof(uint64_t) + sizeof(uint32_t);
+
+// Fragments handled back to back on the fast path before falling back to queued consumers.
+static const NSUInteger SRFastPathMaxDepth = 16;
+
+
+// Decodes the first two header bytes, closing the connection on a protocol error.
+- (BOOL)_decodeFrameHeaderBytes:(const uint8_t *)headerBuffer into:(frame_header *)header;
+{
+    header->rsv1 = !!(SRRsv1Mask & headerBuffer[0]);
+    if ((headerBuffer[0] & SRRsvMask & ~SRRsv1Mask) || (header->rsv1 && !_perMessageDeflate)) {
+        [self _closeWithProtocolError:@"Server used RSV bits"];
+        return NO;
+    }
+    
+    uint8_t receivedOpcode = (SROpCodeMask & headerBuffer[0]);
+    
+    BOOL isControlFrame = (receivedOpcode == SROpCodePing || receivedOpcode == SROpCodePong || receivedOpcode == SROpCodeConnectionClose);
+    
+    // permessage-deflate marks only the first frame of a data message.
+    if (header->rsv1 && (isControlFrame || receivedOpcode == 0)) {
+        [self _closeWithProtocolError:@"RSV1 set on a control or continuation frame"];
+        return NO;
+    }
+    
+    if (!isControlFrame && receivedOpcode != 0 && _currentFrameCount > 0) {
+        [self _closeWithProtocolError:@"all data frames after the initial data frame must have opcode 0"];
+        return NO;
+    }
+    
+    if (receivedOpcode == 0 && _currentFrameCount == 0) {
+        [self _closeWithProtocolError:@"cannot continue a message"];
+        return NO;
+    }
+    
+    header->opcode = receivedOpcode == 0 ? _currentFrameOpcode : receivedOpcode;
+    
+    header->fin = !!(SRFinMask & headerBuffer[0]);
+    
+    
+    header->masked = !!(SRMaskMask & headerBuffer[1]);
+    header->payload_length = SRPayloadLenMask & headerBuffer[1];
+    
+    if (header->masked) {
+        [self _closeWithProtocolError:@"Client must receive unmasked data"];
+    }
+    return YES;
+}
+
+static inline size_t SRFrameHeaderExtraLength(const frame_header *header)
+{
+    size_t extra_bytes_needed = header->masked ? sizeof(uint32_t) : 0;
+    
+    if (header->payload_length == 126) {
+        extra_bytes_needed += sizeof(uint16_t);
+    } else if (header->payload_length == 127) {
+        extra_bytes_needed += sizeof(uint64_t);
+    }
+    return extra_bytes_needed;
+}
+
+// Reads the extended payload length and mask key that follow the first two header bytes.
+- (void)_decodeFrameHeaderExtraBytes:(const uint8_t *)mapped_buffer length:(size_t)mapped_size into:(frame_header *)header;
+{
+    #pragma unused (mapped_size)
+    size_t offset = 0;
+    
+    if (header->payload_length == 126) {
+        assert(mapped_size >= sizeof(uint16_t));
+        uint16_t newLen;
+        memcpy(&newLen, mapped_buffer, sizeof(newLen));
+        header->payload_length = EndianU16_BtoN(newLen);
+        offset += sizeof(uint16_t);
+    } else if (header->payload_length == 127) {
+        assert(mapped_size >= sizeof(uint64_t));
+        uint64_t newLen;
+        memcpy(&newLen, mapped_buffer, sizeof(newLen));
+        header->payload_length = EndianU64_BtoN(newLen);
+        offset += sizeof(uint64_t);
+    } else {
+        assert(header->payload_length < 126 && header->payload_length >= 0);
+    }
+    
+    if (header->masked) {
+        assert(mapped_size >= sizeof(_currentReadMaskKey) + offset);
+        memcpy(_currentReadMaskKey, mapped_buffer + offset, sizeof(_currentReadMaskKey));
+    }
+}
+
+// Fast path: when nothing is queued and the whole header has already been read, decode it straight
+// from the read buffer instead of going through a consumer per header part.
+- (BOOL)_readFrameHeaderFromBuffer;
+{
+    if (_consumers.count || self.readyState >= SR_CLOSED || _fastPathDepth >= SRFastPathMaxDepth) {
+        return NO;
+    }
+    
+    size_t available = SRRingBufferReadableLength(&_readBuffer);
+    if (available < 2) {
+        return NO;
+    }
+    
+    const uint8_t *bytes = SRRingBufferLinearize(&_readBuffer, MIN(available, SRFrameHeaderMaxLength));
+    if (!bytes) {
+        return NO;
+    }
+    
+    // Peek at the lengths before decoding, so a partial header is left for the consumer chain.
+    frame_header peek = {0};
+    peek.masked = !!(SRMaskMask & bytes[1]);
+    peek.payload_length = SRPayloadLenMask & bytes[1];
+    size_t extra_bytes_needed = SRFrameHeaderExtraLength(&peek);
+    if (available < 2 + extra_bytes_needed) {
+        return NO;
+    }
+    
+    frame_header header = {0};
+    if (![self _decodeFrameHeaderBytes:bytes into:&header]) {
+        return YES;
+    }
+    [self _decodeFrameHeaderExtraBytes:bytes + 2 length:extra_bytes_needed into:&header];
+    SRRingBufferDidRead(&_readBuffer, 2 + extra_bytes_needed);
+    
+    // Non-final fragments come straight back here, so bound the recursion.
+    _fastPathDepth += 1;
+    [self _handleFrameHeader:header curData:_currentFrameData];
+    _fastPathDepth -= 1;
+    return YES;
+}
 
 - (void)_readFrameContinue;
 {
     assert((_currentFrameCount == 0 && _currentFrameOpcode == 0) || (_currentFrameCount > 0 && _currentFrameOpcode > 0));
 
+    if ([self _readFrameHeaderFromBuffer]) {
+        return;
+    }
+
     [self _addConsumerWithDataLength:2 callback:^(SRWebSocket *self, NSData *data) {
         __block frame_header header = {0};
         
-        const uint8_t *headerBuffer = data.bytes;
         assert(data.length >= 2);
-        
-        if (headerBuffer[0] & SRRsvMask) {
-            [self _closeWithProtocolError:@"Server used RSV bits"];
-            return;
-        }
-        
-        uint8_t receivedOpcode = (SROpCodeMask & headerBuffer[0]);
-        
-        BOOL isControlFrame = (receivedOpcode == SROpCodePing || receivedOpcode == SROpCodePong || receivedOpcode == SROpCodeConnectionClose);
-        
-        if (!isControlFrame && receivedOpcode != 0 && self->_currentFrameCount > 0) {
-            [self _closeWithProtocolError:@"all data frames after the initial data frame must have opcode 0"];
+        if (![self _decodeFrameHeaderBytes:data.bytes into:&header]) {
             return;
         }
         
-        if (receivedOpcode == 0 && self->_currentFrameCount == 0) {
-            [self _closeWithProtocolError:@"cannot continue a message"];
-            return;
-        }
-        
-        header.opcode = receivedOpcode == 0 ? self->_currentFrameOpcode : receivedOpcode;
-        
-        header.fin = !!(SRFinMask & headerBuffer[0]);
-        
-        
-        header.masked = !!(SRMaskMask & headerBuffer[1]);
-        header.payload_length = SRPayloadLenMask & headerBuffer[1];
-        
-        headerBuffer = NULL;
-        
-        if (header.masked) {
-            [self _closeWithProtocolError:@"Client must receive unmasked data"];
-        }
-        
-        size_t extra_bytes_needed = header.masked ? sizeof(_currentReadMaskKey) : 0;
-        
-        if (header.payload_length == 126) {
-            extra_bytes_needed += sizeof(uint16_t);
-        } else if (header.payload_length == 127) {
-            extra_bytes_needed += sizeof(uint64_t);
-        }
+        size_t extra_bytes_needed = SRFrameHeaderExtraLength(&header);
         
         if (extra_bytes_needed == 0) {
             [self _handleFrameHeader:header curData:self->_currentFrameData];
         } else {
             [self _addConsumerWithDataLength:extra_bytes_needed callback:^(SRWebSocket *self, NSData *data) {
-                size_t mapped_size = data.length;
-                #pragma unused (mapped_size)
-                const void *mapped_buffer = data.bytes;
-                size_t offset = 0;
-                
-                if (header.payload_length == 126) {
-                    assert(mapped_size >= sizeof(uint16_t));
-                    uint16_t newLen = EndianU16_BtoN(*(uint16_t *)(mapped_buffer));
-                    header.payload_length = newLen;
-                    offset += sizeof(uint16_t);
-                } else if (header.payload_length == 127) {
-                    assert(mapped_size >= sizeof(uint64_t));
-                    header.payload_length = EndianU64_BtoN(*(uint64_t *)(mapped_buffer));
-                    offset += sizeof(uint64_t);
-                } else {
-                    assert(header.payload_length < 126 && header.payload_length >= 0);
-                }
-                
-                if (header.masked) {
-                    assert(mapped_size >= sizeof(_currentReadMaskOffset) + offset);
-                    memcpy(self->_currentReadMaskKey, ((uint8_t *)mapped_buffer) + offset, sizeof(self->_currentReadMaskKey));
-                }
-                
+                [self _decodeFrameHeaderExtraBytes:data.bytes length:data.length into:&header];
                 [self _handleFrameHeader:header curData:self->_currentFrameData];
             } readToCurrentFrame:NO unmaskBytes:NO];
         }
@@ -1013,7 +1287,8 @@ static const uint8_t SRPayloadLenMask   = 0x7F;
         _currentFrameOpcode = 0;
         _currentFrameCount = 0;
         _readOpCount = 0;
-        _currentStringScanPosition = 0;
+        SRUTF8ValidatorReset(&_currentFrameUTF8Validator);
+        _currentFrameCompressed = NO;
         
         [self _readFrameContinue];
     });
@@ -1023,32 +1298,46 @@ static const uint8_t SRPayloadLenMask   = 0x7F;
 {
     [self assertOnWorkQueue];
 
-    NSUInteger dataLength = dispatch_data_get_size(_outputBuffer);
-    if (dataLength - _outputBufferOffset > 0 && _outputStream.hasSpaceAvailable) {
-        __block NSInteger bytesWritten = 0;
+    // Write frame regions in order until the stream stops taking bytes. A short write leaves the
+    // rest of the region for the next NSStreamEventHasSpaceAvailable.
+    while (_outputBuffer.count > 0 && _outputStream.hasSpaceAvailable) {
+        dispatch_data_t frame = _outputBuffer.firstObject;
+        __block BOOL failed = NO;
+        __block BOOL full = NO;
 
-        dispatch_data_t dataToSend = dispatch_data_create_subrange(_outputBuffer, _outputBufferOffset, dataLength - _outputBufferOffset);
-        BOOL written = dispatch_data_apply(dataToSend, ^bool(dispatch_data_t region, size_t offset, const void *buffer, size_t size) {
-            NSInteger written = [_outputStream write:buffer maxLength:size];
-            bytesWritten += written;
-            return written != -1;
+        dispatch_data_apply(frame, ^bool(dispatch_data_t region, size_t offset, const void *buffer, size_t size) {
+            if (offset + size <= _outputBufferOffset) {
+                return true;
+            }
+            size_t start = _outputBufferOffset - offset;
+            NSInteger written = [_outputStream write:(const uint8_t *)buffer + start maxLength:size - start];
+            if (written < 0) {
+                failed = YES;
+                return false;
+            }
+            _outputBufferOffset += written;
+            _outputBytesWritten += written;
+            full = (size_t)written < size - start;
+            return !full;
         });
-        if (!written) {
+        if (failed) {
             NSError *error = SRErrorWithCodeDescriptionUnderlyingError(2145, @"Error writing to stream.", _outputStream.streamError);
             [self _failWithError:error];
             return;
         }
 
-        _outputBufferOffset += bytesWritten;
-
-        if (_outputBufferOffset > 4096 && _outputBufferOffset > dataLength / 2) {
-            _outputBuffer = dispatch_data_create_subrange(_outputBuffer, _outputBufferOffset, dataLength - _outputBufferOffset);
+        if (_outputBufferOffset == dispatch_data_get_size(frame)) {
+            [_outputBuffer removeObjectAtIndex:0];
             _outputBufferOffset = 0;
         }
+        if (full) {
+            break;
+        }
     }
+    [self _callWriteCompletions:NO];
 
     if (_closeWhenFinishedWriting &&
-        (dispatch_data_get_size(_outputBuffer) - _outputBufferOffset) == 0 &&
+        _outputBuffer.count == 0 &&
         (_inputStream.streamStatus != NSStreamStatusNotOpen &&
          _inputStream.streamStatus != NSStreamStatusClosed) &&
         !_sentClose) {
@@ -1101,6 +1390,9 @@ static const uint8_t SRPayloadLenMask   = 0x7F;
 
 - (void)_scheduleCleanup
 {
+    // Called on the work queue once the connection is over, unwritten frames never will be.
+    [self _callWriteCompletions:YES];
+
     @synchronized(self) {
         if (_cleanupScheduled) {
             return;
@@ -1111,7 +1403,8 @@ static const uint8_t SRPayloadLenMask   = 0x7F;
         // Cleanup NSStream delegate's in the same RunLoop used by the streams themselves:
         // This way we'll prevent race conditions between handleEvent and SRWebsocket's dealloc
         NSTimer *timer = [NSTimer timerWithTimeInterval:(0.0f) target:self selector:@selector(_cleanupSelfReference:) userInfo:nil repeats:NO];
-        [[NSRunLoop SR_networkRunLoop] addTimer:timer forMode:NSDefaultRunLoopMode];
+        NSRunLoop *runLoop = _networkThread ? _networkThread.runLoop : [NSRunLoop SR_networkRunLoop];
+        [runLoop addTimer:timer forMode:NSDefaultRunLoopMode];
     }
 }
 
@@ -1125,6 +1418,11 @@ static const uint8_t SRPayloadLenMask   = 0x7F;
         // Remove the streams, right now, from the networkRunLoop
         [_inputStream close];
         [_outputStream close];
+
+        if (_networkThread) {
+            [[SRRunLoopThreadPool sharedPool] relinquishThread:_networkThread];
+            _networkThread = nil;
+        }
     }
     
     // Cleanup selfRetain in the same GCD queue as usual
@@ -1176,13 +1474,11 @@ static const char CRLFCRLFBytes[] = {'\r', '\n', '\r', '\n'};
         return didWork;
     }
 
-    size_t readBufferSize = dispatch_data_get_size(_readBuffer);
-    
     if (!_consumers.count) {
         return didWork;
     }
 
-    size_t curSize = readBufferSize - _readBufferOffset;
+    size_t curSize = SRRingBufferReadableLength(&_readBuffer);
     if (!curSize) {
         return didWork;
     }
@@ -1193,8 +1489,14 @@ static const char CRLFCRLFBytes[] = {'\r', '\n', '\r', '\n'};
     
     size_t foundSize = 0;
     if (consumer.consumer) {
-        NSData *subdata = (NSData *)dispatch_data_create_subrange(_readBuffer, _readBufferOffset, readBufferSize - _readBufferOffset);
-        foundSize = consumer.consumer(subdata);
+        // Scanners only look at the bytes during the call, so they get a view of the ring.
+        const uint8_t *bytes = SRRingBufferLinearize(&_readBuffer, curSize);
+        if (!bytes) {
+            [self _failWithError:SRErrorWithCodeDescription(SRStatusCodeMessageTooBig, @"Unable to allocate memory to read from socket.")];
+            return didWork;
+        }
+        NSData *unreadData = [[NSData alloc] initWithBytesNoCopy:(void *)bytes length:curSize freeWhenDone:NO];
+        foundSize = consumer.consumer(unreadData);
     } else {
         assert(consumer.bytesNeeded);
         if (curSize >= bytesNeeded) {
@@ -1205,56 +1507,26 @@ static const char CRLFCRLFBytes[] = {'\r', '\n', '\r', '\n'};
     }
 
     if (consumer.readToCurrentFrame || foundSize) {
-        NSData *slice = (NSData *)dispatch_data_create_subrange(_readBuffer, _readBufferOffset, foundSize);
-        
-        _readBufferOffset += foundSize;
-
-        if (_readBufferOffset > 4096 && _readBufferOffset > readBufferSize / 2) {
-            _readBuffer = dispatch_data_create_subrange(_readBuffer, _readBufferOffset, readBufferSize - _readBufferOffset);
-            _readBufferOffset = 0;
+        const uint8_t *sliceBytes = SRRingBufferLinearize(&_readBuffer, foundSize);
+        if (!sliceBytes) {
+            [self _failWithError:SRErrorWithCodeDescription(SRStatusCodeMessageTooBig, @"Unable to allocate memory to read from socket.")];
+            return didWork;
         }
-        
-        if (consumer.unmaskBytes) {
-            NSMutableData *mutableSlice = [slice mutableCopy];
-            
-            NSUInteger len = mutableSlice.length;
-            uint8_t *bytes = mutableSlice.mutableBytes;
-            
-            for (NSUInteger i = 0; i < len; i++) {
-                bytes[i] = bytes[i] ^ _currentReadMaskKey[_currentReadMaskOffset % sizeof(_currentReadMaskKey)];
-                _currentReadMaskOffset += 1;
-            }
-            
-            slice = mutableSlice;
+
+        // Frame payload goes straight from the ring onto the end of the frame, and is unmasked there.
+        NSData *slice = nil;
+        BOOL validPayload = YES;
+        if (consumer.readToCurrentFrame) {
+            validPayload = [self _appendFramePayloadBytes:sliceBytes length:foundSize unmask:consumer.unmaskBytes];
+        } else {
+            slice = [self _copyPayloadBytes:sliceBytes length:foundSize unmask:consumer.unmaskBytes];
         }
+
+        SRRingBufferDidRead(&_readBuffer, foundSize);
         
         if (consumer.readToCurrentFrame) {
-            [_currentFrameData appendData:slice];
-            
-            _readOpCount += 1;
-            
-            if (_currentFrameOpcode == SROpCodeTextFrame) {
-                // Validate UTF8 stuff.
-                size_t currentDataSize = _currentFrameData.length;
-                if (_currentFrameOpcode == SROpCodeTextFrame && currentDataSize > 0) {
-                    // TODO: Optimize the crap out of this.  Don't really have to copy all the data each time
-                    
-                    size_t scanSize = currentDataSize - _currentStringScanPosition;
-                    
-                    NSData *scan_data = [_currentFrameData subdataWithRange:NSMakeRange(_currentStringScanPosition, scanSize)];
-                    int32_t valid_utf8_size = validate_dispatch_data_partial_string(scan_data);
-                    
-                    if (valid_utf8_size == -1) {
-                        [self closeWithCode:SRStatusCodeInvalidUTF8 reason:@"Text frames must be valid UTF-8"];
-                        dispatch_async(_workQueue, ^{
-                            [self closeConnection];
-                        });
-                        return didWork;
-                    } else {
-                        _currentStringScanPosition += valid_utf8_size;
-                    }
-                } 
-                
+            if (!validPayload) {
+                return didWork;
             }
             
             consumer.bytesNeeded -= foundSize;
@@ -1294,84 +1566,112 @@ static const char CRLFCRLFBytes[] = {'\r', '\n', '\r', '\n'};
 
 //#define NOMASK
 
-static const size_t SRFrameHeaderOverhead = 32;
+static size_t SRFrameHeaderWrite(uint8_t *header, SROpCode opcode, BOOL compressed, size_t payloadLength, BOOL useMask, uint8_t *_Nullable *_Nonnull maskKey)
+{
+    size_t headerLength = 2;
 
-- (void)_sendFrameWithOpcode:(SROpCode)opcode data:(id)data;
+    // set fin
+    header[0] = SRFinMask | opcode | (compressed ? SRRsv1Mask : 0);
+    header[1] = useMask ? SRMaskMask : 0;
+
+    if (payloadLength < 126) {
+        header[1] |= payloadLength;
+    } else if (payloadLength <= UINT16_MAX) {
+        header[1] |= 126;
+        uint16_t length = EndianU16_BtoN((uint16_t)payloadLength);
+        memcpy(header + headerLength, &length, sizeof(length));
+        headerLength += sizeof(uint16_t);
+    } else {
+        header[1] |= 127;
+        uint64_t length = EndianU64_BtoN((uint64_t)payloadLength);
+        memcpy(header + headerLength, &length, sizeof(length));
+        headerLength += sizeof(uint64_t);
+    }
+
+    *maskKey = NULL;
+    if (useMask) {
+        *maskKey = header + headerLength;
+        SecRandomCopyBytes(kSecRandomDefault, sizeof(uint32_t), *maskKey);
+        headerLength += sizeof(uint32_t);
+    }
+
+    return headerLength;
+}
+
+// Safe to call from any queue. Masked frames are written header first into a single pooled buffer,
+// unmasked frames chain the header in front of the payload without copying it.
+- (nullable dispatch_data_t)_frameWithOpcode:(SROpCode)opcode data:(nullable NSData *)data compressed:(BOOL)compressed;
 {
-    [self assertOnWorkQueue];
-    
     if (nil == data) {
-        return;
+        return nil;
     }
-    
-    NSAssert([data isKindOfClass:[NSData class]] || [data isKindOfClass:[NSString class]], @"NSString or NSData");
-    
-    size_t payloadLength = [data isKindOfClass:[NSString class]] ? [(NSString *)data lengthOfBytesUsingEncoding:NSUTF8StringEncoding] : [data length];
-        
-    NSMutableData *frame = [[NSMutableData alloc] initWithLength:payloadLength + SRFrameHeaderOverhead];
-    if (!frame) {
-        [self closeWithCode:SRStatusCodeMessageTooBig reason:@"Message too big"];
-        return;
-    }
-    uint8_t *frame_buffer = (uint8_t *)[frame mutableBytes];
-    
-    // set fin
-    frame_buffer[0] = SRFinMask | opcode;
-    
+
     BOOL useMask = YES;
 #ifdef NOMASK
     useMask = NO;
 #endif
-    
-    if (useMask) {
-    // set the mask and header
-        frame_buffer[1] |= SRMaskMask;
+
+    size_t payloadLength = data.length;
+    uint8_t header[SRFrameHeaderMaxLength];
+    uint8_t *maskKey = NULL;
+    size_t headerLength = SRFrameHeaderWrite(header, opcode, compressed, payloadLength, useMask, &maskKey);
+
+    if (!useMask) {
+        __block NSData *payload = [data copy];
+        dispatch_data_t headerData = dispatch_data_create(header, headerLength, nil, DISPATCH_DATA_DESTRUCTOR_DEFAULT);
+        dispatch_data_t payloadData = dispatch_data_create(payload.bytes, payloadLength, nil, ^{
+            payload = nil;
+        });
+        return dispatch_data_create_concat(headerData, payloadData);
     }
+
+    const uint8_t *unmaskedPayload = data.bytes;
+    return [_frameBufferPool dataWithLength:headerLength + payloadLength fill:^(uint8_t *bytes) {
+        memcpy(bytes, header, headerLength);
+        SRMaskBytes(bytes + headerLength, unmaskedPayload, payloadLength, maskKey, 0);
+    }];
+}
+
+- (void)_sendFrame:(nullable dispatch_data_t)frame;
+{
+    [self assertOnWorkQueue];
+
+    if (!frame) {
+        [self closeWithCode:SRStatusCodeMessageTooBig reason:@"Message too big"];
+        return;
+    }
+
+    [self _writeDispatchData:frame];
+}
+
+- (void)_sendFrameWithOpcode:(SROpCode)opcode data:(id)data;
+{
+    [self assertOnWorkQueue];
     
-    size_t frame_buffer_size = 2;
-    
-    const uint8_t *unmasked_payload = NULL;
-    if ([data isKindOfClass:[NSData class]]) {
-        unmasked_payload = (uint8_t *)[data bytes];
-    } else if ([data isKindOfClass:[NSString class]]) {
-        unmasked_payload =  (const uint8_t *)[data UTF8String];
-    } else {
+    if (nil == data) {
         return;
     }
     
-    if (payloadLength < 126) {
-        frame_buffer[1] |= payloadLength;
-    } else if (payloadLength <= UINT16_MAX) {
-        frame_buffer[1] |= 126;
-        *((uint16_t *)(frame_buffer + frame_buffer_size)) = EndianU16_BtoN((uint16_t)payloadLength);
-        frame_buffer_size += sizeof(uint16_t);
-    } else {
-        frame_buffer[1] |= 127;
-        *((uint64_t *)(frame_buffer + frame_buffer_size)) = EndianU64_BtoN((uint64_t)payloadLength);
-        frame_buffer_size += sizeof(uint64_t);
+    NSAssert([data isKindOfClass:[NSData class]] || [data isKindOfClass:[NSString class]], @"NSString or NSData");
+    
+    if ([data isKindOfClass:[NSString class]]) {
+        data = [(NSString *)data dataUsingEncoding:NSUTF8StringEncoding];
+    } else if (![data isKindOfClass:[NSData class]]) {
+        return;
     }
-        
-    if (!useMask) {
-        for (size_t i = 0; i < payloadLength; i++) {
-            frame_buffer[frame_buffer_size] = unmasked_payload[i];
-            frame_buffer_size += 1;
-        }
-    } else {
-        uint8_t *mask_key = frame_buffer + frame_buffer_size;
-        SecRandomCopyBytes(kSecRandomDefault, sizeof(uint32_t), (uint8_t *)mask_key);
-        frame_buffer_size += sizeof(uint32_t);
-        
-        // TODO: could probably optimize this with SIMD
-        for (size_t i = 0; i < payloadLength; i++) {
-            frame_buffer[frame_buffer_size] = unmasked_payload[i] ^ mask_key[i % sizeof(uint32_t)];
-            frame_buffer_size += 1;
+
+    // Only text is worth compressing, binary frames carry already compressed audio.
+    BOOL compressed = NO;
+    if (_perMessageDeflate && opcode == SROpCodeTextFrame) {
+        data = [_perMessageDeflate compressMessage:data];
+        if (!data) {
+            [self closeWithCode:SRStatusCodeInternalError reason:@"Compression failed"];
+            return;
         }
+        compressed = YES;
     }
 
-    assert(frame_buffer_size <= [frame length]);
-    frame.length = frame_buffer_size;
-    
-    [self _writeData:frame];
+    [self _sendFrame:[self _frameWithOpcode:opcode data:data compressed:compressed]];
 }
 
 - (void)stream:(NSStream *)aStream handleEvent:(NSStreamEvent)eventCode;
@@ -1429,7 +1729,7 @@ static const size_t SRFrameHeaderOverhead = 32;
                 if (self.readyState >= SR_CLOSING) {
                     return;
                 }
-                assert(_readBuffer);
+                assert(_readBuffer.bytes);
                 
                 // didConnect fires after certificate verification if we're using pinned certificates.
                 BOOL usingPinnedCerts = [[_urlRequest SR_SSLPinnedCertificates] count] > 0;
@@ -1445,8 +1745,7 @@ static const size_t SRFrameHeaderOverhead = 32;
                 SRFastLog(@"NSStreamEventErrorOccurred %@ %@", aStream, [[aStream streamError] copy]);
                 /// TODO specify error better!
                 [self _failWithError:aStream.streamError];
-                _readBufferOffset = 0;
-                _readBuffer = dispatch_data_empty;
+                SRRingBufferClear(&_readBuffer);
                 break;
                 
             }
@@ -1483,20 +1782,18 @@ static const size_t SRFrameHeaderOverhead = 32;
                 
             case NSStreamEventHasBytesAvailable: {
                 SRFastLog(@"NSStreamEventHasBytesAvailable %@", aStream);
-                const int bufferSize = 2048;
-                uint8_t buffer[bufferSize];
-                
                 while (_inputStream.hasBytesAvailable) {
-                    NSInteger bytesRead = [_inputStream read:buffer maxLength:bufferSize];
+                    // Read straight into the free space of the ring.
+                    struct iovec spans[2];
+                    if (!SRRingBufferReserve(&_readBuffer, SRReadChunkSize) || SRRingBufferWritableSpans(&_readBuffer, spans) == 0) {
+                        NSError *error = SRErrorWithCodeDescription(SRStatusCodeMessageTooBig,
+                                                                    @"Unable to allocate memory to read from socket.");
+                        [self _failWithError:error];
+                        return;
+                    }
+                    NSInteger bytesRead = [_inputStream read:spans[0].iov_base maxLength:spans[0].iov_len];
                     if (bytesRead > 0) {
-                        dispatch_data_t data = dispatch_data_create(buffer, bytesRead, nil, DISPATCH_DATA_DESTRUCTOR_DEFAULT);
-                        if (!data) {
-                            NSError *error = SRErrorWithCodeDescription(SRStatusCodeMessageTooBig,
-                                                                        @"Unable to allocate memory to read from socket.");
-                            [self _failWithError:error];
-                            return;
-                        }
-                        _readBuffer = dispatch_data_create_concat(_readBuffer, data);
+                        SRRingBufferDidWrite(&_readBuffer, bytesRead);
                     } else if (bytesRead == -1) {
                         [self _failWithError:_inputStream.streamError];
                     }
@@ -1592,78 +1889,31 @@ static inline void SRFastLog(NSString *format, ...)  {
 }
 
 
-#ifdef HAS_ICU
-
-static inline int32_t validate_dispatch_data_partial_string(NSData *data) {
-    if ([data length] > INT32_MAX) {
-        // INT32_MAX is the limit so long as this Framework is using 32 bit ints everywhere.
-        return -1;
-    }
-
-    int32_t size = (int32_t)[data length];
+@implementation NSRunLoop (SRWebSocket)
 
-    const void * contents = [data bytes];
-    const uint8_t *str = (const uint8_t *)contents;
-    
-    UChar32 codepoint = 1;
-    int32_t offset = 0;
-    int32_t lastOffset = 0;
-    while(offset < size && codepoint > 0)  {
-        lastOffset = offset;
-        U8_NEXT(str, offset, size, codepoint);
-    }
-    
-    if (codepoint == -1) {
-        // Check to see if the last byte is valid or whether it was just continuing
-        if (!U8_IS_LEAD(str[lastOffset]) || U8_COUNT_TRAIL_BYTES(str[lastOffset]) + lastOffset < (int32_t)size) {
-            
-            size = -1;
-        } else {
-            uint8_t leadByte = str[lastOffset];
-            U8_MASK_LEAD_BYTE(leadByte, U8_COUNT_TRAIL_BYTES(leadByte));
-            
-            for (int i = lastOffset + 1; i < offset; i++) {
-                if (U8_IS_SINGLE(str[i]) || U8_IS_LEAD(str[i]) || !U8_IS_TRAIL(str[i])) {
-                    size = -1;
-                }
-            }
-            
-            if (size != -1) {
-                size = lastOffset;
-            }
-        }
-    }
-    
-    if (size != -1 && ![[NSString alloc] initWithBytesNoCopy:(char *)[data bytes] length:size encoding:NSUTF8StringEncoding freeWhenDone:NO]) {
-        size = -1;
-    }
-    
-    return size;
++ (NSRunLoop *)SR_networkRunLoop
+{
+    return [SRRunLoopThread sharedThread].runLoop;
 }
 
-#else
-
-// This is a hack, and probably not optimal
-static inline int32_t validate_dispatch_data_partial_string(NSData *data) {
-    static const int maxCodepointSize = 3;
-    
-    for (int i = 0; i < maxCodepointSize; i++) {
-        NSString *str = [[NSString alloc] initWithBytesNoCopy:(char *)data.bytes length:data.length - i encoding:NSUTF8StringEncoding freeWhenDone:NO];
-        if (str) {
-            return (int32_t)data.length - i;
-        }
-    }
-    
-    return -1;
++ (NSUInteger)SR_networkThreadCount
+{
+    return [SRRunLoopThreadPool sharedPool].threadCount;
 }
 
-#endif
++ (void)SR_setNetworkThreadCount:(NSUInteger)count
+{
+    [SRRunLoopThreadPool sharedPool].threadCount = count;
+}
 
-@implementation NSRunLoop (SRWebSocket)
++ (SRNetworkThreadAssignment)SR_networkThreadAssignment
+{
+    return [SRRunLoopThreadPool sharedPool].assignment;
+}
 
-+ (NSRunLoop *)SR_networkRunLoop
++ (void)SR_setNetworkThreadAssignment:(SRNetworkThreadAssignment)assignment
 {
-    return [SRRunLoopThread sharedThread].runLoop;
+    [SRRunLoopThreadPool sharedPool].assignment = assignment;
 }
 
 @end
@@ -17,17 +17,30 @@
 #import <Foundation/Foundation.h>
 #import "STTConfiguration.h"
 #import "SpeechUtility.h"
+#import "STTTimingTrace.h"
 
 @interface WebSocketAudioStreamer : NSObject
 
+// stages of the recognition in progress are marked here when set
+@property (atomic, strong) STTTimingTrace *timingTrace;
+
 - (BOOL) isWebSocketConnected;
 - (void) connect:(STTConfiguration*)config headers:(NSDictionary*)headers;
 - (void) reconnect;
+- (void) prewarm;
+- (void) startRecognition;
+- (BOOL) isReusable;
 - (void) disconnect: (NSString*) reason;
+- (void) cancel: (NSString*) reason;
 - (void) writeData:(NSData*) data;
+- (void) writeData:(NSData*) data sent:(void (^)(void))sentHandler;
+- (void) whenListening:(void (^)(BOOL listening))handler;
 - (void) setRecognizeHandler:(void (^)(NSDictionary*, NSError*))handler;
 - (void) setAudioDataHandler:(void (^)(NSData*))handler;
 - (BOOL) sendEndOfStreamMarker;
+- (NSUInteger) queuedAudioBytes;
+- (NSUInteger) queuedAudioChunks;
+- (NSUInteger) droppedAudioBytes;
 
 
 @end
@@ -16,6 +16,7 @@
 
 #import "WebSocketAudioStreamer.h"
 #import "SocketRocket.h"
+#import "AudioChunkQueue.h"
 
 
 typedef void (^RecognizeCallbackBlockType)(NSDictionary*, NSError*);
@@ -24,7 +25,8 @@ typedef void (^AudioDataCallbackBlockType)(NSData*);
 @interface WebSocketAudioStreamer () <SRWebSocketDelegate>
 
 @property NSDictionary *headers;
-@property (strong, atomic) NSMutableData *audioBuffer;
+@property (strong, atomic) AudioChunkQueue *audioQueue;
+@property NSUInteger frameLength;
 @property (strong, atomic) NSNumber *reconnectAttempts;
 @property (nonatomic, copy) RecognizeCallbackBlockType recognizeCallback;
 @property (nonatomic, copy) AudioDataCallbackBlockType audioDataCallback;
@@ -36,11 +38,45 @@ typedef void (^AudioDataCallbackBlockType)(NSData*);
 @property BOOL isReadyForClosure;
 @property BOOL hasDataBeenSent;
 @property BOOL hasStopBeenSent;
+@property BOOL hasPendingEndOfStream;
+// connected, or connecting, without a recognition in progress; the socket is kept for the next one
+@property BOOL isIdle;
+@property (nonatomic, strong) dispatch_source_t keepAliveTimer;
+// set by cancel, the socket is closed quietly and never reopened
+@property BOOL isCancelled;
+// whenListening: handlers waiting for the service to start listening
+@property (nonatomic, strong) NSMutableArray *listeningHandlers;
+// socket events arrive here rather than on main, so the listening state can flush the queue
+// while main waits on a writer that the Block overflow policy holds
+@property (nonatomic, strong) dispatch_queue_t delegateQueue;
 
 @end
 
 @implementation WebSocketAudioStreamer
 
+- (id)init {
+    self = [super init];
+    if (self) {
+        // audio can be written before connect: is called, while the token is being fetched
+        self.audioQueue = [[AudioChunkQueue alloc] initWithMaxBytes:WATSONSDK_AUDIO_BUFFER_MAX_BYTES
+                                                        maxDuration:WATSONSDK_AUDIO_BUFFER_MAX_DURATION
+                                                             policy:STTAudioBufferOverflowDrop];
+        self.frameLength = WATSONSDK_AUDIO_FRAME_LENGTH;
+        self.listeningHandlers = [[NSMutableArray alloc] init];
+        self.delegateQueue = dispatch_queue_create("com.ibm.watson.stt.socket", DISPATCH_QUEUE_SERIAL);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [self stopKeepAliveTimer];
+    // an idle socket keeps itself alive, close it with its owner
+    if (self.webSocket != nil) {
+        self.webSocket.delegate = nil;
+        [self.webSocket closeWithCode:SRStatusCodeNormal reason:@"Streamer released"];
+    }
+}
+
 /**
  *  connect to an itrans server using websockets
  *
@@ -48,6 +84,9 @@ typedef void (^AudioDataCallbackBlockType)(NSData*);
  *  @param cookie pass a full cookie string that may have been returned in a separate authentication step
  */
 - (void) connect:(STTConfiguration*)config headers:(NSDictionary*)headers  {
+    if (self.isCancelled) {
+        return;
+    }
     self.conf = config;
     self.headers = headers;
     
@@ -56,6 +95,12 @@ typedef void (^AudioDataCallbackBlockType)(NSData*);
     self.isReadyForClosure = NO;
     self.hasDataBeenSent = NO;
     self.hasStopBeenSent = NO;
+
+    self.audioQueue.maxBytes = config.audioBufferMaxBytes > 0 ? (NSUInteger)config.audioBufferMaxBytes : WATSONSDK_AUDIO_BUFFER_MAX_BYTES;
+    self.audioQueue.maxDuration = config.audioBufferMaxDuration;
+    self.audioQueue.policy = config.audioBufferOverflowPolicy;
+    self.audioQueue.blockTimeout = config.audioBufferBlockTimeout;
+    self.frameLength = config.audioFrameLength > 0 ? (NSUInteger)config.audioFrameLength : WATSONSDK_AUDIO_FRAME_LENGTH;
    
     NSLog(@"websocket connection using %@",[[self.conf getWebSocketRecognizeURL] absoluteString]);
     
@@ -68,8 +113,61 @@ typedef void (^AudioDataCallbackBlockType)(NSData*);
 
     self.webSocket = [[SRWebSocket alloc] initWithURLRequest:req];
     self.webSocket.delegate = self;
+    self.webSocket.delegateDispatchQueue = self.delegateQueue;
+    self.webSocket.perMessageDeflateEnabled = self.conf.perMessageDeflate;
+    self.webSocket.perMessageDeflateClientMaxWindowBits = self.conf.perMessageDeflateWindowBits;
+    self.webSocket.perMessageDeflateServerMaxWindowBits = self.conf.perMessageDeflateWindowBits;
+    self.webSocket.perMessageDeflateClientNoContextTakeover = self.conf.perMessageDeflateNoContextTakeover;
+    self.webSocket.perMessageDeflateServerNoContextTakeover = self.conf.perMessageDeflateNoContextTakeover;
+
+    if (self.conf.networkThreadCount > [NSRunLoop SR_networkThreadCount]) {
+        [NSRunLoop SR_setNetworkThreadCount:self.conf.networkThreadCount];
+    }
+    [NSRunLoop SR_setNetworkThreadAssignment:self.conf.networkThreadLeastLoaded ? SRNetworkThreadAssignmentLeastLoaded : SRNetworkThreadAssignmentHash];
+    self.webSocket.networkThreadIndex = self.conf.networkThreadIndex < 0 ? SRNetworkThreadIndexAutomatic : self.conf.networkThreadIndex;
     [self.webSocket open];
-    self.audioBuffer = [[NSMutableData alloc] initWithCapacity:0];
+}
+
+/**
+ *  open the socket without starting a recognition: the next connect: only connects and
+ *  startRecognition sends the start message later, so the handshake is already done when audio arrives
+ */
+- (void) prewarm {
+    self.isIdle = YES;
+}
+
+/**
+ *  start a new recognition, on the open socket when there is one, otherwise as soon as it opens
+ */
+- (void) startRecognition {
+    [self stopKeepAliveTimer];
+    @synchronized (self) {
+        self.isIdle = NO;
+        self.isReadyForAudio = NO;
+        self.isReadyForClosure = NO;
+        self.hasDataBeenSent = NO;
+        self.hasStopBeenSent = NO;
+        self.hasPendingEndOfStream = NO;
+    }
+    // the next chunk written is this recognition's Ogg header, pin it like a new queue's
+    [self.audioQueue clear];
+    if (self.isConnected) {
+        NSLog(@"starting a recognition on the open websocket");
+        [self.webSocket sendString:[self.conf getStartMessage]];
+    }
+}
+
+/**
+ *  if the socket is open or opening with no recognition in progress, so startRecognition can use it
+ *
+ *  @return BOOL
+ */
+- (BOOL)isReusable {
+    if (!self.isIdle) {
+        return NO;
+    }
+    // no socket yet while the token for a prewarm is being fetched
+    return self.webSocket == nil || [self.webSocket readyState] == SR_OPEN || [self.webSocket readyState] == SR_CONNECTING;
 }
 
 /**
@@ -98,24 +196,34 @@ typedef void (^AudioDataCallbackBlockType)(NSData*);
  *  @return YES if the data has been sent directly; NO if the data is bufferred because the connection is not established
  */
 - (BOOL)sendEndOfStreamMarker {
-    NSData *marker = [NSMutableData dataWithLength:0];
-    if(self.isConnected && self.isReadyForAudio) {
-        NSLog(@"sending end of stream marker");
-        [self.webSocket sendData:marker];
-//        [self.webSocket sendString:@"{\"action\":\"stop\"}"];
-//        [self writeData:[NSMutableData dataWithLength:0]];
-        self.isReadyForAudio = NO;
-        self.isReadyForClosure = YES;
-        return YES;
+    @synchronized (self) {
+        if(self.isConnected && self.isReadyForAudio) {
+            [self flushAudioQueue];
+            [self sendEndOfStream];
+            return YES;
+        }
+        // sent after the buffered audio once the service is listening
+        self.hasPendingEndOfStream = YES;
     }
 
-    [self writeData:marker];
-
     NSLog(@"The network is not connected yet");
     return NO;
 }
 
+/**
+ *  abandon a connection that is no longer wanted, including one still waiting for its token.
+ *  No results or errors are reported after this
+ */
+- (void)cancel:(NSString*) reason {
+    self.isCancelled = YES;
+    self.recognizeCallback = nil;
+    [self disconnect:reason];
+}
+
 - (void)disconnect:(NSString*) reason {
+    [self stopKeepAliveTimer];
+    [self notifyListeningHandlers:NO];
+    self.isIdle = NO;
     if(self.isConnected || [self.webSocket readyState] != SR_CLOSED || [self.webSocket readyState] != SR_CLOSING){
         self.isReadyForAudio = NO;
         self.isConnected = NO;
@@ -124,40 +232,160 @@ typedef void (^AudioDataCallbackBlockType)(NSData*);
     }
 }
 
-- (void)writeData:(NSData*) data {
-    if(self.isConnected && self.isReadyForAudio) {
-        // if we had previously buffered audio because we were not connected, send it now
-        if([self.audioBuffer length] > 0) {
-            NSLog(@"sending buffered audio");
-            [self.webSocket sendData:self.audioBuffer];
-            //reset buffer
-            [self.audioBuffer setData:[NSData dataWithBytes:NULL length:0]];
+/**
+ *  call handler once the service is listening for audio, or with NO if the connection ends first
+ *
+ *  @param handler (void (^)(BOOL listening)), called on the delegate queue or the calling thread
+ */
+- (void)whenListening:(void (^)(BOOL listening))handler {
+    @synchronized (self) {
+        if (!self.isReadyForAudio) {
+            [self.listeningHandlers addObject:[handler copy]];
+            return;
         }
-        [self.webSocket sendData:data];
-        self.hasDataBeenSent = YES;
     }
-    else {
-        // we need to buffer this data and send it when we connect
-        if(self.isConnected){
-            NSLog(@"buffering data and wait for 1st response");
+    handler(YES);
+}
+
+- (void)writeData:(NSData*) data {
+    [self writeData:data sent:nil];
+}
+
+/**
+ *  write audio, and find out when the socket has written it out rather than when it was accepted
+ *
+ *  @param data        audio
+ *  @param sentHandler called once the data has been written to the network, or straight away when it is
+ *                     buffered until the service listens; it must not block
+ */
+- (void)writeData:(NSData*) data sent:(void (^)(void))sentHandler {
+    BOOL written = NO;
+    BOOL sending = NO;
+    BOOL timedOut = NO;
+
+    while (!written) {
+        @synchronized (self) {
+            if(self.isConnected && self.isReadyForAudio) {
+                // if we had previously buffered audio because we were not connected, send it now
+                [self flushAudioQueue];
+                [self sendAudio:data completion:sentHandler];
+                written = YES;
+                sending = YES;
+            }
+            else {
+                // we need to buffer this data and send it when we connect
+                if(self.isConnected){
+                    NSLog(@"buffering data and wait for 1st response");
+                }
+                else{
+                    NSLog(@"buffering data and establishing connection");
+                }
+
+                if (timedOut) {
+                    [self.audioQueue forceEnqueue:data];
+                    written = YES;
+                } else {
+                    written = [self.audioQueue enqueue:data];
+                }
+            }
         }
-        else{
-            NSLog(@"buffering data and establishing connection");
+        // the Block policy waits outside the lock so the listening state can flush the queue meanwhile
+        if (!written && ![self.audioQueue waitForSpace:[data length]]) {
+            timedOut = YES;
         }
-
-        [self.audioBuffer appendData:data];
+    }
+    if (!sending && sentHandler != nil) {
+        sentHandler();
     }
     if(self.audioDataCallback != nil)
         self.audioDataCallback(data);
 }
 
+/**
+ *  bytes of audio waiting for the service to start listening, in memory and spilled to disk
+ *
+ *  @return NSUInteger
+ */
+- (NSUInteger)queuedAudioBytes {
+    return [self.audioQueue queuedBytes];
+}
+
+/**
+ *  chunks of audio held in memory waiting for the service to start listening
+ *
+ *  @return NSUInteger
+ */
+- (NSUInteger)queuedAudioChunks {
+    return [self.audioQueue queuedChunks];
+}
+
+/**
+ *  bytes of audio discarded because the buffer overflowed
+ *
+ *  @return NSUInteger
+ */
+- (NSUInteger)droppedAudioBytes {
+    return [self.audioQueue droppedBytes];
+}
+
+#pragma mark - sending, with the streamer locked
+
+/**
+ *  send audio in frames of at most frameLength bytes, completion follows the last one
+ */
+- (void)sendAudio:(NSData*) data completion:(void (^)(void))completion {
+    NSUInteger length = [data length];
+    if (length <= self.frameLength) {
+        [self.webSocket sendData:data completion:completion];
+    } else {
+        for (NSUInteger offset = 0; offset < length; offset += self.frameLength) {
+            NSUInteger frame = MIN(self.frameLength, length - offset);
+            BOOL last = offset + frame == length;
+            [self.webSocket sendData:[data subdataWithRange:NSMakeRange(offset, frame)] completion:last ? completion : nil];
+        }
+    }
+    [self.timingTrace mark:WATSONSDK_TRACE_FIRST_AUDIO_SENT];
+    self.hasDataBeenSent = YES;
+}
+
+- (void)flushAudioQueue {
+    NSData *frame = [self.audioQueue dequeueUpToLength:self.frameLength];
+    if (frame != nil) {
+        NSLog(@"sending buffered audio");
+    }
+    while (frame != nil) {
+        [self.webSocket sendData:frame];
+        [self.timingTrace mark:WATSONSDK_TRACE_FIRST_AUDIO_SENT];
+        self.hasDataBeenSent = YES;
+        frame = [self.audioQueue dequeueUpToLength:self.frameLength];
+    }
+
+    if (self.hasPendingEndOfStream) {
+        [self sendEndOfStream];
+    }
+}
+
+- (void)sendEndOfStream {
+    NSLog(@"sending end of stream marker");
+    [self.webSocket sendData:[NSMutableData dataWithLength:0]];
+    self.hasPendingEndOfStream = NO;
+    self.isReadyForAudio = NO;
+    self.isReadyForClosure = YES;
+}
+
 #pragma mark - SRWebSocketDelegate
 
 - (void)webSocketDidOpen:(SRWebSocket *)webSocket;
 {
     NSLog(@"Websocket Connected");
+    [self.timingTrace mark:WATSONSDK_TRACE_SOCKET_OPEN];
     self.isConnected = YES;
     self.hasDataBeenSent = NO;
+    if (self.isIdle) {
+        // prewarmed, the start message waits for startRecognition
+        [self startKeepAliveTimer];
+        return;
+    }
     [self.webSocket sendString: [self.conf getStartMessage]];
 }
 
@@ -169,7 +397,14 @@ typedef void (^AudioDataCallbackBlockType)(NSData*);
     self.isReadyForAudio = NO;
     self.isReadyForClosure = NO;
     self.webSocket = nil;
-    self.recognizeCallback(nil, error);
+    [self stopKeepAliveTimer];
+    if (self.isIdle || self.isCancelled) {
+        // nobody is waiting for results, the next recognize opens a new socket
+        self.isIdle = NO;
+        [self notifyListeningHandlers:NO];
+        return;
+    }
+    [self notifyRecognizeHandler:nil error:error];
 
     if ([self.reconnectAttempts intValue] < 3) {
         self.reconnectAttempts = [NSNumber numberWithInt:[self.reconnectAttempts intValue] +1] ;
@@ -178,7 +413,8 @@ typedef void (^AudioDataCallbackBlockType)(NSData*);
         [self reconnect];
     } else {
         // call the recognize handler block in the clients code
-        self.recognizeCallback(nil, error);
+        [self notifyRecognizeHandler:nil error:error];
+        [self notifyListeningHandlers:NO];
     }
 }
 
@@ -194,7 +430,7 @@ typedef void (^AudioDataCallbackBlockType)(NSData*);
     if(error) {
         /* JSON was malformed, act appropriately here */
         NSLog(@"JSON from service malformed, received %@", json);
-        self.recognizeCallback(nil,error);
+        [self notifyRecognizeHandler:nil error:error];
     }
     
     if([object isKindOfClass:[NSDictionary class]])
@@ -205,12 +441,21 @@ typedef void (^AudioDataCallbackBlockType)(NSData*);
             NSString *state = [results objectForKey:@"state"];
             // if we receive a listening state after having sent audio it means we can now close the connection
             if ([state isEqualToString:@"listening"] && self.isConnected && self.isReadyForClosure){
-                [self disconnect: @"Closure data has been sent"];
+                if (self.conf.keepAliveConnection) {
+                    [self becomeIdle];
+                } else {
+                    [self disconnect: @"Closure data has been sent"];
+                }
             } else if([state isEqualToString:@"listening"]) {
                 // we can send binary data now
-                self.isReadyForAudio = YES;
-                self.isReadyForClosure = YES;
-                NSLog(@"Start sending audio data");
+                @synchronized (self) {
+                    self.isReadyForAudio = YES;
+                    self.isReadyForClosure = YES;
+                    NSLog(@"Start sending audio data");
+                    [self.timingTrace mark:WATSONSDK_TRACE_LISTENING];
+                    [self flushAudioQueue];
+                }
+                [self notifyListeningHandlers:YES];
             }
         }
 
@@ -219,14 +464,18 @@ typedef void (^AudioDataCallbackBlockType)(NSData*);
             NSArray *resultsArr = [results objectForKey:@"results"];
             
             if([resultsArr count] > 0) {
-                self.recognizeCallback(results, nil);
+                [self.timingTrace mark:WATSONSDK_TRACE_FIRST_RESULT];
+                if ([[[resultsArr objectAtIndex:0] objectForKey:@"final"] boolValue]) {
+                    [self.timingTrace mark:WATSONSDK_TRACE_FINAL_RESULT];
+                }
+                [self notifyRecognizeHandler:results error:nil];
             }
         }
 
         if([results objectForKey:@"error"] != nil) {
             NSString *errorMessage = [results objectForKey:@"error"];
             NSError *error = [SpeechUtility raiseErrorWithMessage:errorMessage];
-            self.recognizeCallback(nil, error);
+            [self notifyRecognizeHandler:nil error:error];
             [self disconnect: errorMessage];
         }
     }
@@ -241,6 +490,11 @@ typedef void (^AudioDataCallbackBlockType)(NSData*);
 - (void)webSocket:(SRWebSocket *)webSocket didCloseWithCode:(NSInteger)code reason:(NSString *)reason wasClean:(BOOL)wasClean;
 {
     NSLog(@"WebSocket closed with reason[%d]: %@", [[NSNumber numberWithInteger:code] intValue], reason);
+    if (self.isIdle || self.isCancelled) {
+        // an idle or cancelled socket closing is not an error, the next recognize reconnects
+        [self webSocket:webSocket didFailWithError:nil];
+        return;
+    }
     // sometimes the socket can close immediately before data has been sent
     if(self.hasDataBeenSent == NO){
         NSString *errorMessage = @"Websocket closed before data could be sent";
@@ -268,11 +522,87 @@ typedef void (^AudioDataCallbackBlockType)(NSData*);
     if (code == 1006) { // authentication error
         [self.conf invalidateToken];
     }
-    self.recognizeCallback(nil, nil);
+    [self notifyListeningHandlers:NO];
+    [self notifyRecognizeHandler:nil error:nil];
+}
+
+#pragma mark - keep alive
+
+/**
+ *  the service is listening again after the end of stream, keep the socket for the next recognition
+ */
+- (void)becomeIdle {
+    NSLog(@"Recognition finished, keeping the websocket open");
+    @synchronized (self) {
+        self.isIdle = YES;
+        self.isReadyForAudio = NO;
+        self.isReadyForClosure = NO;
+    }
+    [self startKeepAliveTimer];
+    [self notifyRecognizeHandler:nil error:nil];
+}
+
+/**
+ *  ping an idle socket so the connection is not dropped between recognitions
+ */
+- (void)startKeepAliveTimer {
+    [self stopKeepAliveTimer];
+    if (self.conf.keepAliveInterval <= 0) {
+        return;
+    }
+    uint64_t interval = (uint64_t)(self.conf.keepAliveInterval * NSEC_PER_SEC);
+    dispatch_source_t timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, dispatch_get_main_queue());
+    dispatch_source_set_timer(timer, dispatch_time(DISPATCH_TIME_NOW, (int64_t)interval), interval, interval / 10);
+    __weak WebSocketAudioStreamer *weakSelf = self;
+    dispatch_source_set_event_handler(timer, ^{
+        [weakSelf sendKeepAlive];
+    });
+    dispatch_resume(timer);
+    self.keepAliveTimer = timer;
+}
+
+- (void)stopKeepAliveTimer {
+    if (self.keepAliveTimer != nil) {
+        dispatch_source_cancel(self.keepAliveTimer);
+        self.keepAliveTimer = nil;
+    }
+}
+
+- (void)sendKeepAlive {
+    if (self.isIdle && [self.webSocket readyState] == SR_OPEN) {
+        [self.webSocket sendPing:nil];
+    }
 }
 
 #pragma mark - delegate
 
+- (void)notifyListeningHandlers:(BOOL) listening {
+    NSArray *handlers;
+    @synchronized (self) {
+        handlers = [self.listeningHandlers copy];
+        [self.listeningHandlers removeAllObjects];
+    }
+    for (void (^handler)(BOOL) in handlers) {
+        handler(listening);
+    }
+}
+
+/**
+ *  results and errors are still reported on main, in the order the socket delivered them
+ */
+- (void)notifyRecognizeHandler:(NSDictionary*) results error:(NSError*) error {
+    RecognizeCallbackBlockType callback = self.recognizeCallback;
+    if (callback == nil) {
+        return;
+    }
+    dispatch_async(dispatch_get_main_queue(), ^{
+        // nothing is reported once cancelled, even if it was on its way
+        if (!self.isCancelled) {
+            callback(results, error);
+        }
+    });
+}
+
 /**
  *  setRecognizeHandler - store the handler from the client so we can pass back results and errors
  *
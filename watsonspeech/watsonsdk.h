@@ -23,10 +23,14 @@ FOUNDATION_EXPORT const unsigned char WatsonSDKVersionString[];
 
 #import "SpeechToText.h"
 #import "STTConfiguration.h"
+#import "SpeechToTextSessionManager.h"
+#import "STTTimingTrace.h"
 
 #import "TextToSpeech.h"
 #import "TTSCustomWord.h"
 #import "TTSCustomVoice.h"
 #import "TTSConfiguration.h"
+#import "TTSStreamDecoder.h"
+#import "TTSAudioStreamPlayer.h"
 
 #import "WebSocketAudioStreamer.h"